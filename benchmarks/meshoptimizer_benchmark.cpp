@@ -0,0 +1,198 @@
+// Vertex cache efficiency, memory and upload cost of sampled surfaces, as the default visualizer
+// lays them out against the layouts of MeshOptimizer.
+//
+//   meshoptimizer_benchmark [repetitions]
+//
+// acmr: vertex shader runs per triangle for a FIFO post-transform cache of 16 and 32 entries.
+// pack: building the buffers from the samples. upload: copying them into a staging buffer, the
+// part of glBufferData that happens on the CPU; the transfer to the GPU scales with the bytes.
+
+#include "../tessellation/meshoptimizer.h"
+#include "../tessellation/surfacesampler.h"
+
+// gmlib
+#include <gmParametricsModule>
+
+// stl
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+    // Best of a few runs, in milliseconds
+    double time( int repetitions, const std::function<void()>& run ) {
+
+        auto best = 0.0;
+        for( auto r = 0; r < repetitions; ++r ) {
+
+            auto start = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if( r == 0 || elapsed.count() < best )
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    // What PSurfDefaultVisualizer uploads: position and texture coordinates, a float normal map
+    // texel per sample, and one triangle strip per row of the grid
+    struct DefaultLayout {
+        std::vector<float>                            vertices;
+        std::vector<float>                            normals;
+        std::vector<std::uint32_t>                    indices;
+
+        std::size_t getBytes() const {
+            return ( vertices.size() + normals.size() ) * sizeof(float) + indices.size() * sizeof(std::uint32_t);
+        }
+    };
+
+    void packDefault( const SurfaceSamples& samples, DefaultLayout& mesh ) {
+
+        const auto m1 = samples.m1;
+        const auto m2 = samples.m2;
+
+        mesh.vertices.resize( size_t(m1) * size_t(m2) * 5 );
+        mesh.normals.resize( size_t(m1) * size_t(m2) * 3 );
+
+        auto v = mesh.vertices.data();
+        auto n = mesh.normals.data();
+        for( auto i = 0; i < m1; ++i ) {
+            for( auto j = 0; j < m2; ++j ) {
+
+                const auto& p = samples.p[i][j][0][0];
+                *v++ = p[0];
+                *v++ = p[1];
+                *v++ = p[2];
+                *v++ = float(i) / float(m1 - 1);
+                *v++ = float(j) / float(m2 - 1);
+
+                for( auto k = 0; k < 3; ++k )
+                    *n++ = samples.normals[i][j][k];
+            }
+        }
+
+        MeshOptimizer::Options rows;
+        rows.topology = PackedMesh::Topology::Strips;
+        rows.order    = MeshOptimizer::Order::Rows;
+        mesh.indices  = MeshOptimizer::gridIndices( m1, m2, rows );
+    }
+
+    struct Row {
+        std::string                                   layout;
+        double                                        acmr16, acmr32;
+        double                                        vertex_bytes;
+        double                                        index_bytes;
+        std::size_t                                   bytes;
+        double                                        pack, upload;
+    };
+
+    void print( const Row& row ) {
+
+        std::cout << std::left  << std::setw(26) << row.layout << std::right << std::fixed
+                  << std::setprecision(3) << std::setw(9) << row.acmr16 << std::setw(9) << row.acmr32
+                  << std::setprecision(1) << std::setw(10) << row.vertex_bytes << std::setw(10) << row.index_bytes
+                  << std::setw(11) << double(row.bytes) / 1024.0
+                  << std::setprecision(3) << std::setw(10) << row.pack << std::setw(10) << row.upload << std::endl;
+    }
+}
+
+
+
+int main( int argc, char* argv[] ) {
+
+    auto repetitions = argc > 1 ? std::max( 1, std::atoi( argv[1] ) ) : 5;
+
+    GMlib::PTorus<float> torus( 3.0f, 1.0f, 1.0f );
+    auto sampler = SurfaceSampler::create( &torus );
+
+    struct Variant {
+        std::string                                   name;
+        MeshOptimizer::Options                        options;
+    };
+
+    std::vector<Variant> variants;
+    for( auto order : { MeshOptimizer::Order::Rows, MeshOptimizer::Order::Bands } ) {
+        for( auto topology : { PackedMesh::Topology::Triangles, PackedMesh::Topology::Strips } ) {
+            for( auto quantize : { false, true } ) {
+
+                Variant v;
+                v.options.order            = order;
+                v.options.topology         = topology;
+                v.options.quantize_normals = quantize;
+                v.name = std::string( order == MeshOptimizer::Order::Rows ? "rows" : "bands" ) +
+                         ( topology == PackedMesh::Topology::Strips ? " strips" : " list" ) +
+                         ( quantize ? " octahedral" : " float" );
+                variants.push_back(v);
+            }
+        }
+    }
+
+    std::cout << "PTorus, best of " << repetitions << "; bytes per vertex and per triangle, KiB, milliseconds"
+              << std::endl;
+
+    std::vector<unsigned char> staging;
+    for( auto m : { 25, 65, 201, 1001 } ) {
+
+        auto samples = sampler->sample( m, m, 1, 1 );
+        const auto vertex_count   = size_t(m) * size_t(m);
+        const auto triangle_count = 2 * size_t(m - 1) * size_t(m - 1);
+
+        std::cout << std::endl << m << " x " << m << " samples" << std::endl;
+        std::cout << std::left  << std::setw(26) << "layout" << std::right
+                  << std::setw(9) << "acmr16"   << std::setw(9) << "acmr32"
+                  << std::setw(10) << "B/vertex" << std::setw(10) << "B/tri"
+                  << std::setw(11) << "KiB"      << std::setw(10) << "pack" << std::setw(10) << "upload" << std::endl;
+
+        auto upload = [&]( const std::vector<const void*>& data, const std::vector<std::size_t>& sizes ) {
+            return time( repetitions, [&]() {
+                for( size_t i = 0; i < data.size(); ++i ) {
+                    staging.resize( sizes[i] );
+                    std::memcpy( staging.data(), data[i], sizes[i] );
+                }
+            });
+        };
+
+        {
+            DefaultLayout mesh;
+            Row row;
+            row.layout       = "default visualizer";
+            row.pack         = time( repetitions, [&]() { packDefault( *samples, mesh ); } );
+            row.acmr16       = MeshOptimizer::acmr( mesh.indices, vertex_count, triangle_count, 16 );
+            row.acmr32       = MeshOptimizer::acmr( mesh.indices, vertex_count, triangle_count, 32 );
+            row.vertex_bytes = double( ( mesh.vertices.size() + mesh.normals.size() ) * sizeof(float) ) / double(vertex_count);
+            row.index_bytes  = double( mesh.indices.size() * sizeof(std::uint32_t) ) / double(triangle_count);
+            row.bytes        = mesh.getBytes();
+            row.upload       = upload( { mesh.vertices.data(), mesh.normals.data(), mesh.indices.data() },
+                                       { mesh.vertices.size() * sizeof(float), mesh.normals.size() * sizeof(float),
+                                         mesh.indices.size() * sizeof(std::uint32_t) } );
+            print(row);
+        }
+
+        for( const auto& variant : variants ) {
+
+            PackedMesh mesh;
+            Row row;
+            row.layout       = variant.name;
+            row.pack         = time( repetitions, [&]() { MeshOptimizer::pack( *samples, variant.options, mesh ); } );
+            row.acmr16       = MeshOptimizer::acmr( mesh.indices, vertex_count, triangle_count, 16 );
+            row.acmr32       = MeshOptimizer::acmr( mesh.indices, vertex_count, triangle_count, 32 );
+            row.vertex_bytes = double( mesh.stride );
+            row.index_bytes  = double( mesh.indices.size() * sizeof(std::uint32_t) ) / double(triangle_count);
+            row.bytes        = mesh.getBytes();
+            row.upload       = upload( { mesh.vertices.data(), mesh.indices.data() },
+                                       { mesh.vertices.size(), mesh.indices.size() * sizeof(std::uint32_t) } );
+            print(row);
+        }
+    }
+
+    return 0;
+}
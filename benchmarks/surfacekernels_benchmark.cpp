@@ -0,0 +1,176 @@
+// Sampling time of the built-in surfaces, per sample evaluation against the batched kernels.
+//
+//   surfacekernels_benchmark [repetitions]
+//
+// The grids of the scalar and AVX2 kernels are first checked against PSurf::evaluate; the error
+// of a component is in units in the last place of the largest component of its vector, so that
+// components near zero are not held to a precision the others do not have. Exits with 1 when
+// an error is over the tolerance.
+
+#include "../tessellation/surfacekernels.h"
+#include "../tessellation/surfacesampler.h"
+
+// gmlib
+#include <gmParametricsModule>
+
+// stl
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+namespace {
+
+    // Best of a few runs, in milliseconds
+    double time( int repetitions, const std::function<void()>& run ) {
+
+        auto best = 0.0;
+        for( auto r = 0; r < repetitions; ++r ) {
+
+            auto start = std::chrono::steady_clock::now();
+            run();
+            std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - start;
+            if( r == 0 || elapsed.count() < best )
+                best = elapsed.count();
+        }
+        return best;
+    }
+
+    // What PSurf::replot does on the CPU: one virtual evaluation per sample
+    void evaluatePerSample( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 ) {
+
+        GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>> p( m1, m2 );
+
+        const auto su = surface->getParStartU();
+        const auto sv = surface->getParStartV();
+        const auto du = surface->getParDeltaU() / float(m1 - 1);
+        const auto dv = surface->getParDeltaV() / float(m2 - 1);
+        for( auto i = 0; i < m1; ++i )
+            for( auto j = 0; j < m2; ++j )
+                p[i][j] = surface->evaluate( su + float(i) * du, sv + float(j) * dv, d1, d2 );
+    }
+
+    // Largest error of the grid against PSurf::evaluate, in units in the last place
+    double maxUlps( GMlib::PSurf<float,3>* surface, const SurfaceGrid& grid ) {
+
+        const auto su = surface->getParStartU();
+        const auto sv = surface->getParStartV();
+        const auto du = surface->getParDeltaU() / float(grid.m1 - 1);
+        const auto dv = surface->getParDeltaV() / float(grid.m2 - 1);
+
+        auto worst = 0.0;
+        for( auto i = 0; i < grid.m1; ++i )
+            for( auto j = 0; j < grid.m2; ++j ) {
+
+                // As the kernels take the parameters
+                auto p = surface->evaluate( su + float(i) * du, sv + float(j) * dv, grid.d1, grid.d2 );
+                const auto sample = size_t(i) * size_t(grid.m2) + size_t(j);
+
+                for( auto a = 0; a <= grid.d1; ++a )
+                    for( auto b = 0; b <= grid.d2; ++b ) {
+
+                        const auto& expected = p[a][b];
+                        auto scale = 0.0f;
+                        for( auto k = 0; k < 3; ++k )
+                            scale = std::max( scale, std::abs( expected[k] ) );
+
+                        const auto ulp = std::max( std::nextafter( scale, std::numeric_limits<float>::infinity() ) - scale,
+                                                   std::numeric_limits<float>::denorm_min() );
+                        for( auto k = 0; k < 3; ++k ) {
+                            const auto error = std::abs( double( grid.plane(a,b,k)[sample] ) - double( expected[k] ) );
+                            worst = std::max( worst, error / double(ulp) );
+                        }
+                    }
+            }
+
+        return worst;
+    }
+}
+
+
+
+int main( int argc, char* argv[] ) {
+
+    auto repetitions = argc > 1 ? std::max( 1, std::atoi( argv[1] ) ) : 5;
+
+    std::vector<std::pair<std::string,std::shared_ptr<GMlib::PSurf<float,3>>>> surfaces {
+        { "PTorus",    std::make_shared<GMlib::PTorus<float>>( 3.0f, 1.0f, 1.0f ) },
+        { "PSphere",   std::make_shared<GMlib::PSphere<float>>( 2.0f ) },
+        { "PCylinder", std::make_shared<GMlib::PCylinder<float>>( 2.0f, 2.0f, 15.0f ) },
+        { "PPlane",    std::make_shared<GMlib::PPlane<float>>( GMlib::Point<float,3>( -5.0f, 0.0f, 0.0f ),
+                                                               GMlib::Vector<float,3>( 10.0f, 0.0f, 0.0f ),
+                                                               GMlib::Vector<float,3>( 0.0f, 20.0f, 0.0f ) ) }
+    };
+
+    const auto avx2 = SurfaceKernels::isSupported( SurfaceKernels::Isa::Avx2 );
+    const auto d = 1;
+    const auto tolerance = 16.0;
+
+    // Both kernels, before anything is timed
+    auto failed = false;
+    for( const auto& surface : surfaces ) {
+        for( auto m : { 50, 200, 1000 } ) {
+            for( auto isa : { SurfaceKernels::Isa::Scalar, SurfaceKernels::Isa::Avx2 } ) {
+
+                if( !SurfaceKernels::isSupported(isa) )
+                    continue;
+
+                SurfaceKernels::setIsa(isa);
+                SurfaceGrid grid;
+                auto ulps = SurfaceKernels::evaluate( surface.second.get(), m, m, d, d, grid )
+                          ? maxUlps( surface.second.get(), grid ) : std::numeric_limits<double>::infinity();
+                if( ulps > tolerance ) {
+                    std::cerr << surface.first << ", " << m << " samples, " << ( isa == SurfaceKernels::Isa::Avx2 ? "avx2" : "scalar" )
+                              << ": off by " << ulps << " ulp from PSurf::evaluate" << std::endl;
+                    failed = true;
+                }
+            }
+        }
+    }
+    if( failed )
+        return 1;
+
+    std::cout << "kernels within " << tolerance << " ulp of PSurf::evaluate" << std::endl;
+    std::cout << "best of " << repetitions << ", milliseconds; grid: kernel only, sampler: including the GMlib matrices"
+              << ( avx2 ? "" : "; no AVX2 on this CPU" ) << std::endl << std::endl;
+    std::cout << std::left  << std::setw(11) << "surface" << std::right << std::setw(7) << "samples"
+              << std::setw(12) << "per sample" << std::setw(12) << "grid"   << std::setw(12) << "grid avx2"
+              << std::setw(12) << "sampler"    << std::setw(14) << "sampler avx2" << std::endl;
+
+    for( const auto& surface : surfaces ) {
+        for( auto m : { 50, 200, 1000 } ) {
+
+            auto sampler = SurfaceSampler::create( surface.second.get() );
+            SurfaceGrid grid;
+
+            auto kernels = [&]( SurfaceKernels::Isa isa ) {
+
+                SurfaceKernels::setIsa(isa);
+                return std::make_pair(
+                    time( repetitions, [&]() { SurfaceKernels::evaluate( surface.second.get(), m, m, d, d, grid );
+                                               SurfaceKernels::computeNormals(grid); } ),
+                    time( repetitions, [&]() { sampler->sample( m, m, d, d ); } ) );
+            };
+
+            auto per_sample = time( repetitions, [&]() { evaluatePerSample( surface.second.get(), m, m, d, d ); } );
+            auto scalar     = kernels( SurfaceKernels::Isa::Scalar );
+            auto vector     = avx2 ? kernels( SurfaceKernels::Isa::Avx2 ) : scalar;
+
+            std::cout << std::left  << std::setw(11) << surface.first << std::right << std::setw(7) << m
+                      << std::fixed << std::setprecision(3)
+                      << std::setw(12) << per_sample
+                      << std::setw(12) << scalar.first  << std::setw(12) << vector.first
+                      << std::setw(12) << scalar.second << std::setw(14) << vector.second << std::endl;
+        }
+    }
+
+    return 0;
+}
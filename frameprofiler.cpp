@@ -0,0 +1,128 @@
+#include "frameprofiler.h"
+
+// stl
+#include <algorithm>
+#include <cmath>
+
+
+FrameProfiler::Scope::Scope( Phase phase ) : _phase(phase), _started( std::chrono::steady_clock::now() ) {}
+
+FrameProfiler::Scope::~Scope() { FrameProfiler::instance().record( _phase, std::chrono::steady_clock::now() - _started ); }
+
+
+
+FrameProfiler::FrameProfiler( size_t window ) : _window( std::max( window, size_t(1) ) ) {}
+
+FrameProfiler& FrameProfiler::instance() {
+
+    static FrameProfiler profiler;
+    return profiler;
+}
+
+const char* FrameProfiler::name( Phase phase ) {
+
+    switch( phase ) {
+    case Input:      return "input";
+    case Simulate:   return "simulate";
+    case Prepare:    return "prepare";
+    case Render:     return "render";
+    case ResetState: return "reset state";
+    case Frame:      return "frame";
+    default:         return "";
+    }
+}
+
+void FrameProfiler::record( Phase phase, double milliseconds ) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto& h = _phases[phase];
+    const auto value = float( std::max( milliseconds, 0.0 ) );
+
+    if( h.samples.size() < _window )
+        h.samples.push_back(value);
+    else {
+        // The oldest sample leaves the window
+        --h.counts[ size_t( bucket( double( h.samples[h.next] ) ) ) ];
+        h.samples[h.next] = value;
+    }
+
+    // Counted in the bucket of the value as stored, the one it is taken out of again
+    h.next = ( h.next + 1 ) % _window;
+    ++h.counts[ size_t( bucket( double(value) ) ) ];
+}
+
+void FrameProfiler::record( Phase phase, std::chrono::steady_clock::duration duration ) {
+
+    record( phase, std::chrono::duration<double,std::milli>(duration).count() );
+}
+
+FrameProfiler::Percentiles FrameProfiler::getPercentiles( Phase phase ) const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    const auto& h = _phases[phase];
+
+    Percentiles p;
+    p.count = h.samples.size();
+    if( !p.count )
+        return p;
+
+    // Never past the largest sample, which is exact
+    p.max = double( *std::max_element( h.samples.begin(), h.samples.end() ) );
+    p.p50 = std::min( percentile( h, p.count, 0.50 ), p.max );
+    p.p95 = std::min( percentile( h, p.count, 0.95 ), p.max );
+    p.p99 = std::min( percentile( h, p.count, 0.99 ), p.max );
+    return p;
+}
+
+void FrameProfiler::setWindow( size_t samples ) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _window = std::max( samples, size_t(1) );
+    for( auto& h : _phases )
+        h = Histogram();
+}
+
+void FrameProfiler::clear() {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    for( auto& h : _phases )
+        h = Histogram();
+}
+
+int FrameProfiler::bucket( double milliseconds ) {
+
+    if( milliseconds <= 0.0 )
+        return 0;
+
+    const auto b = int( std::floor( ( std::log2(milliseconds) - minOctave ) * bucketsPerOctave ) );
+    return std::min( std::max( b, 0 ), bucketCount - 1 );
+}
+
+double FrameProfiler::lowerBound( int bucket ) {
+
+    return std::exp2( double(minOctave) + double(bucket) / bucketsPerOctave );
+}
+
+double FrameProfiler::percentile( const Histogram& h, size_t count, double fraction ) {
+
+    // The bucket holding the rank, interpolated geometrically across it
+    const auto rank = fraction * double(count);
+    auto below = 0.0;
+    for( auto b = 0; b < bucketCount; ++b ) {
+
+        const auto n = double( h.counts[size_t(b)] );
+        if( n > 0.0 && below + n >= rank ) {
+
+            const auto t = std::min( std::max( ( rank - below ) / n, 0.0 ), 1.0 );
+            const auto lo = lowerBound(b);
+            return lo * std::exp2( t / bucketsPerOctave );
+        }
+        below += n;
+    }
+
+    return lowerBound( bucketCount );
+}
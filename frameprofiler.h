@@ -0,0 +1,86 @@
+#ifndef FRAMEPROFILER_H
+#define FRAMEPROFILER_H
+
+
+// stl
+#include <array>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+
+// Times the phases of a frame, and the simulation steps, on the steady clock.
+// Each phase keeps a histogram of its latest samples, buckets an eighth of an octave wide,
+// from which the percentiles are read; that is within a few percent of the exact value.
+// The rolling window drops the oldest sample for each new one. Any thread may record and read.
+class FrameProfiler {
+public:
+    enum Phase {
+        Input,              // GuiApplication::handleGLInputEvents
+        Simulate,           // a simulation step
+        Prepare,            // the scene made ready for drawing
+        Render,             // Scenario::render, prepare included
+        ResetState,         // QQuickWindow::resetOpenGLState after GMlib
+        Frame,              // all of the FBO item's render()
+        PhaseCount
+    };
+
+    // Milliseconds
+    struct Percentiles {
+        double                                        p50 {0.0};
+        double                                        p95 {0.0};
+        double                                        p99 {0.0};
+        double                                        max {0.0};
+        size_t                                        count {0};
+    };
+
+    // Records the time from construction to destruction
+    class Scope {
+    public:
+        explicit Scope( Phase phase );
+        ~Scope();
+
+        Scope( const Scope& )                         = delete;
+        Scope& operator = ( const Scope& )            = delete;
+
+    private:
+        Phase                                         _phase;
+        std::chrono::steady_clock::time_point         _started;
+    };
+
+    explicit FrameProfiler( size_t window = 1000 );
+
+    static FrameProfiler&                             instance();
+    static const char*                                name( Phase phase );
+
+    void                                              record( Phase phase, double milliseconds );
+    void                                              record( Phase phase, std::chrono::steady_clock::duration duration );
+
+    Percentiles                                       getPercentiles( Phase phase ) const;
+    void                                              setWindow( size_t samples );
+    void                                              clear();
+
+private:
+    static const int                                  bucketsPerOctave = 8;
+    static const int                                  minOctave        = -10;    // about a microsecond
+    static const int                                  octaves          = 28;     // up to about four minutes
+    static const int                                  bucketCount      = bucketsPerOctave * octaves;
+
+    struct Histogram {
+        std::array<uint32_t,bucketCount>              counts {};
+        std::vector<float>                            samples;     // ring of the window
+        size_t                                        next {0};
+    };
+
+    mutable std::mutex                                _mutex;
+    std::array<Histogram,PhaseCount>                  _phases;
+    size_t                                            _window;
+
+    static int                                        bucket( double milliseconds );
+    static double                                     lowerBound( int bucket );
+    static double                                     percentile( const Histogram& h, size_t count, double fraction );
+};
+
+#endif // FRAMEPROFILER_H
@@ -0,0 +1,45 @@
+#ifndef GMLIBACCESS_H
+#define GMLIBACCESS_H
+
+
+// gmlib
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+
+// The protected state of GMlib objects written from outside, kept in this one place.
+//
+// GMlib 0.6 has no public setter for these. A member pointer named through a derived class has
+// the base class type, so it may be applied to any object of the base class; nothing is
+// derived from, or instantiated, for real. These go with the layout of GMlib 0.6 and are to
+// be looked at again when GMlib is upgraded.
+
+
+// Sampling bookkeeping and bounding sphere of a surface, for meshes sampled outside of replot()
+struct PSurfAccess : GMlib::PSurf<float,3> {
+
+    static void setSampling( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 ) {
+
+        surface->*(&PSurfAccess::_no_sam_u) = m1;
+        surface->*(&PSurfAccess::_no_sam_v) = m2;
+        surface->*(&PSurfAccess::_no_der_u) = d1;
+        surface->*(&PSurfAccess::_no_der_v) = d2;
+    }
+
+    static void setSphere( GMlib::PSurf<float,3>* surface, const GMlib::Sphere<float,3>& sphere ) {
+
+        (surface->*(&PSurfAccess::setSurroundingSphere))(sphere);
+    }
+};
+
+// Local matrix of an object, which the public interface only moves relative to itself;
+// for putting objects back where a step left them
+struct SceneObjectAccess : GMlib::SceneObject {
+
+    static GMlib::HqMatrix<float,3>& matrix( GMlib::SceneObject* obj ) {
+
+        return obj->*(&SceneObjectAccess::_matrix);
+    }
+};
+
+#endif // GMLIBACCESS_H
@@ -0,0 +1,327 @@
+#include "gmlibscenebuilder.h"
+
+// gmlib
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+// stl
+#include "iostream"
+
+
+namespace {
+
+    // First primitive data structure of the given type inside structure, or nullptr
+    template <typename DataType>
+    const ODDL::DataStructure<DataType>* data( const ODDL::Structure* structure ) {
+
+        for( auto sub = structure->GetFirstSubnode(); sub; sub = sub->Next() )
+            if( sub->GetStructureType() == DataType::kStructureType )
+                return static_cast<const ODDL::DataStructure<DataType>*>(sub);
+
+        return nullptr;
+    }
+
+    bool readBool( const ODDL::Structure* structure, bool fallback ) {
+
+        auto d = data<ODDL::BoolDataType>(structure);
+        return (d && d->GetDataElementCount() > 0) ? d->GetDataElement(0) : fallback;
+    }
+
+    // float[3] and double[3] are both accepted
+    GMlib::Vector<float,3> readVector3( const ODDL::Structure* structure ) {
+
+        GMlib::Vector<float,3> v(0.0f);
+
+        if( auto f = data<ODDL::FloatDataType>(structure) ) {
+            for( auto i = 0; i < 3 && i < f->GetDataElementCount(); ++i )
+                v[i] = f->GetDataElement(i);
+        }
+        else if( auto d = data<ODDL::DoubleDataType>(structure) ) {
+            for( auto i = 0; i < 3 && i < d->GetDataElementCount(); ++i )
+                v[i] = float(d->GetDataElement(i));
+        }
+
+        return v;
+    }
+
+    float readFloat( const ODDL::Structure* structure, GMStructTypes property, float fallback ) {
+
+        auto sub = structure->GetFirstSubstructure( int( property ) );
+        auto f   = sub ? data<ODDL::FloatDataType>(sub) : nullptr;
+        return (f && f->GetDataElementCount() > 0) ? f->GetDataElement(0) : fallback;
+    }
+
+    GMlib::Color readColor( const ODDL::Structure* structure ) {
+
+        auto d = data<ODDL::DoubleDataType>(structure);
+        if( !d || d->GetDataElementCount() < 3 )
+            return GMlib::GMcolor::White;
+
+        return GMlib::Color( d->GetDataElement(0), d->GetDataElement(1), d->GetDataElement(2) );
+    }
+}
+
+
+
+GMlibSceneBuilder::GMlibSceneBuilder( const GMlibSceneLoaderDataDescription& description )
+    : _description(description),
+      _replot( []( GMlib::PSurf<float,3>* s, int m1, int m2, int d1, int d2 ) { s->replot(m1,m2,d1,d2); } ),
+      _static( []( GMlib::PSurf<float,3>* ) {} )
+{
+}
+
+GMlibSceneBuilder::~GMlibSceneBuilder()
+{
+}
+
+std::vector<GMlib::SceneObject*>
+GMlibSceneBuilder::build()
+{
+    std::vector<GMlib::SceneObject*> objects;
+
+    auto root = _description.GetRootStructure();
+    for( auto node = root->GetFirstSubnode(); node; node = node->Next() )
+    {
+        auto obj = buildObject( node );
+        if( obj ) objects.push_back( obj );
+    }
+
+    return objects;
+}
+
+void
+GMlibSceneBuilder::setReplot( ReplotFunction replot )
+{
+    _replot = replot;
+}
+
+void
+GMlibSceneBuilder::setStatic( StaticFunction make_static )
+{
+    _static = make_static;
+}
+
+GMlib::SceneObject*
+GMlibSceneBuilder::buildObject( const ODDL::Structure* structure )
+{
+    auto type = structure->GetStructureType();
+    if( type != int( GMStructTypes::PTorus )    && type != int( GMStructTypes::PSphere ) &&
+        type != int( GMStructTypes::PCylinder ) && type != int( GMStructTypes::PPlane ) )
+        return nullptr;
+
+    GMlib::PSurf<float,3>* obj = nullptr;
+    int sampling[4];
+
+    // The shape is either given inline, or by a reference to a prototype of the same type
+    if( auto ref = data<ODDL::RefDataType>(structure) )
+    {
+        auto prototype = ref->GetDataElementCount() > 0 ? _description.FindStructure( ref->GetDataElement(0) ) : nullptr;
+        if( !prototype || prototype->GetStructureType() != type )
+        {
+            std::cerr << "Unresolved prototype reference" << std::endl;
+            return nullptr;
+        }
+
+        obj = buildSurface( prototype, sampling );
+    }
+    else
+    {
+        obj = buildSurface( structure, sampling );
+    }
+
+    if( !obj ) return nullptr;
+
+    for( auto sub = structure->GetFirstSubnode(); sub; sub = sub->Next() )
+    {
+        if( sub->GetStructureType() == int( GMStructTypes::SceneObjectData ) )
+        {
+            applySceneObjectData( obj, sub );
+        }
+        else if( auto child = buildObject( sub ) )
+        {
+            obj->insert( child );
+        }
+    }
+
+    // After the object data, so that a static surface is sampled into its batch
+    _replot( obj, sampling[0], sampling[1], sampling[2], sampling[3] );
+
+    return obj;
+}
+
+// The surface with its visualizer; the sampling it is to be replotted with goes into
+// sampling, as samples u, samples v, derivatives u, derivatives v
+GMlib::PSurf<float,3>*
+GMlibSceneBuilder::buildSurface( const ODDL::Structure* shape, int sampling[4] )
+{
+    auto surface = createSurface( shape );
+    if( !surface ) return nullptr;
+
+    auto psurf_data = shape->GetFirstSubstructure( int( GMStructTypes::PSurfData ) );
+    if( !psurf_data )
+    {
+        // Files without surface data get the old fixed sampling
+        surface->toggleDefaultVisualizer();
+        auto torus = shape->GetStructureType() == int( GMStructTypes::PTorus );
+        sampling[0] = sampling[1] = torus ? 200 : 50;
+        sampling[2] = sampling[3] = torus ? 1 : 10;
+        return surface;
+    }
+
+    auto visualizer = psurf_data->GetFirstSubstructure( int( GMStructTypes::EnableDefaultVisualizer ) );
+    if( !visualizer || readBool( visualizer, true ) )
+        surface->toggleDefaultVisualizer();
+
+    sampling[0] = sampling[1] = 20;
+    sampling[2] = sampling[3] = 1;
+    if( auto r = psurf_data->GetFirstSubstructure( int( GMStructTypes::Replot ) ) )
+    {
+        auto i = 0;
+        for( auto sub = r->GetFirstSubnode(); sub && i < 4; sub = sub->Next() )
+        {
+            auto d = static_cast<const ODDL::DataStructure<ODDL::Int32DataType>*>(sub);
+            if( d->GetDataElementCount() > 0 )
+                sampling[i++] = d->GetDataElement(0);
+        }
+    }
+
+    return surface;
+}
+
+GMlib::PSurf<float,3>*
+GMlibSceneBuilder::createSurface( const ODDL::Structure* shape )
+{
+    auto type = shape->GetStructureType();
+
+    if( type == int( GMStructTypes::PTorus ) )
+    {
+        auto d = shape->GetFirstSubstructure( int( GMStructTypes::PTorusData ) );
+        return new GMlib::PTorus<float>( d ? readFloat( d, GMStructTypes::SetWheelRadius, 3.0f ) : 3.0f,
+                                         d ? readFloat( d, GMStructTypes::SetTubeRadius1, 1.0f ) : 1.0f,
+                                         d ? readFloat( d, GMStructTypes::SetTubeRadius2, 1.0f ) : 1.0f );
+    }
+    else if( type == int( GMStructTypes::PSphere ) )
+    {
+        auto d = shape->GetFirstSubstructure( int( GMStructTypes::PSphereData ) );
+        return new GMlib::PSphere<float>( d ? readFloat( d, GMStructTypes::SetRadius, 1.0f ) : 1.0f );
+    }
+    else if( type == int( GMStructTypes::PCylinder ) )
+    {
+        // setConstants { float {rx} float {ry} float {h} }
+        float c[3] = { 1.0f, 1.0f, 1.0f };
+        auto d = shape->GetFirstSubstructure( int( GMStructTypes::PCylinderData ) );
+        auto constants = d ? d->GetFirstSubstructure( int( GMStructTypes::SetConstants ) ) : nullptr;
+        if( constants )
+        {
+            auto i = 0;
+            for( auto sub = constants->GetFirstSubnode(); sub && i < 3; sub = sub->Next() )
+            {
+                auto f = static_cast<const ODDL::DataStructure<ODDL::FloatDataType>*>(sub);
+                if( f->GetDataElementCount() > 0 )
+                    c[i++] = f->GetDataElement(0);
+            }
+        }
+        return new GMlib::PCylinder<float>( c[0], c[1], c[2] );
+    }
+    else if( type == int( GMStructTypes::PPlane ) )
+    {
+        // Point, Vector (u), Vector (v)
+        auto d     = shape->GetFirstSubstructure( int( GMStructTypes::PPlaneData ) );
+        auto point = d ? d->GetFirstSubstructure( int( GMStructTypes::Point ) ) : nullptr;
+        auto u     = d ? d->GetFirstSubstructure( int( GMStructTypes::Vector ) ) : nullptr;
+        auto v     = u ? u->Next() : nullptr;
+        if( !point || !u || !v )
+        {
+            std::cerr << "PPlane without plane data" << std::endl;
+            return nullptr;
+        }
+        return new GMlib::PPlane<float>( readVector3(point), readVector3(u), readVector3(v) );
+    }
+
+    return nullptr;
+}
+
+void
+GMlibSceneBuilder::applySceneObjectData( GMlib::SceneObject* obj, const ODDL::Structure* structure )
+{
+    for( auto sub = structure->GetFirstSubnode(); sub; sub = sub->Next() )
+    {
+        auto type = sub->GetStructureType();
+
+        if( type == int( GMStructTypes::Set ) )
+        {
+            // Point, Vector (dir), Vector (up)
+            auto point = sub->GetFirstSubstructure( int( GMStructTypes::Point ) );
+            auto dir   = sub->GetFirstSubstructure( int( GMStructTypes::Vector ) );
+            auto up    = dir ? dir->Next() : nullptr;
+            if( point && dir && up )
+                obj->set( readVector3(point), readVector3(dir), readVector3(up) );
+        }
+        else if( type == int( GMStructTypes::SetCollapsed ) )
+        {
+            obj->setCollapsed( readBool( sub, obj->isCollapsed() ) );
+        }
+        else if( type == int( GMStructTypes::SetLighted ) )
+        {
+            obj->setLighted( readBool( sub, obj->isLighted() ) );
+        }
+        else if( type == int( GMStructTypes::SetVisible ) )
+        {
+            obj->setVisible( readBool( sub, obj->isVisible() ) );
+        }
+        else if( type == int( GMStructTypes::SetStatic ) )
+        {
+            auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj);
+            if( surface && readBool( sub, false ) )
+                _static( surface );
+        }
+        else if( type == int( GMStructTypes::SetColor ) )
+        {
+            if( auto color = sub->GetFirstSubstructure( int( GMStructTypes::Color ) ) )
+                obj->setColor( readColor( color ) );
+        }
+        else if( type == int( GMStructTypes::SetMaterial ) )
+        {
+            auto m = sub->GetFirstSubnode() ? material( sub->GetFirstSubnode() ) : nullptr;
+            if( m ) obj->setMaterial( *m );
+        }
+    }
+}
+
+const GMlib::Material*
+GMlibSceneBuilder::material( const ODDL::Structure* structure )
+{
+    // Follow a reference into the MaterialTable
+    if( structure->GetStructureType() == ODDL::kDataRef )
+    {
+        auto ref = static_cast<const ODDL::DataStructure<ODDL::RefDataType>*>(structure);
+        structure = ref->GetDataElementCount() > 0 ? _description.FindStructure( ref->GetDataElement(0) ) : nullptr;
+
+        if( !structure || structure->GetStructureType() != int( GMStructTypes::Material ) )
+        {
+            std::cerr << "Unresolved material reference" << std::endl;
+            return nullptr;
+        }
+    }
+
+    // Each Material structure is only read once
+    auto cached = _materials.find( structure );
+    if( cached != _materials.end() )
+        return &cached->second;
+
+    // Color (ambient), Color (diffuse), Color (specular), shininess
+    GMlib::Color colors[3];
+    auto no_colors = 0;
+    for( auto sub = structure->GetFirstSubnode(); sub && no_colors < 3; sub = sub->Next() )
+        if( sub->GetStructureType() == int( GMStructTypes::Color ) )
+            colors[no_colors++] = readColor( sub );
+
+    auto shininess = 0.0f;
+    if( auto f = data<ODDL::FloatDataType>(structure) )
+        shininess = f->GetDataElementCount() > 0 ? f->GetDataElement(0) : 0.0f;
+    else if( auto d = data<ODDL::DoubleDataType>(structure) )
+        shininess = d->GetDataElementCount() > 0 ? float(d->GetDataElement(0)) : 0.0f;
+
+    auto inserted = _materials.emplace( structure, GMlib::Material( colors[0], colors[1], colors[2], shininess ) );
+    return &inserted.first->second;
+}
@@ -0,0 +1,55 @@
+#ifndef GMLIBSCENEBUILDER_H
+#define GMLIBSCENEBUILDER_H
+
+#include "gmlibsceneloaderdatadescription.h"
+
+// stl
+#include <functional>
+#include <map>
+#include <vector>
+
+
+namespace GMlib {
+
+class SceneObject;
+class Material;
+
+template <typename T, int n> class PSurf;
+}
+
+
+// Turns a parsed GMlib scene description into GMlib scene objects.
+// Materials referenced from the MaterialTable are read once; GMlib keeps materials by value, so each
+// object using one still gets a copy of it.
+// Objects referring to a prototype are built from the prototype's shape and sampling; whether
+// identical surfaces end up sharing one tessellation is up to the replot function.
+class GMlibSceneBuilder
+{
+public:
+    explicit GMlibSceneBuilder( const GMlibSceneLoaderDataDescription& description );
+    ~GMlibSceneBuilder();
+
+    std::vector<GMlib::SceneObject*>    build();
+
+    // How surfaces get tessellated; by default PSurf::replot, in place
+    using ReplotFunction = std::function<void(GMlib::PSurf<float,3>*,int,int,int,int)>;
+    void                                setReplot( ReplotFunction replot );
+
+    // What is done with surfaces saved as static, before they are replotted; by default nothing
+    using StaticFunction = std::function<void(GMlib::PSurf<float,3>*)>;
+    void                                setStatic( StaticFunction make_static );
+
+private:
+    const GMlibSceneLoaderDataDescription&                          _description;
+    std::map<const ODDL::Structure*, GMlib::Material>               _materials;
+    ReplotFunction                                                  _replot;
+    StaticFunction                                                  _static;
+
+    GMlib::SceneObject*                 buildObject( const ODDL::Structure* structure );
+    GMlib::PSurf<float,3>*              buildSurface( const ODDL::Structure* shape, int sampling[4] );
+    GMlib::PSurf<float,3>*              createSurface( const ODDL::Structure* shape );
+    void                                applySceneObjectData( GMlib::SceneObject* obj, const ODDL::Structure* structure );
+    const GMlib::Material*              material( const ODDL::Structure* structure );
+};
+
+#endif // GMLIBSCENEBUILDER_H
@@ -28,6 +28,9 @@
 #include "setcolorstructure.h"
 
 #include "materialstructure.h"
+#include "materialtablestructure.h"
+#include "prototypesstructure.h"
+#include "shardstructure.h"
 #include "setmaterialstructure.h"
 
 #include "enabledefaultvisualizerstructure.h"
@@ -36,9 +39,10 @@
 #include "setpositionstructure.h"
 #include "setlightedstructure.h"
 #include "setvisiblestructure.h"
+#include "setstaticstructure.h"
 #include "setcollapsedstructure.h"
 
-//#include "propertystructure.h"
+#include "propertystructure.h"
 
 
 ODDL::Structure *GMlibSceneLoaderDataDescription::CreateStructure(
@@ -117,7 +121,19 @@ ODDL::Structure *GMlibSceneLoaderDataDescription::CreateStructure(
     {
         return new ReplotStructure;
     }
-    else if( identifier == "SetCollapsed" )
+    else if( identifier == "MaterialTable" )
+    {
+        return new MaterialTableStructure;
+    }
+    else if( identifier == "Prototypes" )
+    {
+        return new PrototypesStructure;
+    }
+    else if( identifier == "Shard" )
+    {
+        return new ShardStructure;
+    }
+    else if( identifier == "SetCollapsed" || identifier == "setCollapsed" )
     {
         return new SetCollapsedStructure;
     }
@@ -129,7 +145,7 @@ ODDL::Structure *GMlibSceneLoaderDataDescription::CreateStructure(
     {
         return new ReplotStructure;
     }
-    else if( identifier == "enableDefaultVisualizer" )
+    else if( identifier == "enableDefaultVisualizer" || identifier == "enableDefaultVisualize" )
     {
         return new EnableDefaultVisualizerStructure;
     }
@@ -141,10 +157,42 @@ ODDL::Structure *GMlibSceneLoaderDataDescription::CreateStructure(
     {
         return new SetVisibleStructure;
     }
+    else if( identifier == "setStatic" )
+    {
+        return new SetStaticStructure;
+    }
     else if( identifier == "setPosition" )
     {
         return new SetPositionStructure;
     }
+    else if( identifier == "Point" )
+    {
+        return new PropertyStructure( GMStructTypes::Point );
+    }
+    else if( identifier == "Vector" )
+    {
+        return new PropertyStructure( GMStructTypes::Vector );
+    }
+    else if( identifier == "setTubeRadius1" )
+    {
+        return new PropertyStructure( GMStructTypes::SetTubeRadius1 );
+    }
+    else if( identifier == "setTubeRadius2" )
+    {
+        return new PropertyStructure( GMStructTypes::SetTubeRadius2 );
+    }
+    else if( identifier == "setWheelRadius" )
+    {
+        return new PropertyStructure( GMStructTypes::SetWheelRadius );
+    }
+    else if( identifier == "setRadius" )
+    {
+        return new PropertyStructure( GMStructTypes::SetRadius );
+    }
+    else if( identifier == "setConstants" )
+    {
+        return new PropertyStructure( GMStructTypes::SetConstants );
+    }
 
     return nullptr;
 }
@@ -28,9 +28,21 @@ enum class GMStructTypes {
     SetCollapsed            =   ODDL::mc_cast('S', 'T', 'C', 'S'),
     SetLighted              =   ODDL::mc_cast('S', 'T', 'L', 'G'),
     SetVisible              =   ODDL::mc_cast('S', 'T', 'V', 'B'),
+    SetStatic               =   ODDL::mc_cast('S', 'T', 'S', 'T'),
     Material                =   ODDL::mc_cast('M', 'A', 'T', 'L'),
     Replot                  =   ODDL::mc_cast('R', 'E', 'P', 'T'),
-    EnableDefaultVisualizer =   ODDL::mc_cast('E', 'D', 'V', 'I')
+    EnableDefaultVisualizer =   ODDL::mc_cast('E', 'D', 'V', 'I'),
+    MaterialTable           =   ODDL::mc_cast('M', 'T', 'B', 'L'),
+    Property                =   ODDL::mc_cast('P', 'R', 'O', 'P'),
+    Point                   =   ODDL::mc_cast('P', 'O', 'N', 'T'),
+    Vector                  =   ODDL::mc_cast('V', 'E', 'C', 'T'),
+    SetTubeRadius1          =   ODDL::mc_cast('S', 'T', 'R', '1'),
+    SetTubeRadius2          =   ODDL::mc_cast('S', 'T', 'R', '2'),
+    SetWheelRadius          =   ODDL::mc_cast('S', 'W', 'R', 'D'),
+    SetRadius               =   ODDL::mc_cast('S', 'R', 'A', 'D'),
+    SetConstants            =   ODDL::mc_cast('S', 'C', 'N', 'S'),
+    Prototypes              =   ODDL::mc_cast('P', 'R', 'T', 'S'),
+    Shard                   =   ODDL::mc_cast('S', 'H', 'R', 'D')
 };
 
 
@@ -19,6 +19,7 @@ bool
 MaterialStructure::ValidateSubstructure(const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure) const
 {
     auto result = ( structure->GetStructureType() == int( GMStructTypes::Color ) ) |
+                  ( structure->GetStructureType() == ODDL::kDataFloat ) |
                   ( structure->GetStructureType() == ODDL::kDataDouble );
     return result;
 }
@@ -0,0 +1,18 @@
+#include "materialtablestructure.h"
+
+#include "gmlibsceneloaderdatadescription.h"
+
+// stl
+#include "iostream"
+
+MaterialTableStructure::MaterialTableStructure()
+    : ODDL::Structure( int( GMStructTypes::MaterialTable ) )
+{
+    std::cout << "Constructing a MaterialTable object" << std::endl;
+}
+
+bool
+MaterialTableStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure ) const
+{
+    return ( structure->GetStructureType() == int( GMStructTypes::Material ) );
+}
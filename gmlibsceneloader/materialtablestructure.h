@@ -0,0 +1,16 @@
+#ifndef MATERIALTABLESTRUCTURE_H
+#define MATERIALTABLESTRUCTURE_H
+
+#include "../openddl/openddl.h"
+
+// Scene wide list of named materials; setMaterial structures refer to its entries with a ref.
+class MaterialTableStructure : public ODDL::Structure
+{
+public:
+    MaterialTableStructure();
+    ~MaterialTableStructure() = default;
+
+    bool    ValidateSubstructure( const ODDL::DataDescription *dataDescription, const Structure *structure ) const override;
+};
+
+#endif // MATERIALTABLESTRUCTURE_H
@@ -20,7 +20,8 @@ PCylinderDataStructure::ValidateSubstructure( const ODDL::DataDescription *dataD
                     (structure->GetStructureType() == int( GMStructTypes::SetCollapsed)) |
                     (structure->GetStructureType() == int( GMStructTypes::SetLighted)) |
                     (structure->GetStructureType() == int( GMStructTypes::SetVisible)) |
-                    (structure->GetStructureType() == int( GMStructTypes::SetMaterial));
+                    (structure->GetStructureType() == int( GMStructTypes::SetMaterial)) |
+                    (structure->GetStructureType() == int( GMStructTypes::SetConstants));
 
     return result;
 }
@@ -6,12 +6,17 @@
 // stl
 #include "iostream"
 
-PropertyStructure::PropertyStructure()
-    : ODDL::Structure( int( GMStructTypes::Property ) )
+PropertyStructure::PropertyStructure( GMStructTypes type )
+    : ODDL::Structure( int( type ) )
 {
     std::cout << "Constructing a Property object" << std::endl;
 }
 
+PropertyStructure::PropertyStructure()
+    : PropertyStructure( GMStructTypes::Property )
+{
+}
+
 bool
 PropertyStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure ) const
 {
@@ -3,9 +3,14 @@
 
 #include "../openddl/openddl.h"
 
+enum class GMStructTypes;
+
+// Generic "name { primitive }" structure, used for plain setters such as setRadius{ float {1} }.
+// The structure type tells which property it carries.
 class PropertyStructure : public ODDL::Structure
 {
 public:
+    explicit PropertyStructure( GMStructTypes type );
     PropertyStructure();
     ~PropertyStructure() = default;
 
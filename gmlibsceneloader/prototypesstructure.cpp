@@ -0,0 +1,23 @@
+#include "prototypesstructure.h"
+
+#include "gmlibsceneloaderdatadescription.h"
+
+// stl
+#include "iostream"
+
+PrototypesStructure::PrototypesStructure()
+    : ODDL::Structure( int( GMStructTypes::Prototypes ) )
+{
+    std::cout << "Constructing a Prototypes object" << std::endl;
+}
+
+bool
+PrototypesStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure ) const
+{
+    auto type = structure->GetStructureType();
+
+    return ( type == int( GMStructTypes::PTorus )    ||
+             type == int( GMStructTypes::PSphere )   ||
+             type == int( GMStructTypes::PCylinder ) ||
+             type == int( GMStructTypes::PPlane ) );
+}
@@ -0,0 +1,16 @@
+#ifndef PROTOTYPESSTRUCTURE_H
+#define PROTOTYPESSTRUCTURE_H
+
+#include "../openddl/openddl.h"
+
+// Scene wide list of named shapes; objects sharing a shape refer to a prototype with a ref.
+class PrototypesStructure : public ODDL::Structure
+{
+public:
+    PrototypesStructure();
+    ~PrototypesStructure() = default;
+
+    bool    ValidateSubstructure( const ODDL::DataDescription *dataDescription, const Structure *structure ) const override;
+};
+
+#endif // PROTOTYPESSTRUCTURE_H
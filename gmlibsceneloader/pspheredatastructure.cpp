@@ -20,7 +20,8 @@ PSphereDataStructure::ValidateSubstructure( const ODDL::DataDescription *dataDes
                     (structure->GetStructureType() == int( GMStructTypes::SetCollapsed)) |
                     (structure->GetStructureType() == int( GMStructTypes::SetLighted)) |
                     (structure->GetStructureType() == int( GMStructTypes::SetVisible)) |
-                    (structure->GetStructureType() == int( GMStructTypes::SetMaterial));
+                    (structure->GetStructureType() == int( GMStructTypes::SetMaterial)) |
+                    (structure->GetStructureType() == int( GMStructTypes::SetRadius));
 
     return result;
 }
@@ -18,6 +18,9 @@ PSurfStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescripti
 
     auto objectData = structure->GetStructureType() == int( GMStructTypes::PSurfData );
 
-    auto result = sceneObjects | objectData;
+    // Instances refer to the prototype carrying their shape
+    auto prototype = structure->GetStructureType() == ODDL::kDataRef;
+
+    auto result = sceneObjects | objectData | prototype;
     return result;
 }
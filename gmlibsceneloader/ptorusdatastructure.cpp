@@ -20,7 +20,10 @@ PTorusDataStructure::ValidateSubstructure( const ODDL::DataDescription *dataDesc
                     (structure->GetStructureType() == int( GMStructTypes::SetCollapsed)) |
                     (structure->GetStructureType() == int( GMStructTypes::SetLighted)) |
                     (structure->GetStructureType() == int( GMStructTypes::SetVisible)) |
-                    (structure->GetStructureType() == int( GMStructTypes::SetMaterial));
+                    (structure->GetStructureType() == int( GMStructTypes::SetMaterial)) |
+                    (structure->GetStructureType() == int( GMStructTypes::SetTubeRadius1)) |
+                    (structure->GetStructureType() == int( GMStructTypes::SetTubeRadius2)) |
+                    (structure->GetStructureType() == int( GMStructTypes::SetWheelRadius));
 
     return result;
 }
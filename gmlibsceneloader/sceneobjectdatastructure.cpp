@@ -39,6 +39,10 @@ SceneObjectDataStructure::ValidateSubstructure( const ODDL::DataDescription *dat
     {
         correctSubType = true;
     }
+    else if( structure->GetStructureType() == int( GMStructTypes::SetStatic ) )
+    {
+        correctSubType = true;
+    }
     else if( structure->GetStructureType() == int( GMStructTypes::SetMaterial ) )
     {
         correctSubType = true;
@@ -15,6 +15,8 @@ SetMaterialStructure::SetMaterialStructure()
 bool
 SetMaterialStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure) const
 {
-    auto result = ( structure->GetStructureType() == int( GMStructTypes::Material ) );
+    // Either an inline material or a reference into the MaterialTable
+    auto result = ( structure->GetStructureType() == int( GMStructTypes::Material ) ) |
+                  ( structure->GetStructureType() == ODDL::kDataRef );
     return result;
 }
@@ -0,0 +1,19 @@
+#include "setstaticstructure.h"
+
+#include "gmlibsceneloaderdatadescription.h"
+#include "../openddl/openddl.h"
+
+// stl
+#include "iostream"
+
+SetStaticStructure::SetStaticStructure()
+    : ODDL::Structure (int ( GMStructTypes::SetStatic ) )
+{
+    std::cout << "Constructing a SetStaticStructure object" << std::endl;
+}
+
+bool
+SetStaticStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure) const
+{
+    return (structure->GetStructureType() == ODDL::kDataBool);
+}
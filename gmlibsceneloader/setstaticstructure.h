@@ -0,0 +1,15 @@
+#ifndef SETSTATICSTRUCTURE_H
+#define SETSTATICSTRUCTURE_H
+
+#include "../openddl/openddl.h"
+
+class SetStaticStructure : public ODDL::Structure
+{
+public:
+    SetStaticStructure();
+    ~SetStaticStructure() = default;
+
+    bool    ValidateSubstructure( const ODDL::DataDescription *dataDescribtion, const Structure *structure ) const override;
+};
+
+#endif // SETSTATICSTRUCTURE_H
@@ -0,0 +1,22 @@
+#include "shardstructure.h"
+
+#include "gmlibsceneloaderdatadescription.h"
+
+// stl
+#include "iostream"
+
+ShardStructure::ShardStructure()
+    : ODDL::Structure( int( GMStructTypes::Shard ) )
+{
+    std::cout << "Constructing a Shard object" << std::endl;
+}
+
+bool
+ShardStructure::ValidateSubstructure( const ODDL::DataDescription *dataDescription, const ODDL::Structure *structure ) const
+{
+    auto type = structure->GetStructureType();
+
+    return ( type == ODDL::kDataString ||
+             type == ODDL::kDataFloat  ||
+             type == int( GMStructTypes::Point ) );
+}
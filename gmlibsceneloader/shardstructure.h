@@ -0,0 +1,17 @@
+#ifndef SHARDSTRUCTURE_H
+#define SHARDSTRUCTURE_H
+
+#include "../openddl/openddl.h"
+
+// Reference from a scene manifest to one of its shard files:
+// string {file} string {group} Point {bounding sphere center} float {bounding sphere radius}
+class ShardStructure : public ODDL::Structure
+{
+public:
+    ShardStructure();
+    ~ShardStructure() = default;
+
+    bool    ValidateSubstructure( const ODDL::DataDescription *dataDescription, const Structure *structure ) const override;
+};
+
+#endif // SHARDSTRUCTURE_H
@@ -2,6 +2,11 @@
 
 #include "window.h"
 #include "gmlibscenequickfborenderer.h"
+#include "scenario.h"
+#include "frameprofiler.h"
+
+// qt
+#include <QDebug>
 
 GMlibSceneQuickFbo::GMlibSceneQuickFbo() {
 
@@ -10,10 +15,21 @@ GMlibSceneQuickFbo::GMlibSceneQuickFbo() {
 
   setMirrorVertically(true);
 
+  // The renderer sizes the FBO itself, by the performance preset, and makes it again on resizes
+  setTextureFollowsItemSize(false);
+
   connect( this, &QQuickItem::windowChanged,
 
            this, &GMlibSceneQuickFbo::onWindowChanged );
-  _prev_time=std_system_clock::now();
+  _prev_time=std_steady_clock::now();
+
+  // Frames are scheduled from any thread that changes the scene; update() belongs to this one
+  connect( &Scenario::instance(), &Scenario::signRedrawRequested,
+           this, &QQuickItem::update, Qt::QueuedConnection );
+
+  // The rates are evaluated on a timer, frames or not, so an idle scene reads 0 fps
+  connect( &_fps_timer, &QTimer::timeout, this, &GMlibSceneQuickFbo::updateFps );
+  _fps_timer.start(2000);
 }
 
 QQuickFramebufferObject::Renderer*
@@ -71,7 +87,7 @@ GMlibSceneQuickFbo::onWindowChanged(QQuickWindow* w) {
   connect( this,   &GMlibSceneQuickFbo::signWheelEventOccurred,
            window, &Window::signWheelEventOccurred );
 
-  connect (window, &Window::beforeRendering, this,&GMlibSceneQuickFbo::updateFps);
+  connect (window, &Window::beforeRendering, this,&GMlibSceneQuickFbo::countFrame);
 
 
 }
@@ -82,27 +98,135 @@ unsigned int
   return _fps_avg;
 }
 
+double GMlibSceneQuickFbo::vertices() const { return _vertices; }
+
+double GMlibSceneQuickFbo::vertexBudget() const { return _vertex_budget; }
+
+double GMlibSceneQuickFbo::triangles() const { return _triangles; }
+
+double GMlibSceneQuickFbo::triangleBudget() const { return _triangle_budget; }
+
+double GMlibSceneQuickFbo::drawnObjects() const { return _drawn_objects; }
+
+double GMlibSceneQuickFbo::culledObjects() const { return _culled_objects; }
+
+double GMlibSceneQuickFbo::occludedObjects() const { return _occluded_objects; }
+
+QVariantList GMlibSceneQuickFbo::replotStats() const { return _replot_stats; }
+
+QVariantMap GMlibSceneQuickFbo::replotTotals() const { return _replot_totals; }
+
+QVariantList GMlibSceneQuickFbo::frameTimes() const { return _frame_times; }
+
+int GMlibSceneQuickFbo::performancePreset() const { return _performance_preset; }
+
+void GMlibSceneQuickFbo::setPerformancePreset(int preset) {
+
+  preset = qBound(0,preset,int(ResolutionScaler::PresetCount) - 1);
+  if(preset == _performance_preset)
+    return;
+
+  _performance_preset = preset;
+  qDebug() << "Performance preset" << performancePresetName();
+  emit signPerformancePresetChanged();
+  update();
+}
+
+void GMlibSceneQuickFbo::cyclePerformancePreset() {
+
+  setPerformancePreset((_performance_preset + 1) % int(ResolutionScaler::PresetCount));
+}
+
+QString GMlibSceneQuickFbo::performancePresetName() const {
+
+  return QString(ResolutionScaler::name(static_cast<ResolutionScaler::Preset>(_performance_preset)));
+}
+
+void GMlibSceneQuickFbo::setResolution(double scale, int samples) {
+
+  _render_scale = scale;
+  _samples = samples;
+}
+
+double GMlibSceneQuickFbo::renderScale() const { return _render_scale; }
+
+int GMlibSceneQuickFbo::samples() const { return _samples; }
+
+bool GMlibSceneQuickFbo::writeReplotStats(const QString& path) {
+
+  return Scenario::instance().writeReplotStats(path.toStdString());
+}
+
+void GMlibSceneQuickFbo::countFrame() { _fps_counter++; }
+
 void GMlibSceneQuickFbo::updateFps()
 {
 
     using namespace std::chrono;
 
-    auto current_time=system_clock::now();
+    auto current_time=steady_clock::now();
     auto since_prev = duration_cast<milliseconds>(current_time-_prev_time);
 
-    const auto fps_interval = 2;
-
-   // qDebug() << "hello world ";
-
-    if (since_prev>seconds(fps_interval))
-    {
-        _prev_time+=seconds(fps_interval);
-        _fps_avg=_fps_counter/fps_interval;
-        _fps_counter=0;
-        emit signFPSUpdated();
+    _prev_time=current_time;
+    _fps_avg=since_prev.count() > 0 ? static_cast<unsigned int>(_fps_counter*1000/since_prev.count()) : 0;
+    _fps_counter=0;
+    emit signFPSUpdated();
+
+    const auto& scenario = Scenario::instance();
+    _vertices = double(scenario.getVertices());
+    _vertex_budget = double(scenario.getVertexBudget());
+    _triangles = double(scenario.getTriangles());
+    _triangle_budget = double(scenario.getTriangleBudget());
+    _drawn_objects = double(scenario.getDrawnObjects());
+    _culled_objects = double(scenario.getCulledObjects());
+    _occluded_objects = double(scenario.getOccludedObjects());
+    emit signBudgetUpdated();
+
+    _replot_stats.clear();
+    for( const auto& r : scenario.getReplotRows() ) {
+
+      QVariantMap row;
+      row["object"] = QString::fromStdString(r.object);
+      row["identity"] = QString::fromStdString(r.identity);
+      row["samples"] = r.samples_u * r.samples_v;
+      row["samplesText"] = QString("%1 x %2").arg(r.samples_u).arg(r.samples_v);
+      row["time"] = r.time;
+      row["vertexBytes"] = double(r.vertex_bytes);
+      row["indexBytes"] = double(r.index_bytes);
+      row["bytes"] = double(r.vertex_bytes + r.index_bytes);
+      row["age"] = r.age;
+      row["replots"] = r.replots;
+      row["shared"] = r.shared;
+      _replot_stats.append(row);
+    }
 
+    const auto totals = scenario.getReplotTotals();
+    _replot_totals["surfaces"] = double(totals.surfaces);
+    _replot_totals["meshes"] = double(totals.meshes);
+    _replot_totals["time"] = totals.time;
+    _replot_totals["vertexBytes"] = double(totals.vertex_bytes);
+    _replot_totals["indexBytes"] = double(totals.index_bytes);
+    emit signReplotStatsUpdated();
+
+    _frame_times.clear();
+    const auto& profiler = FrameProfiler::instance();
+    for( auto i = 0; i < FrameProfiler::PhaseCount; ++i ) {
+
+      const auto phase = static_cast<FrameProfiler::Phase>(i);
+      const auto p = profiler.getPercentiles(phase);
+
+      QVariantMap times;
+      times["phase"] = QString(FrameProfiler::name(phase));
+      times["p50"] = p.p50;
+      times["p95"] = p.p95;
+      times["p99"] = p.p99;
+      times["max"] = p.max;
+      times["count"] = double(p.count);
+      _frame_times.append(times);
     }
+    emit signFrameTimesUpdated();
 
-    _fps_counter++;
+    // As the renderer left them at its last frame
+    emit signResolutionUpdated();
 
 }
@@ -1,8 +1,14 @@
 #ifndef GMLIBSCENEQUICKFBO
 #define GMLIBSCENEQUICKFBO
 
+// local
+#include "resolutionscaler.h"
+
 // qt
 #include <QtQuick/QQuickFramebufferObject>
+#include <QVariantList>
+#include <QVariantMap>
+#include <QTimer>
 
 // stl
 #include <chrono>
@@ -15,15 +21,77 @@ public:
 
   Renderer*         createRenderer() const override;
   Q_PROPERTY(unsigned int fps READ fps NOTIFY signFPSUpdated)
+  Q_PROPERTY(double vertices READ vertices NOTIFY signBudgetUpdated)
+  Q_PROPERTY(double vertexBudget READ vertexBudget NOTIFY signBudgetUpdated)
+  Q_PROPERTY(double triangles READ triangles NOTIFY signBudgetUpdated)
+  Q_PROPERTY(double triangleBudget READ triangleBudget NOTIFY signBudgetUpdated)
+  Q_PROPERTY(double drawnObjects READ drawnObjects NOTIFY signBudgetUpdated)
+  Q_PROPERTY(double culledObjects READ culledObjects NOTIFY signBudgetUpdated)
+  Q_PROPERTY(double occludedObjects READ occludedObjects NOTIFY signBudgetUpdated)
+  Q_PROPERTY(QVariantList replotStats READ replotStats NOTIFY signReplotStatsUpdated)
+  Q_PROPERTY(QVariantMap replotTotals READ replotTotals NOTIFY signReplotStatsUpdated)
+  Q_PROPERTY(QVariantList frameTimes READ frameTimes NOTIFY signFrameTimesUpdated)
+  Q_PROPERTY(int performancePreset READ performancePreset WRITE setPerformancePreset NOTIFY signPerformancePresetChanged)
+  Q_PROPERTY(QString performancePresetName READ performancePresetName NOTIFY signPerformancePresetChanged)
+  Q_PROPERTY(double renderScale READ renderScale NOTIFY signResolutionUpdated)
+  Q_PROPERTY(int samples READ samples NOTIFY signResolutionUpdated)
+
+  // CSV of the replot stats, relative to the working directory
+  Q_INVOKABLE bool  writeReplotStats( const QString& path );
+
+  // A ResolutionScaler::Preset; taken up by the renderer at the next frame
+  int               performancePreset() const;
+  void              setPerformancePreset( int preset );
+  Q_INVOKABLE void  cyclePerformancePreset();
+
+  // Renderer, while the item is synchronized
+  void              setResolution( double scale, int samples );
 private:
 
-  using std_system_clock = std::chrono::system_clock;
-  using std_time_point = std_system_clock::time_point;
+  using std_steady_clock = std::chrono::steady_clock;
+  using std_time_point = std_steady_clock::time_point;
   unsigned int fps() const;
+  double vertices() const;
+  double vertexBudget() const;
+  double triangles() const;
+  double triangleBudget() const;
+  double drawnObjects() const;
+  double culledObjects() const;
+  double occludedObjects() const;
+  QVariantList replotStats() const;
+  QVariantMap replotTotals() const;
+  QVariantList frameTimes() const;
+  QString performancePresetName() const;
+  double renderScale() const;
+  int samples() const;
 
   unsigned int _fps_avg {0};
   unsigned int _fps_counter{0};
   std_time_point _prev_time;
+  QTimer _fps_timer;
+
+  // Tessellation of the scene against its budget
+  double _vertices {0};
+  double _vertex_budget {0};
+  double _triangles {0};
+  double _triangle_budget {0};
+
+  // Objects at the top of the scene, drawn and left out by frustum and occlusion culling
+  double _drawn_objects {0};
+  double _culled_objects {0};
+  double _occluded_objects {0};
+
+  // One map per surface, the fields of ReplotStats::Row; and the scene totals
+  QVariantList _replot_stats;
+  QVariantMap _replot_totals;
+
+  // One map per FrameProfiler phase: name, p50, p95, p99, max in milliseconds, and count
+  QVariantList _frame_times;
+
+  // Of the scene FBO; the scale and samples as last set by the renderer
+  int _performance_preset {ResolutionScaler::Quality};
+  double _render_scale {1.0};
+  int _samples {0};
 
 
 protected:
@@ -39,11 +107,17 @@ protected:
 
 private slots:
   void              onWindowChanged( QQuickWindow* window );
+  void              countFrame();
   void              updateFps();
 
 
 signals:
   void              signFPSUpdated();
+  void              signBudgetUpdated();
+  void              signReplotStatsUpdated();
+  void              signFrameTimesUpdated();
+  void              signPerformancePresetChanged();
+  void              signResolutionUpdated();
   void              signKeyPressed( QKeyEvent* event );
   void              signKeyReleased( QKeyEvent* event );
   void              signMouseDoubleClicked( QMouseEvent* event );
@@ -1,50 +1,128 @@
 #include "gmlibscenequickfborenderer.h"
 
 #include "scenario.h"
+#include "frameprofiler.h"
 #include "gmlibscenequickfbo.h"
 
 //qt
 #include <QOpenGLFramebufferObjectFormat>
 #include <QQuickWindow>
 
+// stl
+#include <chrono>
+
 GMlibSceneQuickFboRenderer::GMlibSceneQuickFboRenderer() {
 
   _gl.initializeOpenGLFunctions();
+
+  // Needs OpenGL 3.3 or ARB_timer_query
+  _timer_created = _timer.create();
 }
 
 QOpenGLFramebufferObject*
 GMlibSceneQuickFboRenderer::createFramebufferObject(const QSize& size)  {
 
-  _size = size;
+  // The item does not follow its size; the size it asks for is that of the item in pixels
+  _full_size = size;
 
+  int width, height;
+  _scaler.scaledSize(size.width(),size.height(),width,height);
+  _size = QSize(width,height);
+
+  // A multisampled FBO is resolved by the item before it is composed
   QOpenGLFramebufferObjectFormat format;
   format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
-  return new QOpenGLFramebufferObject(size, format);
+  format.setSamples(_scaler.getSettings().samples);
+  return new QOpenGLFramebufferObject(_size, format);
 }
 
 void
 GMlibSceneQuickFboRenderer::render() {
 
+  FrameProfiler::Scope frame(FrameProfiler::Frame);
+
   // Pick up the FBO set by the QQuickFrameBufferObject upon the render() call
   _gl.glGetIntegerv(GL_FRAMEBUFFER_BINDING,&_rt.fbo());
 
   // Prepare render and camera
   auto &scenario = Scenario::instance();
-  scenario.render(QRect(QPoint(0,0),QSize(_size)),_rt);
+
+  // Mouse positions come in the points of the item
+  if(!_item_size.isEmpty())
+    scenario.setInputScale(float(_size.width() / _item_size.width()), float(_size.height() / _item_size.height()));
+
+  // Adaptive presets time the scene; on the GPU one query at a time, read once it is done
+  measure();
+  const auto adaptive = _scaler.getSettings().adaptive;
+  const auto query = adaptive && _timer_created && !_timer_running;
+  const auto started = std::chrono::steady_clock::now();
+  if(query)
+    _timer.begin();
+  {
+    FrameProfiler::Scope timing(FrameProfiler::Render);
+    scenario.render(QRect(QPoint(0,0),QSize(_size)),_rt);
+  }
+  if(query) {
+    _timer.end();
+    _timer_running = true;
+  }
+  else if(adaptive && !_timer_created) {
+    std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - started;
+    if(_scaler.record(elapsed.count()))
+      _rescale = true;
+  }
 
   // Not necessary, but for clarity let's restore the full GL state as we entered the render() method
   _gl.glBindFramebuffer(GL_FRAMEBUFFER,_rt.fbo());
 
   // Restore to QML's GLState;
   // we do not know what GMlib has done
-  _item->window()->resetOpenGLState();
+  {
+    FrameProfiler::Scope timing(FrameProfiler::ResetState);
+    _item->window()->resetOpenGLState();
+  }
 
-  // Throttle
-  update();
+  // Throttle; in render on demand mode an idle scene is left alone until something changes.
+  // A new scale is taken up by the next frame
+  if(scenario.needsRedraw() || _rescale)
+    update();
 }
 
 void
 GMlibSceneQuickFboRenderer::synchronize(QQuickFramebufferObject* item) {
 
   _item = static_cast<GMlibSceneQuickFbo*>(item);
+
+  // The FBO is made again for another preset, scale or item size
+  const auto preset = static_cast<ResolutionScaler::Preset>(_item->performancePreset());
+  if(preset != _scaler.getPreset()) {
+
+    // A query still running timed the old preset; it is left unread
+    _scaler.setPreset(preset);
+    _timer_running = false;
+    _rescale = true;
+  }
+
+  // Sized as the item sizes the FBOs it asks for
+  QSize full(qMax(1,int(_item->width())),qMax(1,int(_item->height())));
+  full *= _item->window() ? _item->window()->devicePixelRatio() : 1.0;
+  if(_rescale || (!_full_size.isEmpty() && full != _full_size))
+    invalidateFramebufferObject();
+  _rescale = false;
+
+  _item_size = QSizeF(_item->width(),_item->height());
+  _item->setResolution(_scaler.getScale(),_scaler.getSettings().samples);
+}
+
+void
+GMlibSceneQuickFboRenderer::measure() {
+
+  // The query of an earlier frame, once the GPU is done with it
+  if(!_timer_running || !_timer.isResultAvailable())
+    return;
+
+  _timer_running = false;
+  const auto nanoseconds = _timer.waitForResult();
+  if(_scaler.getSettings().adaptive && _scaler.record(double(nanoseconds) / 1e6))
+    _rescale = true;
 }
@@ -4,17 +4,24 @@
 
 // local
 #include "inlinefborendertarget.h"
+#include "resolutionscaler.h"
 
 // qt
 #include <QSize>
+#include <QSizeF>
 #include <QtQuick/QQuickFramebufferObject>
 #include <QOpenGLFunctions>
+#include <QOpenGLTimerQuery>
 
 
 class Window;
 class GMlibSceneQuickFbo;
 
 
+// The FBO is sized by the performance preset of the item, scaled down from the size of the
+// item under adaptive presets, and stretched over the item when composed. Adaptive presets
+// are fed the time of the scene on the GPU, from timer queries read once they are done, or
+// the time on the CPU where there are none.
 class GMlibSceneQuickFboRenderer : public QQuickFramebufferObject::Renderer {
 
 public:
@@ -31,7 +38,17 @@ private:
   GMlibSceneQuickFbo*         _item;
   Window*                     _window;
   QSize                       _size;
+  QSize                       _full_size;
+  QSizeF                      _item_size;
   InlineFboRenderTarget       _rt;
+
+  ResolutionScaler            _scaler;
+  bool                        _rescale {false};
+  QOpenGLTimerQuery           _timer;
+  bool                        _timer_created {false};
+  bool                        _timer_running {false};
+
+  void                        measure();
 };
 
 
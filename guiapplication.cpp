@@ -1,6 +1,9 @@
 #include "guiapplication.h"
+#include "frameprofiler.h"
+#include "gmlibscenequickfbo.h"
 
 // qt
+#include <QQuickItem>
 #include <QOpenGLContext>
 #include <QDebug>
 #include <QInputEvent>
@@ -15,12 +18,30 @@ GuiApplication::GuiApplication(int& argc, char **argv) : QGuiApplication(argc, a
 
     setApplicationDisplayName( "Aleksei Degtiarev" );
 
+    // A benchmark script to replay once the scene is up, and where its results go
+    auto args = arguments();
+    for( auto option : { QString("--replay"), QString("--json") } ) {
+        const auto i = args.indexOf(option);
+        if( i > 0 && i + 1 < args.size() ) {
+            ( option == "--replay" ? _replay_script : _replay_json ) = args.at(i + 1);
+            args.erase( args.begin() + i, args.begin() + i + 2 );
+        }
+    }
+
+    // Optional scene file (or manifest) to save to and load from,
+    // and the cell size used to split the scene into shards when saving
+    if( args.size() > 1 )
+        _scenario.setScenePath( args.at(1).toStdString() );
+    if( args.size() > 2 )
+        _scenario.setShardCellSize( args.at(2).toFloat() );
+
     connect(this, &QGuiApplication::lastWindowClosed,this, &QGuiApplication::quit );
     connect(this, &GuiApplication::signOnSceneGraphInitializedDone, this, &GuiApplication::afterOnSceneGraphInitialized );
     connect(&_window, &Window::sceneGraphInitialized,this, &GuiApplication::onSceneGraphInitialized,Qt::DirectConnection );
     connect(&_window, &Window::sceneGraphInvalidated, this, &GuiApplication::onSceneGraphInvalidated, Qt::DirectConnection );
     connect(&_window,&Window::signKeyPressed, this,&GuiApplication::handleKeyPress);
     connect(&_window, &Window::beforeRendering, this, &GuiApplication::handleGLInputEvents, Qt::DirectConnection);
+    connect(&_scenario, &Scenario::signReplayFinished, &_window, &Window::close, Qt::QueuedConnection);
 
     // **************************************************************
     connect(&_window, &Window::signMousePressed, this, &GuiApplication::handleMouseButtonPressedEvents);
@@ -64,8 +85,14 @@ GuiApplication::onSceneGraphInitialized() {
 void
 GuiApplication::afterOnSceneGraphInitialized() {
 
-    // Start simulator
-    _scenario.startSimulation();
+    // Start simulator, unless a replay drives the scene
+    if( _replay_script.isEmpty() ) {
+        _scenario.startSimulation();
+        return;
+    }
+
+    if( !_scenario.startReplay( _replay_script.toStdString(), _replay_json.toStdString(), "windowed" ) )
+        _window.close();
 }
 
 void GuiApplication::onSceneGraphInvalidated() {
@@ -79,6 +106,11 @@ void GuiApplication::onSceneGraphInvalidated() {
 //Must call information from scenario;
 void GuiApplication::handleGLInputEvents()
 {
+    FrameProfiler::Scope timing(FrameProfiler::Input);
+
+    // Edits go in between simulation steps
+    auto lock = _scenario.lockScene();
+
     while ( !_input_events.empty()) {
         const auto& e = _input_events.front();
         const auto& ke = std::dynamic_pointer_cast<const QKeyEvent>(e);
@@ -121,6 +153,55 @@ void GuiApplication::handleGLInputEvents()
             _scenario.deleteObject();
         }
 
+        // Loading replots surfaces, so it runs next to the renderer
+        if(ke and ke->key() == Qt::Key_L){
+            _scenario.load();}
+
+        if(ke and ke->key() == Qt::Key_V)
+        {
+            qDebug() << "Toggling automatic level of detail";
+            _scenario.toggleAutomaticLod();
+        }
+
+        if(ke and ke->key() == Qt::Key_G)
+        {
+            qDebug() << "Toggling progressive replot";
+            _scenario.toggleProgressiveReplot();
+        }
+
+        // Shared meshes tessellated from now on are cache ordered and quantized
+        if(ke and ke->key() == Qt::Key_M)
+        {
+            qDebug() << "Toggling packed meshes";
+            _scenario.togglePackedMeshes();
+        }
+
+        // Surfaces sharing a packed mesh are drawn with one call
+        if(ke and ke->key() == Qt::Key_J)
+        {
+            qDebug() << "Toggling instancing";
+            _scenario.toggleInstancing();
+        }
+
+        // Selected surfaces in or out of the static batches
+        if(ke and ke->key() == Qt::Key_T){
+            _scenario.toggleStaticSelected();}
+
+        // The visible surfaces as a mesh file, written in the background
+        if(ke and ke->key() == Qt::Key_E)
+        {
+            _scenario.exportMeshes();
+        }
+
+        if(ke and ke->key() == Qt::Key_K){
+            _scenario.toggleFrustumCulling();}
+
+        if(ke and ke->key() == Qt::Key_H){
+            _scenario.toggleOcclusionCulling();}
+
+        if(ke and ke->key() == Qt::Key_I){
+            _scenario.printReplotStats();}
+
 
 
 
@@ -147,6 +228,9 @@ void GuiApplication::handleGLInputEvents()
 
         _input_events.pop();
     }
+
+    // Stream shards of a sharded scene in and out around the camera
+    _scenario.updateShards();
 }
 
 void GuiApplication::handleKeyPress(QKeyEvent *e)
@@ -167,10 +251,18 @@ void GuiApplication::handleKeyPress(QKeyEvent *e)
     else  if (e->key()==Qt::Key_4){_scenario.switchCamera(4);}
 
     else  if (e->key()==Qt::Key_S) {_scenario.save();}
-    else  if (e->key()==Qt::Key_L) {_scenario.load();}
     else  if (e->key()==Qt::Key_U){_scenario.unlockObjs();}
+    else  if (e->key()==Qt::Key_F){_scenario.toggleRenderOnDemand();}
+
+    // Resolution and multisampling of the scene FBO
+    else  if (e->key()==Qt::Key_X){
+        auto root = _window.rootObject();
+        if(auto fbo = root ? root->findChild<GMlibSceneQuickFbo*>() : nullptr) fbo->cyclePerformancePreset();}
 
     else _input_events.push(std::make_shared<QKeyEvent>(*e));
+
+    // Input is handled, or queued for, the next frame
+    _scenario.requestRedraw();
 }
 
 //Mouse Click Handler
@@ -192,6 +284,7 @@ void GuiApplication::handleMouseButtonPressedEvents(QMouseEvent *m) {
         _input_events.push(std::make_shared<QMouseEvent>(*m));
     }
 
+    _scenario.requestRedraw();
 }
 
 //Mouse Move Handler
@@ -208,6 +301,8 @@ void GuiApplication::handleMouseMovementEvents(QMouseEvent *v) {
 
         else
         { _input_events.push(std::make_shared<QMouseEvent>(*v));}
+
+        _scenario.requestRedraw();
     }
 }
 
@@ -231,6 +326,8 @@ void GuiApplication::handleMouseWheel(QWheelEvent *w){
     if (w->modifiers()==Qt::ControlModifier){_scenario.movePan(delta,'H');}
     if (w->modifiers()==Qt::AltModifier){_input_events.push(std::make_shared<QWheelEvent>(*w));
     }
+
+    _scenario.requestRedraw();
 }
 
 // **************************************************************
@@ -26,6 +26,10 @@ private:
     Scenario                                    _scenario;
     std::queue<std::shared_ptr<QInputEvent>> _input_events;
 
+    // --replay script [--json file]
+    QString                                     _replay_script;
+    QString                                     _replay_json;
+
 
     // **************************************************************
     bool                                        _Mouse_pressed;
@@ -0,0 +1,305 @@
+#include "headlessrenderer.h"
+
+#include "inlinefborendertarget.h"
+#include "frameprofiler.h"
+
+// gmlib
+#include <gmCoreModule>
+
+// qt
+#include <QCommandLineParser>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QImage>
+#include <QOpenGLFramebufferObjectFormat>
+#include <QOpenGLFunctions>
+#include <QTextStream>
+
+// stl
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <iomanip>
+
+
+HeadlessRenderer::HeadlessRenderer() {}
+
+HeadlessRenderer::~HeadlessRenderer() {}
+
+bool
+HeadlessRenderer::isRequested(int argc, char** argv) {
+
+  for(auto i = 1; i < argc; ++i)
+    if(std::strcmp(argv[i],"--headless") == 0)
+      return true;
+
+  return false;
+}
+
+bool
+HeadlessRenderer::parse(const QStringList& arguments, Options& options) {
+
+  QCommandLineParser parser;
+  parser.addHelpOption();
+  parser.addOption({"headless", "Render without a window."});
+  parser.addOption({"frames", "Frames to render.", "N", QString::number(options.frames)});
+  parser.addOption({"size", "Framebuffer size.", "WxH", "800x600"});
+  parser.addOption({"poses", "Camera poses, nine numbers a line.", "file"});
+  parser.addOption({"images", "Directory to write a PNG per frame into.", "dir"});
+  parser.addOption({"timings", "CSV of the frame times.", "file"});
+  parser.addOption({"no-settle", "Don't wait for the replots of a frame before rendering it."});
+  parser.addOption({"replay", "Benchmark script to replay instead of the poses.", "file"});
+  parser.addOption({"json", "Results of the replay.", "file"});
+  parser.addPositionalArgument("scene", "Scene file (or manifest) to load.");
+
+  if(!parser.parse(arguments)) {
+    std::cerr << parser.errorText().toStdString() << std::endl;
+    return false;
+  }
+  if(parser.isSet("help")) {
+    std::cout << parser.helpText().toStdString() << std::endl;
+    return false;
+  }
+
+  auto ok = true;
+  options.frames = std::max(parser.value("frames").toInt(&ok), 0);
+  if(!ok) {
+    std::cerr << "--frames takes a number" << std::endl;
+    return false;
+  }
+
+  const auto size = parser.value("size").split('x');
+  if(size.size() != 2 || size[0].toInt() <= 0 || size[1].toInt() <= 0) {
+    std::cerr << "--size takes WxH" << std::endl;
+    return false;
+  }
+  options.size = QSize(size[0].toInt(),size[1].toInt());
+
+  options.poses   = parser.value("poses");
+  options.images  = parser.value("images");
+  options.timings = parser.value("timings");
+  options.settle  = !parser.isSet("no-settle");
+  options.replay  = parser.value("replay");
+  options.json    = parser.value("json");
+  if(!parser.positionalArguments().isEmpty())
+    options.scene = parser.positionalArguments().first();
+
+  return true;
+}
+
+bool
+HeadlessRenderer::readPoses(const QString& path, std::vector<Pose>& poses) {
+
+  QFile file(path);
+  if(!file.open(QIODevice::ReadOnly | QIODevice::Text))
+    return false;
+
+  QTextStream in(&file);
+  while(!in.atEnd()) {
+
+    auto line = in.readLine();
+    line = line.left(line.indexOf('#')).trimmed();
+    if(line.isEmpty())
+      continue;
+
+    const auto values = line.split(QRegExp("[\\s,]+"),QString::SkipEmptyParts);
+    if(values.size() != 9) {
+      std::cerr << "Pose needs nine numbers: " << line.toStdString() << std::endl;
+      return false;
+    }
+
+    Pose pose;
+    for(auto k = 0; k < 3; ++k) {
+      pose.pos[k] = values[k].toFloat();
+      pose.dir[k] = values[3 + k].toFloat();
+      pose.up[k]  = values[6 + k].toFloat();
+    }
+    poses.push_back(pose);
+  }
+
+  return true;
+}
+
+bool
+HeadlessRenderer::createContext() {
+
+  // As the window asks for; with the compatibility profile unavailable, as with llvmpipe on
+  // older Mesa, a 3.3 core profile, which is what GMlib needs
+  QSurfaceFormat format;
+  format.setVersion(4,0);
+  format.setProfile(QSurfaceFormat::CompatibilityProfile);
+  format.setOption(QSurfaceFormat::DeprecatedFunctions);
+  format.setDepthBufferSize(24);
+  format.setStencilBufferSize(8);
+
+  _context.setFormat(format);
+  if(!_context.create() || _context.format().version() < qMakePair(3,3)) {
+
+    format.setVersion(3,3);
+    format.setProfile(QSurfaceFormat::CoreProfile);
+    _context.setFormat(format);
+    if(!_context.create())
+      return false;
+  }
+
+  _surface.setFormat(_context.format());
+  _surface.create();
+  if(!_surface.isValid())
+    return false;
+
+  return _context.makeCurrent(&_surface);
+}
+
+void
+HeadlessRenderer::renderFrame(const QSize& size) {
+
+  // As the window does before each frame
+  _scenario.updateShards();
+
+  _fbo->bind();
+  _rt->fbo() = GLint(_fbo->handle());
+  _scenario.render(QRect(QPoint(0,0),size),*_rt);
+}
+
+int
+HeadlessRenderer::run(const Options& options) {
+
+  std::vector<Pose> poses;
+  if(!options.poses.isEmpty() && !readPoses(options.poses,poses)) {
+    std::cerr << "Can't read poses from " << options.poses.toStdString() << std::endl;
+    return 1;
+  }
+
+  if(!createContext()) {
+    std::cerr << "No OpenGL context for offscreen rendering" << std::endl;
+    return 1;
+  }
+
+  auto gl = _context.functions();
+  std::cout << "OpenGL " << _context.format().majorVersion() << "." << _context.format().minorVersion()
+            << ", " << reinterpret_cast<const char*>(gl->glGetString(GL_RENDERER)) << std::endl;
+
+  if(!options.images.isEmpty() && !QDir().mkpath(options.images)) {
+    std::cerr << "Can't create " << options.images.toStdString() << std::endl;
+    return 1;
+  }
+
+  std::ofstream timings;
+  if(!options.timings.isEmpty()) {
+    timings.open(options.timings.toStdString());
+    if(!timings) {
+      std::cerr << "Can't write " << options.timings.toStdString() << std::endl;
+      return 1;
+    }
+    timings << "frame,render_ms,settle_ms\n";
+  }
+
+  QOpenGLFramebufferObjectFormat format;
+  format.setAttachment(QOpenGLFramebufferObject::CombinedDepthStencil);
+  _fbo = std::make_unique<QOpenGLFramebufferObject>(options.size,format);
+  _rt  = std::make_unique<InlineFboRenderTarget>();
+
+  // The scenario as the window sets it up; the simulation is not run, so frames only differ
+  // by their pose
+  _scenario.initialize();
+  _scenario.initializeScenario();
+  _scenario.prepare();
+  if(!options.scene.isEmpty()) {
+    _scenario.setScenePath(options.scene.toStdString());
+    _scenario.load();
+  }
+  _scenario.stopSimulation();
+
+  if(!options.replay.isEmpty())
+    return replay(options);
+
+  using clock = std::chrono::steady_clock;
+  auto total = 0.0;
+
+  for(auto frame = 0; frame < options.frames; ++frame) {
+
+    if(!poses.empty()) {
+      const auto& pose = poses[size_t(frame) % poses.size()];
+      _scenario.setCameraFrame(GMlib::Point<float,3>(pose.pos[0],pose.pos[1],pose.pos[2]),
+                               GMlib::Vector<float,3>(pose.dir[0],pose.dir[1],pose.dir[2]),
+                               GMlib::Vector<float,3>(pose.up[0],pose.up[1],pose.up[2]));
+    }
+
+    // The shards near the pose are read first; the level of detail of the pose is then picked by
+    // a frame, and sampled in the background
+    auto settle = 0.0;
+    if(options.settle) {
+      const auto started = clock::now();
+      _scenario.finishShards();
+      renderFrame(options.size);
+      _scenario.finishTessellation();
+      settle = std::chrono::duration<double,std::milli>(clock::now() - started).count();
+    }
+
+    // Timed up to the GPU being done with the frame
+    const auto started = clock::now();
+    renderFrame(options.size);
+    gl->glFinish();
+    const auto elapsed = clock::now() - started;
+    const auto ms = std::chrono::duration<double,std::milli>(elapsed).count();
+
+    FrameProfiler::instance().record(FrameProfiler::Frame,elapsed);
+    total += ms;
+
+    if(timings.is_open())
+      timings << frame << ',' << ms << ',' << settle << '\n';
+
+    if(!options.images.isEmpty()) {
+      const auto path = QDir(options.images).filePath(QString("frame_%1.png").arg(frame,4,10,QChar('0')));
+      if(!_fbo->toImage().save(path))
+        std::cerr << "Can't write " << path.toStdString() << std::endl;
+    }
+  }
+
+  if(options.frames > 0) {
+    const auto p = FrameProfiler::instance().getPercentiles(FrameProfiler::Frame);
+    std::cout << options.frames << " frames at " << options.size.width() << "x" << options.size.height()
+              << ", " << std::fixed << std::setprecision(2) << total / options.frames << " ms average, p50 "
+              << p.p50 << ", p95 " << p.p95 << ", p99 " << p.p99 << ", max " << p.max << " ms" << std::endl;
+  }
+
+  release();
+  return 0;
+}
+
+int
+HeadlessRenderer::replay(const Options& options) {
+
+  if(!_scenario.startReplay(options.replay.toStdString(),options.json.toStdString(),"headless")) {
+    release();
+    return 1;
+  }
+
+  // The replay times its frames itself, and stops when the script is done
+  for(auto frame = 0; _scenario.isReplaying(); ++frame) {
+
+    renderFrame(options.size);
+
+    if(!options.images.isEmpty()) {
+      const auto path = QDir(options.images).filePath(QString("frame_%1.png").arg(frame,4,10,QChar('0')));
+      if(!_fbo->toImage().save(path))
+        std::cerr << "Can't write " << path.toStdString() << std::endl;
+    }
+  }
+
+  release();
+  return 0;
+}
+
+void
+HeadlessRenderer::release() {
+
+  _fbo->release();
+  _fbo.reset();
+  _rt.reset();
+  _scenario.deinitialize();
+  _context.doneCurrent();
+}
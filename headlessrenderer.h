@@ -0,0 +1,81 @@
+#ifndef HEADLESSRENDERER_H
+#define HEADLESSRENDERER_H
+
+
+// local
+#include "scenario.h"
+
+// qt
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QSize>
+#include <QString>
+#include <QStringList>
+
+// stl
+#include <memory>
+#include <vector>
+
+
+class InlineFboRenderTarget;
+
+
+// Renders the scenario into an FBO of an offscreen surface, without a window or QML, for batch
+// jobs and benchmarks on machines without a display. Software GL, such as Mesa's llvmpipe with
+// LIBGL_ALWAYS_SOFTWARE=1, does; the offscreen platform plugin is picked unless another is set.
+//
+//   3d-editor --headless [--frames N] [--size WxH] [--poses file] [--images dir]
+//             [--timings file.csv] [--no-settle] [scene]
+//   3d-editor --headless --replay script [--json file] [--size WxH] [--images dir] [scene]
+//
+// Poses are read one per line: position, direction and up, nine numbers; '#' starts a comment.
+// They are used in turn for the N frames; without poses the default camera is kept.
+// Before each frame the shards it loads and the replots it causes are waited for, unless
+// --no-settle, so the images do not depend on how fast the disk and the background tessellation are.
+// With --replay a benchmark script is played instead, see ReplayBenchmark, for as many
+// frames as it takes.
+class HeadlessRenderer {
+public:
+  struct Pose {
+    float           pos[3];
+    float           dir[3];
+    float           up[3];
+  };
+
+  struct Options {
+    int             frames {100};
+    QSize           size {800,600};
+    QString         poses;
+    QString         images;
+    QString         timings;
+    QString         scene;
+    QString         replay;
+    QString         json;
+    bool            settle {true};
+  };
+
+  HeadlessRenderer();
+  ~HeadlessRenderer();
+
+  static bool       isRequested(int argc, char** argv);
+  static bool       parse(const QStringList& arguments, Options& options);
+  static bool       readPoses(const QString& path, std::vector<Pose>& poses);
+
+  // Exit code
+  int               run(const Options& options);
+
+private:
+  Scenario                                    _scenario;
+  QOpenGLContext                              _context;
+  QOffscreenSurface                           _surface;
+  std::unique_ptr<QOpenGLFramebufferObject>   _fbo;
+  std::unique_ptr<InlineFboRenderTarget>      _rt;
+
+  bool              createContext();
+  void              renderFrame(const QSize& size);
+  int               replay(const Options& options);
+  void              release();
+};
+
+#endif // HEADLESSRENDERER_H
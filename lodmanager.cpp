@@ -0,0 +1,277 @@
+#include "lodmanager.h"
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <queue>
+
+
+LodManager::LodManager() {
+
+    // Top levels match Scenario::replotHigh.
+    // Interval counts with factors of two, so progressive replots can refine towards them.
+    setLadder( "PTorus",    { {0.0f,  9,  9}, {48.0f, 25, 25}, {160.0f, 65, 65}, {400.0f, 201, 201} } );
+    setLadder( "PSphere",   { {0.0f,  9,  9}, {48.0f, 25, 25}, {160.0f, 65, 65}, {400.0f, 201, 201} } );
+    setLadder( "PCylinder", { {0.0f,  7,  7}, {48.0f, 21, 21}, {160.0f, 65, 65}, {400.0f, 201, 201} } );
+    setLadder( "PPlane",    { {0.0f,  2,  2}, {200.0f, 11, 11} } );
+}
+
+void LodManager::setEnabled( bool enabled ) { _enabled = enabled; }
+
+bool LodManager::isEnabled() const { return _enabled; }
+
+void LodManager::setInterval( unsigned int frames ) { _interval = std::max( 1u, frames ); }
+
+void LodManager::setHysteresis( float fraction ) { _hysteresis = std::max( 0.0f, fraction ); }
+
+void LodManager::setMaxReplotsPerUpdate( int count ) { _max_replots = std::max( 1, count ); }
+
+void LodManager::setLadder( const std::string& identity, const std::vector<Level>& ladder ) {
+
+    auto& levels = _ladders[identity];
+    levels = ladder;
+    std::sort( levels.begin(), levels.end(),
+               []( const Level& a, const Level& b ) { return a.min_size < b.min_size; } );
+}
+
+void LodManager::setBudget( size_t vertices, size_t triangles ) { _budget = Usage{ vertices, triangles }; }
+
+const LodManager::Usage& LodManager::getBudget() const { return _budget; }
+
+const LodManager::Usage& LodManager::getUsage() const { return _usage; }
+
+void LodManager::setSelectedWeight( float weight ) { _selected_weight = std::max( 0.0f, weight ); }
+
+void LodManager::setManual( const GMlib::SceneObject* obj, bool manual ) {
+
+    if( manual ) {
+        _manual.insert(obj);
+        _levels.erase(obj);
+    }
+    else
+        _manual.erase(obj);
+}
+
+void LodManager::forget( const GMlib::SceneObject* obj ) {
+
+    _levels.erase(obj);
+    _manual.erase(obj);
+}
+
+void LodManager::invalidate() { _due = true; }
+
+bool LodManager::isPending() const { return _enabled && ( _due || _deferred ); }
+
+std::vector<LodManager::Replot>
+LodManager::update( GMlib::Scene& scene, const GMlib::Camera& camera, int viewport_width, int viewport_height ) {
+
+    std::vector<Replot> replots;
+    if( !_enabled || _frame++ % _interval )
+        return replots;
+    _due = false;
+    _deferred = false;
+
+    // Projected diameter in pixels is pixels * radius / distance
+    auto pixels = float( viewport_height / camera.getAngleTan() );
+    auto aspect = viewport_height > 0 ? float(viewport_width) / float(viewport_height) : 1.0f;
+    auto tan_diagonal = float( camera.getAngleTan() ) * std::sqrt( 1.0f + aspect * aspect );
+
+    // Rebuilt every pass, so objects removed from the scene are forgotten
+    std::vector<Candidate> candidates;
+    Usage fixed;
+    for( auto i = 0; i < scene.getSize(); ++i )
+        visit( scene[i], camera, pixels, tan_diagonal, candidates, fixed );
+
+    fit( candidates, fixed );
+
+    // Coarsening goes first, so the budget holds even when not every replot fits in this pass
+    std::stable_sort( candidates.begin(), candidates.end(), []( const Candidate& a, const Candidate& b ) {
+        auto a_down = a.current >= 0 && a.level < a.current;
+        auto b_down = b.current >= 0 && b.level < b.current;
+        return a_down != b_down ? a_down : a.priority > b.priority;
+    });
+
+    std::map<const GMlib::SceneObject*,int> levels;
+    auto used = fixed;
+    for( auto& c : candidates ) {
+
+        const auto& target = (*c.ladder)[size_t(c.level)];
+        auto changed = c.current >= 0 ? c.level != c.current
+                                      : c.surface->getSamplesU() != target.samples_u ||
+                                        c.surface->getSamplesV() != target.samples_v;
+
+        // Over the replot limit the object keeps its level, and is looked at again next pass
+        if( changed && int(replots.size()) >= _max_replots ) {
+
+            _deferred = true;
+            auto kept = c.current >= 0 ? usage( (*c.ladder)[size_t(c.current)].samples_u, (*c.ladder)[size_t(c.current)].samples_v )
+                                       : usage( c.surface->getSamplesU(), c.surface->getSamplesV() );
+            used.vertices  += kept.vertices;
+            used.triangles += kept.triangles;
+            if( c.current >= 0 ) levels[c.surface] = c.current;
+            continue;
+        }
+
+        if( changed )
+            replots.push_back( Replot{ c.surface, target.samples_u, target.samples_v } );
+        levels[c.surface] = c.level;
+
+        auto u = usage( target.samples_u, target.samples_v );
+        used.vertices  += u.vertices;
+        used.triangles += u.triangles;
+    }
+
+    _levels.swap(levels);
+    _usage = used;
+    return replots;
+}
+
+void LodManager::fitToBudget( const GMlib::PSurf<float,3>* surface, int& m1, int& m2 ) {
+
+    // Surfaces under automatic control are accounted for by update()
+    if( _levels.count(surface) )
+        return;
+
+    auto current = usage( surface->getSamplesU(), surface->getSamplesV() );
+    auto wanted  = usage( m1, m2 );
+
+    auto rest = []( size_t budget, size_t used, size_t mine ) -> double {
+        auto others = used - std::min( used, mine );
+        return budget > others ? double( budget - others ) : 0.0;
+    };
+    auto vertices  = rest( _budget.vertices,  _usage.vertices,  current.vertices );
+    auto triangles = rest( _budget.triangles, _usage.triangles, current.triangles );
+
+    if( double(wanted.vertices) > vertices || double(wanted.triangles) > triangles ) {
+
+        // Both directions scaled alike
+        auto scale = std::sqrt( std::min( vertices / std::max( 1.0, double(wanted.vertices) ),
+                                          triangles / std::max( 1.0, double(wanted.triangles) ) ) );
+        m1 = std::max( 2, int( float(m1) * float(scale) ) );
+        m2 = std::max( 2, int( float(m2) * float(scale) ) );
+        wanted = usage( m1, m2 );
+    }
+
+    _usage.vertices  = _usage.vertices  - std::min( _usage.vertices,  current.vertices )  + wanted.vertices;
+    _usage.triangles = _usage.triangles - std::min( _usage.triangles, current.triangles ) + wanted.triangles;
+}
+
+void LodManager::visit( GMlib::SceneObject* obj, const GMlib::Camera& camera, float pixels, float tan_diagonal,
+                        std::vector<Candidate>& candidates, Usage& fixed ) {
+
+    if( !obj ) return;
+
+    auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        visit( children(i), camera, pixels, tan_diagonal, candidates, fixed );
+
+    auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj);
+    if( !surface ) return;
+
+    // Surfaces outside automatic control count with what they have
+    auto ladder = _ladders.find( obj->getIdentity() );
+    if( _manual.count(obj) || ladder == _ladders.end() || ladder->second.empty() ) {
+
+        auto u = usage( surface->getSamplesU(), surface->getSamplesV() );
+        fixed.vertices  += u.vertices;
+        fixed.triangles += u.triangles;
+        return;
+    }
+
+    const auto& sphere = obj->getSurroundingSphere();
+    auto distance = ( sphere.getPos() - camera.getPos() ).getLength();
+    auto size = distance > sphere.getRadius() ? pixels * sphere.getRadius() / distance
+                                              : ladder->second.back().min_size * 2.0f + 1.0f;
+
+    auto previous = _levels.find(obj);
+    auto current  = previous != _levels.end() ? previous->second : -1;
+    auto visible  = isInView( sphere, camera, tan_diagonal );
+
+    // Out of view the level is kept; those surfaces are the first to give up their samples
+    auto level    = visible || current < 0 ? pickLevel( ladder->second, size, current ) : current;
+    auto priority = visible ? size * size * ( obj->isSelected() ? _selected_weight : 1.0f ) : 0.0f;
+
+    candidates.push_back( Candidate{ surface, &ladder->second, priority, current, level } );
+}
+
+int LodManager::pickLevel( const std::vector<Level>& ladder, float size, int current ) const {
+
+    auto n = int(ladder.size());
+
+    // First sight: no history, plain thresholds
+    if( current < 0 || current >= n ) {
+
+        auto level = 0;
+        while( level + 1 < n && size >= ladder[size_t(level + 1)].min_size )
+            ++level;
+        return level;
+    }
+
+    auto level = current;
+    while( level + 1 < n && size >= ladder[size_t(level + 1)].min_size * (1.0f + _hysteresis) )
+        ++level;
+    while( level > 0 && size < ladder[size_t(level)].min_size * (1.0f - _hysteresis) )
+        --level;
+
+    return level;
+}
+
+void LodManager::fit( std::vector<Candidate>& candidates, Usage used ) const {
+
+    for( const auto& c : candidates ) {
+        auto u = usage( (*c.ladder)[size_t(c.level)].samples_u, (*c.ladder)[size_t(c.level)].samples_v );
+        used.vertices  += u.vertices;
+        used.triangles += u.triangles;
+    }
+
+    auto over = [this,&used]() { return used.vertices > _budget.vertices || used.triangles > _budget.triangles; };
+    if( !over() )
+        return;
+
+    // Least priority on top
+    auto lower = [&candidates]( size_t a, size_t b ) { return candidates[a].priority > candidates[b].priority; };
+    std::priority_queue<size_t,std::vector<size_t>,decltype(lower)> queue( lower );
+    for( size_t i = 0; i < candidates.size(); ++i )
+        if( candidates[i].level > 0 )
+            queue.push(i);
+
+    // One level at a time
+    while( over() && !queue.empty() ) {
+
+        auto& c = candidates[queue.top()];
+        queue.pop();
+
+        const auto& ladder = *c.ladder;
+        auto before = usage( ladder[size_t(c.level)].samples_u, ladder[size_t(c.level)].samples_v );
+        --c.level;
+        auto after  = usage( ladder[size_t(c.level)].samples_u, ladder[size_t(c.level)].samples_v );
+
+        used.vertices  = used.vertices  - before.vertices  + after.vertices;
+        used.triangles = used.triangles - before.triangles + after.triangles;
+
+        if( c.level > 0 )
+            queue.push( size_t( &c - candidates.data() ) );
+    }
+}
+
+LodManager::Usage LodManager::usage( int m1, int m2 ) {
+
+    // As drawn by the default visualizer, which samples at least two by two
+    if( m1 <= 0 || m2 <= 0 )
+        return Usage();
+
+    m1 = std::max( m1, 2 );
+    m2 = std::max( m2, 2 );
+    return Usage{ size_t(m1) * size_t(m2), 2 * size_t(m1 - 1) * size_t(m2 - 1) };
+}
+
+bool LodManager::isInView( const GMlib::Sphere<float,3>& sphere, const GMlib::Camera& camera, float tan_diagonal ) {
+
+    // Sphere against the cone around the view direction that encloses the view frustum
+    auto d     = sphere.getPos() - camera.getPos();
+    auto dir   = camera.getDir();
+    auto along = d * dir;
+    auto side  = ( d - dir * along ).getLength();
+
+    return side <= along * tan_diagonal + sphere.getRadius() * std::sqrt( 1.0f + tan_diagonal * tan_diagonal );
+}
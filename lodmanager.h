@@ -0,0 +1,111 @@
+#ifndef LODMANAGER_H
+#define LODMANAGER_H
+
+
+// gmlib
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+// stl
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+
+
+// Screen space level of detail for parametric surfaces, within a scene wide budget.
+// Every few frames the projected diameter of each surface's bounding sphere is estimated,
+// and a sample count is picked from the ladder of the surface type (GMlib identity).
+// A level is only left once the size is clearly past its threshold, so surfaces near a
+// threshold do not flicker between two tessellations.
+//
+// The vertices and triangles of all surfaces are kept within a budget. When the picked levels
+// do not fit, the surfaces with the least priority are coarsened first: priority is the
+// projected area, higher for selected surfaces, and zero for surfaces out of view. Surfaces
+// leaving the view keep their mesh until the budget is needed elsewhere.
+class LodManager {
+public:
+    struct Level {
+        float                                         min_size;     // projected diameter in pixels
+        int                                           samples_u;
+        int                                           samples_v;
+    };
+
+    struct Replot {
+        GMlib::PSurf<float,3>*                        surface;
+        int                                           samples_u;
+        int                                           samples_v;
+    };
+
+    struct Usage {
+        size_t                                        vertices {0};
+        size_t                                        triangles {0};
+    };
+
+    LodManager();
+
+    void                                              setEnabled( bool enabled );
+    bool                                              isEnabled() const;
+    void                                              setInterval( unsigned int frames );
+    void                                              setHysteresis( float fraction );
+    void                                              setMaxReplotsPerUpdate( int count );
+    void                                              setLadder( const std::string& identity, const std::vector<Level>& ladder );
+
+    void                                              setBudget( size_t vertices, size_t triangles );
+    const Usage&                                      getBudget() const;
+    const Usage&                                      getUsage() const;
+    void                                              setSelectedWeight( float weight );
+
+    // Surfaces replotted by hand keep their sampling
+    void                                              setManual( const GMlib::SceneObject* obj, bool manual = true );
+
+    // Drops what is kept of obj; before it is deleted or removed from the scene
+    void                                              forget( const GMlib::SceneObject* obj );
+
+    // The camera or the scene changed: a pass is due, whether or not more frames are drawn
+    void                                              invalidate();
+    // Until a pass after the last change has run, and while replots held back by the limit are left
+    bool                                              isPending() const;
+
+    // Called once per frame; returns the surfaces to replot
+    std::vector<Replot>                               update( GMlib::Scene& scene, const GMlib::Camera& camera,
+                                                              int viewport_width, int viewport_height );
+
+    // Lowers a sampling asked for by hand to what is left of the budget
+    void                                              fitToBudget( const GMlib::PSurf<float,3>* surface, int& m1, int& m2 );
+
+private:
+    struct Candidate {
+        GMlib::PSurf<float,3>*                        surface;
+        const std::vector<Level>*                     ladder;
+        float                                         priority;
+        int                                           current;
+        int                                           level;
+    };
+
+    std::map<std::string,std::vector<Level>>          _ladders;
+    std::map<const GMlib::SceneObject*,int>           _levels;
+    std::set<const GMlib::SceneObject*>               _manual;
+
+    bool                                              _enabled {true};
+    unsigned int                                      _interval {10};
+    unsigned int                                      _frame {0};
+    bool                                              _due {true};
+    bool                                              _deferred {false};
+    float                                             _hysteresis {0.25f};
+    int                                               _max_replots {8};
+
+    Usage                                             _budget {4000000, 8000000};
+    Usage                                             _usage;
+    float                                             _selected_weight {4.0f};
+
+    void                                              visit( GMlib::SceneObject* obj, const GMlib::Camera& camera, float pixels, float tan_diagonal,
+                                                             std::vector<Candidate>& candidates, Usage& fixed );
+    int                                               pickLevel( const std::vector<Level>& ladder, float size, int current ) const;
+    void                                              fit( std::vector<Candidate>& candidates, Usage usage ) const;
+
+    static Usage                                      usage( int m1, int m2 );
+    static bool                                       isInView( const GMlib::Sphere<float,3>& sphere, const GMlib::Camera& camera, float tan_diagonal );
+};
+
+#endif // LODMANAGER_H
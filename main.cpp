@@ -1,4 +1,5 @@
 #include "guiapplication.h"
+#include "headlessrenderer.h"
 
 // gmlib
 #include <core/gmglobal>
@@ -37,6 +38,22 @@ int main(int argc, char *argv[]) try {
   else
     std::cout << "GMlib version: " << GM_VERSION_STR << std::endl;
 
+  // Batch rendering into an offscreen FBO, no display needed
+  if( HeadlessRenderer::isRequested( argc, argv ) ) {
+
+    if( qEnvironmentVariableIsEmpty( "QT_QPA_PLATFORM" ) )
+      qputenv( "QT_QPA_PLATFORM", "offscreen" );
+
+    QGuiApplication a(argc, argv);
+
+    HeadlessRenderer::Options options;
+    if( !HeadlessRenderer::parse( a.arguments(), options ) )
+      return 1;
+
+    HeadlessRenderer headless;
+    return headless.run(options);
+  }
+
   // Create the application object
   GuiApplication a(argc, argv);
 
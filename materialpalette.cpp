@@ -0,0 +1,79 @@
+#include "materialpalette.h"
+
+// gmlib
+#include <gmOpenglModule>
+
+
+const MaterialPalette& MaterialPalette::presets() {
+
+    static const auto palette = []() {
+
+        MaterialPalette p;
+        p.insert( "BlackPlastic",   GMlib::GMmaterial::BlackPlastic );
+        p.insert( "BlackRubber",    GMlib::GMmaterial::BlackRubber );
+        p.insert( "Brass",          GMlib::GMmaterial::Brass );
+        p.insert( "Bronze",         GMlib::GMmaterial::Bronze );
+        p.insert( "Chrome",         GMlib::GMmaterial::Chrome );
+        p.insert( "Copper",         GMlib::GMmaterial::Copper );
+        p.insert( "Emerald",        GMlib::GMmaterial::Emerald );
+        p.insert( "Gold",           GMlib::GMmaterial::Gold );
+        p.insert( "Jade",           GMlib::GMmaterial::Jade );
+        p.insert( "Obsidian",       GMlib::GMmaterial::Obsidian );
+        p.insert( "Pearl",          GMlib::GMmaterial::Pearl );
+        p.insert( "Pewter",         GMlib::GMmaterial::Pewter );
+        p.insert( "Plastic",        GMlib::GMmaterial::Plastic );
+        p.insert( "PolishedBronze", GMlib::GMmaterial::PolishedBronze );
+        p.insert( "PolishedCopper", GMlib::GMmaterial::PolishedCopper );
+        p.insert( "PolishedGold",   GMlib::GMmaterial::PolishedGold );
+        p.insert( "PolishedGreen",  GMlib::GMmaterial::PolishedGreen );
+        p.insert( "PolishedRed",    GMlib::GMmaterial::PolishedRed );
+        p.insert( "PolishedSilver", GMlib::GMmaterial::PolishedSilver );
+        p.insert( "Ruby",           GMlib::GMmaterial::Ruby );
+        p.insert( "Sapphire",       GMlib::GMmaterial::Sapphire );
+        p.insert( "Silver",         GMlib::GMmaterial::Silver );
+        p.insert( "Snow",           GMlib::GMmaterial::Snow );
+        p.insert( "Turquoise",      GMlib::GMmaterial::Turquoise );
+        return p;
+    }();
+
+    return palette;
+}
+
+void MaterialPalette::clear() { _entries.clear(); }
+
+int MaterialPalette::insert(const GMlib::Material &material) {
+
+    auto i = find(material);
+    if( i >= 0 )
+        return i;
+
+    // Presets keep their GMlib name, anything else gets a generated one
+    const auto& p = presets();
+    auto preset = (this != &p) ? p.find(material) : -1;
+    if( preset >= 0 )
+        insert( p.getName(preset), material );
+    else
+        insert( "Material" + std::to_string(_entries.size()), material );
+
+    return getSize() - 1;
+}
+
+void MaterialPalette::insert(const std::string &name, const GMlib::Material &material) {
+
+    _entries.emplace_back(name,material);
+}
+
+int MaterialPalette::find(const GMlib::Material &material) const {
+
+    for( auto i = 0; i < getSize(); ++i )
+        if( _entries[i].second == material )
+            return i;
+
+    return -1;
+}
+
+int MaterialPalette::getSize() const { return int(_entries.size()); }
+
+const std::string& MaterialPalette::getName(int i) const { return _entries[i].first; }
+
+const GMlib::Material& MaterialPalette::getMaterial(int i) const { return _entries[i].second; }
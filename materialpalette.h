@@ -0,0 +1,34 @@
+#ifndef MATERIALPALETTE_H
+#define MATERIALPALETTE_H
+
+
+// gmlib
+#include <gmSceneModule>
+
+// stl
+#include <string>
+#include <utility>
+#include <vector>
+
+
+// Ordered set of named materials.
+// Used for the material cycle in Scenario::changeColor and for the MaterialTable of saved scenes.
+class MaterialPalette {
+public:
+    static const MaterialPalette&                     presets();   // GMlib::GMmaterial presets
+
+    void                                              clear();
+    int                                               insert( const GMlib::Material& material );
+    int                                               find( const GMlib::Material& material ) const;
+
+    int                                               getSize() const;
+    const std::string&                                getName( int i ) const;
+    const GMlib::Material&                            getMaterial( int i ) const;
+
+private:
+    std::vector<std::pair<std::string,GMlib::Material>>   _entries;
+
+    void                                              insert( const std::string& name, const GMlib::Material& material );
+};
+
+#endif // MATERIALPALETTE_H
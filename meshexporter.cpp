@@ -0,0 +1,407 @@
+#include "meshexporter.h"
+#include "scenefile.h"
+#include "threadpool.h"
+#include "tessellation/packedsurfacevisualizer.h"
+
+// stl
+#include <algorithm>
+#include <cctype>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <future>
+#include <limits>
+#include <sstream>
+
+
+namespace {
+
+    // The binary formats are little endian, as is every platform the editor runs on
+    template <typename T>
+    void put( std::string& data, const T& value ) {
+
+        data.append( reinterpret_cast<const char*>(&value), sizeof(T) );
+    }
+
+    bool endsWith( const std::string& s, const std::string& suffix ) {
+
+        if( s.size() < suffix.size() )
+            return false;
+
+        return std::equal( suffix.rbegin(), suffix.rend(), s.rbegin(),
+                           []( char a, char b ) { return std::tolower( static_cast<unsigned char>(a) ) == std::tolower( static_cast<unsigned char>(b) ); } );
+    }
+
+    std::string jsonString( const std::string& s ) {
+
+        std::string quoted = "\"";
+        for( auto c : s ) {
+            if( c == '"' || c == '\\' ) quoted += '\\';
+            if( static_cast<unsigned char>(c) >= 0x20 ) quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    // Row major grid, two triangles per cell, counter clockwise seen along the normal
+    template <typename F>
+    void forEachTriangle( int m1, int m2, F f ) {
+
+        for( auto i = 0; i < m1 - 1; ++i ) {
+            for( auto j = 0; j < m2 - 1; ++j ) {
+
+                const auto a = uint32_t( i * m2 + j );
+                const auto b = a + uint32_t(m2);
+                f( a, b, a + 1 );
+                f( b, b + 1, a + 1 );
+            }
+        }
+    }
+
+    const uint32_t glb_magic     = 0x46546C67;     // "glTF"
+    const uint32_t glb_json      = 0x4E4F534A;     // "JSON"
+    const uint32_t glb_bin       = 0x004E4942;     // "BIN\0"
+}
+
+
+
+bool MeshExporter::format( const std::string& filename, Format& format ) {
+
+    if( endsWith( filename, ".stl" ) )      format = Format::Stl;
+    else if( endsWith( filename, ".obj" ) ) format = Format::Obj;
+    else if( endsWith( filename, ".glb" ) ) format = Format::Glb;
+    else return false;
+
+    return true;
+}
+
+void MeshExporter::collect( GMlib::Scene& scene, int m1, int m2 ) {
+
+    _items.clear();
+    _m1 = std::max( m1, 2 );
+    _m2 = std::max( m2, 2 );
+
+    for( auto i = 0; i < scene.getSize(); ++i )
+        visit( scene[i] );
+}
+
+void MeshExporter::visit( GMlib::SceneObject* obj ) {
+
+    if( !obj || !obj->isVisible() )
+        return;
+
+    if( auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj) ) {
+
+        Item item;
+
+        std::ostringstream name;
+        name << obj->getIdentity() << " " << obj->getName();
+        item.name   = name.str();
+        item.matrix = PackedSurfaceVisualizer::getModelMatrix(obj);
+        PackedSurfaceVisualizer::getNormalMatrix( item.matrix, item.normal_matrix );
+
+        const auto& dif = obj->getMaterial().getDif();
+        item.color[0] = float( dif.getRedC() );
+        item.color[1] = float( dif.getGreenC() );
+        item.color[2] = float( dif.getBlueC() );
+        item.color[3] = float( dif.getAlphaC() );
+
+        // Shapes that cannot be copied are evaluated here, on the render thread
+        item.sampler = SurfaceSampler::create(surface);
+        if( !item.sampler )
+            item.samples = sampleInPlace( surface, _m1, _m2 );
+
+        _items.push_back(item);
+    }
+
+    auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        visit( children(i) );
+}
+
+MeshExporter::Result MeshExporter::write( const std::string& filename, Format format ) const {
+
+    auto started = std::chrono::steady_clock::now();
+
+    // With a fixed resolution the vertices of a surface start at a known index, which is what
+    // the OBJ faces refer to; every chunk can then be formatted independently
+    const auto vertex_count = size_t(_m1) * size_t(_m2);
+
+    std::vector<std::future<Chunk>> jobs;
+    jobs.reserve( _items.size() );
+    for( size_t i = 0; i < _items.size(); ++i ) {
+
+        const auto& item = _items[i];
+        jobs.push_back( ThreadPool::instance().submit( [this,&item,format,i,vertex_count]() {
+            return chunk( item, format, i * vertex_count );
+        }));
+    }
+
+    std::vector<Chunk> chunks;
+    chunks.reserve( jobs.size() );
+    for( auto& job : jobs )
+        chunks.push_back( job.get() );
+
+    Result result;
+    result.surfaces = chunks.size();
+    for( const auto& c : chunks ) {
+        result.vertices  += c.vertices;
+        result.triangles += c.triangles;
+    }
+
+    // Everything ahead of the chunks, then the chunks as they are
+    std::vector<std::string> buffers;
+    buffers.reserve( chunks.size() + 1 );
+
+    switch( format ) {
+    case Format::Stl: {
+        std::string header( 80, ' ' );
+        const std::string title = "3d-editor";
+        header.replace( 0, title.size(), title );
+        put( header, uint32_t( result.triangles ) );
+        buffers.push_back( std::move(header) );
+        break;
+    }
+    case Format::Obj:
+        buffers.push_back( "# 3d-editor\n" );
+        break;
+    case Format::Glb:
+        buffers.push_back( glbHeader( _items, chunks ) );
+        break;
+    }
+
+    for( auto& c : chunks )
+        buffers.push_back( std::move(c.data) );
+
+    for( const auto& b : buffers )
+        result.bytes += b.size();
+
+    result.written = SceneFile::write( filename, buffers );
+    result.time    = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - started ).count();
+    return result;
+}
+
+MeshExporter::Chunk MeshExporter::chunk( const Item& item, Format format, size_t first_vertex ) const {
+
+    auto samples = item.sampler ? item.sampler->sample( _m1, _m2, 1, 1 ) : item.samples;
+    const auto m1 = samples->m1;
+    const auto m2 = samples->m2;
+
+    // To the scene as the surface is drawn; the normals with the inverse transpose
+    std::vector<GMlib::Point<float,3>>  points;
+    std::vector<GMlib::Vector<float,3>> normals;
+    points.reserve( size_t(m1) * size_t(m2) );
+    normals.reserve( size_t(m1) * size_t(m2) );
+
+    Chunk c;
+    for( auto k = 0; k < 3; ++k ) {
+        c.min[k] =  std::numeric_limits<float>::max();
+        c.max[k] = -std::numeric_limits<float>::max();
+    }
+
+    for( auto i = 0; i < m1; ++i ) {
+        for( auto j = 0; j < m2; ++j ) {
+
+            const auto& l = samples->normals[i][j];
+            const auto& t = item.normal_matrix;
+            auto p = item.matrix * GMlib::Point<float,3>( samples->p[i][j][0][0] );
+            auto n = GMlib::Vector<float,3>( t[0] * l[0] + t[1] * l[1] + t[2] * l[2],
+                                             t[3] * l[0] + t[4] * l[1] + t[5] * l[2],
+                                             t[6] * l[0] + t[7] * l[1] + t[8] * l[2] );
+            auto length = n.getLength();
+
+            points.push_back(p);
+            normals.push_back( length > 0.0f ? n / length : n );
+
+            for( auto k = 0; k < 3; ++k ) {
+                c.min[k] = std::min( c.min[k], p[k] );
+                c.max[k] = std::max( c.max[k], p[k] );
+            }
+        }
+    }
+
+    c.vertices  = points.size();
+    c.triangles = 2 * size_t(m1 - 1) * size_t(m2 - 1);
+
+    // Where the derivatives are parallel, at the poles, the sampler leaves the normal zero; glTF
+    // wants unit normals, these get the area weighted normal of the triangles around them
+    auto zero = []( const GMlib::Vector<float,3>& n ) { return !( n.getLength() > 0.0f ); };
+    if( std::any_of( normals.begin(), normals.end(), zero ) ) {
+
+        std::vector<GMlib::Vector<float,3>> fallback( normals.size(), GMlib::Vector<float,3>( 0.0f ) );
+        forEachTriangle( m1, m2, [&]( uint32_t a, uint32_t b, uint32_t d ) {
+            const auto face = ( points[b] - points[a] ) ^ ( points[d] - points[a] );
+            for( auto v : { a, b, d } )
+                fallback[v] += face;
+        });
+
+        for( size_t v = 0; v < normals.size(); ++v ) {
+            if( !zero( normals[v] ) )
+                continue;
+
+            const auto length = fallback[v].getLength();
+            normals[v] = length > 0.0f ? fallback[v] / length : GMlib::Vector<float,3>( 0.0f, 0.0f, 1.0f );
+        }
+    }
+
+    switch( format ) {
+    case Format::Stl: {
+
+        // Facet normal, three corners and a zero attribute word, 50 bytes a triangle
+        c.data.reserve( c.triangles * 50 );
+        forEachTriangle( m1, m2, [&]( uint32_t a, uint32_t b, uint32_t d ) {
+
+            auto n = ( points[b] - points[a] ) ^ ( points[d] - points[a] );
+            auto length = n.getLength();
+            if( length > 0.0f ) n /= length;
+
+            for( auto k = 0; k < 3; ++k ) put( c.data, n[k] );
+            for( auto v : { a, b, d } )
+                for( auto k = 0; k < 3; ++k ) put( c.data, points[v][k] );
+            put( c.data, uint16_t(0) );
+        });
+        break;
+    }
+    case Format::Obj: {
+
+        c.data.reserve( c.vertices * 80 + c.triangles * 40 );
+        c.data += "o " + item.name + "\n";
+
+        char line[128];
+        for( const auto& p : points ) {
+            auto length = std::snprintf( line, sizeof(line), "v %.7g %.7g %.7g\n", double(p[0]), double(p[1]), double(p[2]) );
+            c.data.append( line, size_t(length) );
+        }
+        for( const auto& n : normals ) {
+            auto length = std::snprintf( line, sizeof(line), "vn %.6g %.6g %.6g\n", double(n[0]), double(n[1]), double(n[2]) );
+            c.data.append( line, size_t(length) );
+        }
+
+        // One based, over the whole file
+        const auto base = first_vertex + 1;
+        forEachTriangle( m1, m2, [&]( uint32_t a, uint32_t b, uint32_t d ) {
+            auto length = std::snprintf( line, sizeof(line), "f %zu//%zu %zu//%zu %zu//%zu\n",
+                                         base + a, base + a, base + b, base + b, base + d, base + d );
+            c.data.append( line, size_t(length) );
+        });
+        break;
+    }
+    case Format::Glb: {
+
+        // Positions, normals and indices of the primitive, each a multiple of four bytes
+        c.data.reserve( c.vertices * 24 + c.triangles * 12 );
+        for( const auto& p : points )
+            for( auto k = 0; k < 3; ++k ) put( c.data, p[k] );
+        for( const auto& n : normals )
+            for( auto k = 0; k < 3; ++k ) put( c.data, n[k] );
+        forEachTriangle( m1, m2, [&]( uint32_t a, uint32_t b, uint32_t d ) {
+            put( c.data, a );
+            put( c.data, b );
+            put( c.data, d );
+        });
+        break;
+    }
+    }
+
+    return c;
+}
+
+std::shared_ptr<SurfaceSamples> MeshExporter::sampleInPlace( GMlib::PSurf<float,3>* surface, int m1, int m2 ) {
+
+    auto samples = std::make_shared<SurfaceSamples>();
+    samples->m1 = m1;
+    samples->m2 = m2;
+    samples->d1 = 1;
+    samples->d2 = 1;
+    samples->p.setDim( m1, m2 );
+    samples->normals.setDim( m1, m2 );
+
+    const auto su = surface->getParStartU();
+    const auto sv = surface->getParStartV();
+    const auto du = surface->getParDeltaU() / float(m1 - 1);
+    const auto dv = surface->getParDeltaV() / float(m2 - 1);
+
+    for( auto i = 0; i < m1; ++i ) {
+        for( auto j = 0; j < m2; ++j ) {
+
+            auto& p = samples->p[i][j];
+            p = surface->evaluate( su + float(i) * du, sv + float(j) * dv, 1, 1 );
+
+            auto n = GMlib::Vector<float,3>( p[1][0] ) ^ p[0][1];
+            auto length = n.getLength();
+            samples->normals[i][j] = length > 0.0f ? n / length : n;
+        }
+    }
+
+    return samples;
+}
+
+std::string MeshExporter::glbHeader( const std::vector<Item>& items, const std::vector<Chunk>& chunks ) {
+
+    // One node, mesh and material per surface; a position, normal and index accessor and buffer
+    // view each per mesh, all in the one binary chunk
+    std::ostringstream nodes, meshes, materials, views, accessors;
+    accessors.precision(9);     // bounds exact to the float
+
+    size_t offset = 0;
+    for( size_t i = 0; i < chunks.size(); ++i ) {
+
+        const auto& c = chunks[i];
+        const auto& item = items[i];
+        const auto sep = i ? "," : "";
+        const auto attributes = c.vertices * 12;
+        const auto indices = c.triangles * 12;
+
+        nodes << sep << "{\"mesh\":" << i << ",\"name\":" << jsonString(item.name) << "}";
+
+        meshes << sep << "{\"primitives\":[{\"attributes\":{\"POSITION\":" << 3 * i << ",\"NORMAL\":" << 3 * i + 1
+               << "},\"indices\":" << 3 * i + 2 << ",\"material\":" << i << "}]}";
+
+        materials << sep << "{\"pbrMetallicRoughness\":{\"baseColorFactor\":["
+                  << item.color[0] << "," << item.color[1] << "," << item.color[2] << "," << item.color[3]
+                  << "],\"metallicFactor\":0,\"roughnessFactor\":0.5}}";
+
+        views << sep << "{\"buffer\":0,\"byteOffset\":" << offset << ",\"byteLength\":" << attributes << ",\"target\":34962},"
+              << "{\"buffer\":0,\"byteOffset\":" << offset + attributes << ",\"byteLength\":" << attributes << ",\"target\":34962},"
+              << "{\"buffer\":0,\"byteOffset\":" << offset + 2 * attributes << ",\"byteLength\":" << indices << ",\"target\":34963}";
+        offset += 2 * attributes + indices;
+
+        accessors << sep << "{\"bufferView\":" << 3 * i << ",\"componentType\":5126,\"count\":" << c.vertices << ",\"type\":\"VEC3\""
+                  << ",\"min\":[" << c.min[0] << "," << c.min[1] << "," << c.min[2] << "]"
+                  << ",\"max\":[" << c.max[0] << "," << c.max[1] << "," << c.max[2] << "]},"
+                  << "{\"bufferView\":" << 3 * i + 1 << ",\"componentType\":5126,\"count\":" << c.vertices << ",\"type\":\"VEC3\"},"
+                  << "{\"bufferView\":" << 3 * i + 2 << ",\"componentType\":5125,\"count\":" << 3 * c.triangles << ",\"type\":\"SCALAR\"}";
+    }
+
+    std::ostringstream json;
+    json << "{\"asset\":{\"version\":\"2.0\",\"generator\":\"3d-editor\"},\"scene\":0,\"scenes\":[{\"nodes\":[";
+    for( size_t i = 0; i < chunks.size(); ++i )
+        json << ( i ? "," : "" ) << i;
+    json << "]}],\"nodes\":[" << nodes.str() << "],\"meshes\":[" << meshes.str() << "],\"materials\":[" << materials.str()
+         << "],\"bufferViews\":[" << views.str() << "],\"accessors\":[" << accessors.str() << "]";
+    if( offset > 0 )
+        json << ",\"buffers\":[{\"byteLength\":" << offset << "}]";
+    json << "}";
+
+    // The JSON chunk is padded with spaces; the binary chunk needs none, it is made of 32 bit values
+    auto text = json.str();
+    text.append( ( 4 - text.size() % 4 ) % 4, ' ' );
+
+    const auto json_chunk = 8 + text.size();
+    const auto bin_chunk  = offset > 0 ? 8 + offset : 0;
+
+    std::string header;
+    header.reserve( 12 + json_chunk + 8 );
+    put( header, glb_magic );
+    put( header, uint32_t(2) );
+    put( header, uint32_t( 12 + json_chunk + bin_chunk ) );
+    put( header, uint32_t( text.size() ) );
+    put( header, glb_json );
+    header += text;
+    if( offset > 0 ) {
+        put( header, uint32_t(offset) );
+        put( header, glb_bin );
+    }
+
+    return header;
+}
@@ -0,0 +1,75 @@
+#ifndef MESHEXPORTER_H
+#define MESHEXPORTER_H
+
+
+#include "tessellation/surfacesampler.h"
+
+// gmlib
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+// stl
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Tessellated scenes for other tools: binary STL, OBJ or binary glTF (.glb).
+// collect() takes a snapshot of the visible surfaces on the render thread: their shape, world
+// matrix and material. write() may then run on any thread but a ThreadPool worker; every
+// surface is sampled, transformed and formatted into a buffer of its own on the ThreadPool, and
+// the buffers are written out back to back.
+class MeshExporter {
+public:
+    enum class Format { Stl, Obj, Glb };
+
+    struct Result {
+        bool                                          written {false};
+        size_t                                        surfaces {0};
+        size_t                                        vertices {0};
+        size_t                                        triangles {0};
+        size_t                                        bytes {0};
+        double                                        time {0.0};     // milliseconds
+    };
+
+    // From the extension: ".stl", ".obj" or ".glb"
+    static bool                                       format( const std::string& filename, Format& format );
+
+    // Render thread; m1 x m2 samples per surface
+    void                                              collect( GMlib::Scene& scene, int m1, int m2 );
+
+    Result                                            write( const std::string& filename, Format format ) const;
+
+private:
+    struct Item {
+        std::string                                   name;
+        GMlib::HqMatrix<float,3>                      matrix;     // to the scene, with the scale
+        float                                         normal_matrix[9];   // inverse transpose of its 3 x 3, row major, up to length
+        float                                         color[4];
+
+        // Sampled on the workers when the shape can be copied, else right away
+        std::shared_ptr<SurfaceSampler>               sampler;
+        std::shared_ptr<SurfaceSamples>               samples;
+    };
+
+    // A surface in the scene coordinates, formatted
+    struct Chunk {
+        std::string                                   data;
+        size_t                                        vertices {0};
+        size_t                                        triangles {0};
+        float                                         min[3];
+        float                                         max[3];
+    };
+
+    std::vector<Item>                                 _items;
+    int                                               _m1 {0};
+    int                                               _m2 {0};
+
+    void                                              visit( GMlib::SceneObject* obj );
+    Chunk                                             chunk( const Item& item, Format format, size_t first_vertex ) const;
+
+    static std::shared_ptr<SurfaceSamples>            sampleInPlace( GMlib::PSurf<float,3>* surface, int m1, int m2 );
+    static std::string                                glbHeader( const std::vector<Item>& items, const std::vector<Chunk>& chunks );
+};
+
+#endif // MESHEXPORTER_H
@@ -0,0 +1,414 @@
+#include "occlusionculler.h"
+#include "tessellation/packedsurfacevisualizer.h"
+
+// gmlib
+#include <gmParametricsModule>
+
+// stl
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+#include <future>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define OCCLUSIONCULLER_AVX2
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+    bool detectAvx2() {
+
+#ifdef OCCLUSIONCULLER_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    const bool has_avx2 = detectAvx2();
+
+    // Polygons of spheres
+    const int   sphere_sides = 8;
+
+    // Smallest of the scales of the axes of obj, as it is drawn
+    float minScale( const GMlib::SceneObject* obj ) {
+
+        const auto model = PackedSurfaceVisualizer::getModelMatrix(obj);
+        const auto m = model.getPtr();
+
+        auto scale = HUGE_VALF;
+        for( auto col = 0; col < 3; ++col )
+            scale = std::min( scale, std::sqrt( m[col] * m[col] + m[4 + col] * m[4 + col] + m[8 + col] * m[8 + col] ) );
+        return scale;
+    }
+
+    // Of the inscribed radius of a sphere's mesh over its bounding radius. Every triangle of the
+    // mesh has its corners on the sphere, within half the diagonal of a parameter cell from its
+    // circumcenter, so its plane is no nearer the center than the cosine of that. 0 when the mesh
+    // is too coarse to hold anything, and a little off that for the float rounding of the mesh.
+    float sphereInset( const GMlib::PSphere<float>* sphere ) {
+
+        const auto m1 = sphere->getSamplesU();
+        const auto m2 = sphere->getSamplesV();
+        if( m1 < 2 || m2 < 2 )
+            return 0.0f;
+
+        const auto du = float( sphere->getParDeltaU() ) / float(m1 - 1);
+        const auto dv = float( sphere->getParDeltaV() ) / float(m2 - 1);
+        const auto half_diagonal = 0.5f * std::sqrt( du * du + dv * dv );
+        if( half_diagonal >= 0.5f * float(M_PI) )
+            return 0.0f;
+
+        return 0.99f * std::cos(half_diagonal);
+    }
+
+
+    // row[x] = max( row[x], w0 + dw * x ) for x in [x0,x1)
+    void fillSpanScalar( float* row, int x0, int x1, float w0, float dw ) {
+
+        for( auto x = x0; x < x1; ++x )
+            row[x] = std::max( row[x], w0 + dw * float(x) );
+    }
+
+    // Any of row[x0,x1) not in front of w
+    bool anyBehindScalar( const float* row, int x0, int x1, float w ) {
+
+        for( auto x = x0; x < x1; ++x )
+            if( row[x] <= w )
+                return true;
+        return false;
+    }
+
+#ifdef OCCLUSIONCULLER_AVX2
+
+    __attribute__((target("avx2")))
+    void fillSpanAvx2( float* row, int x0, int x1, float w0, float dw ) {
+
+        const auto step = _mm256_set1_ps( 8.0f * dw );
+        auto w = _mm256_add_ps( _mm256_set1_ps( w0 + dw * float(x0) ),
+                                _mm256_mul_ps( _mm256_set1_ps(dw), _mm256_setr_ps( 0, 1, 2, 3, 4, 5, 6, 7 ) ) );
+
+        auto x = x0;
+        for( ; x + 8 <= x1; x += 8, w = _mm256_add_ps( w, step ) )
+            _mm256_storeu_ps( row + x, _mm256_max_ps( _mm256_loadu_ps( row + x ), w ) );
+
+        fillSpanScalar( row, x, x1, w0, dw );
+    }
+
+    __attribute__((target("avx2")))
+    bool anyBehindAvx2( const float* row, int x0, int x1, float w ) {
+
+        const auto wv = _mm256_set1_ps(w);
+
+        auto x = x0;
+        for( ; x + 8 <= x1; x += 8 )
+            if( _mm256_movemask_ps( _mm256_cmp_ps( _mm256_loadu_ps( row + x ), wv, _CMP_LE_OQ ) ) )
+                return true;
+
+        return anyBehindScalar( row, x, x1, w );
+    }
+
+#endif
+
+    void fillSpan( float* row, int x0, int x1, float w0, float dw ) {
+
+#ifdef OCCLUSIONCULLER_AVX2
+        if( has_avx2 )
+            return fillSpanAvx2( row, x0, x1, w0, dw );
+#endif
+        fillSpanScalar( row, x0, x1, w0, dw );
+    }
+
+    bool anyBehind( const float* row, int x0, int x1, float w ) {
+
+#ifdef OCCLUSIONCULLER_AVX2
+        if( has_avx2 )
+            return anyBehindAvx2( row, x0, x1, w );
+#endif
+        return anyBehindScalar( row, x0, x1, w );
+    }
+}
+
+
+
+OcclusionCuller::OcclusionCuller()
+    : _pool( std::max( 1u, std::min( 3u, std::thread::hardware_concurrency() / 2 ) ) ) {}
+
+void OcclusionCuller::setResolution( int width ) { _resolution = std::max( 16, width ); }
+
+void OcclusionCuller::setMaxOccluders( int count ) { _max_occluders = std::max( 0, count ); }
+
+void OcclusionCuller::setMinOccluderSize( float fraction ) { _min_size = std::max( 0.0f, fraction ); }
+
+const OcclusionCuller::Stats& OcclusionCuller::getStats() const { return _stats; }
+
+std::vector<GMlib::SceneObject*>
+OcclusionCuller::cull( const std::vector<GMlib::SceneObject*>& objects, const GMlib::Camera& camera,
+                       int viewport_width, int viewport_height ) {
+
+    const auto started = std::chrono::steady_clock::now();
+
+    _stats = Stats();
+    std::vector<GMlib::SceneObject*> occluded;
+
+    setView( camera, viewport_width, viewport_height );
+
+    // The largest on screen, by the radius of the bounding sphere over its distance
+    std::vector<Occluder> occluders;
+    for( auto obj : objects ) {
+
+        if( !obj->isVisible() || !obj->getVisualizers().getSize() || obj->getMaterial().getDif().getAlphaC() < 1.0 )
+            continue;
+        if( !dynamic_cast<const GMlib::PPlane<float>*>(obj) && !dynamic_cast<const GMlib::PSphere<float>*>(obj) )
+            continue;
+
+        const auto sphere = obj->getSurroundingSphereClean();
+        const auto z = toView( sphere.getPos() ).z;
+        const auto size = z > _near ? sphere.getRadius() / z : HUGE_VALF;
+        if( size * _scale_y >= _min_size * float(_height) )
+            occluders.push_back( Occluder{ obj, size } );
+    }
+
+    if( occluders.empty() ) {
+        _stats.time = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - started ).count();
+        return occluded;
+    }
+
+    const auto count = std::min( occluders.size(), size_t(_max_occluders) );
+    std::partial_sort( occluders.begin(), occluders.begin() + long(count), occluders.end(),
+                       []( const Occluder& a, const Occluder& b ) { return a.size > b.size; } );
+    occluders.resize(count);
+
+    _triangles.clear();
+    for( const auto& o : occluders )
+        addOccluder( o.obj );
+    _stats.occluders = occluders.size();
+    _stats.triangles = _triangles.size();
+
+    // One band of rows on this thread, the rest on the pool
+    std::fill( _depth.begin(), _depth.end(), 0.0f );
+    const auto bands = int( _pool.size() ) + 1;
+    std::vector<std::future<void>> jobs;
+    for( auto b = 1; b < bands; ++b )
+        jobs.push_back( _pool.submit( [this,b,bands]() { rasterize( _height * b / bands, _height * ( b + 1 ) / bands ); } ) );
+    rasterize( 0, _height / bands );
+    for( auto& job : jobs )
+        job.get();
+
+    for( auto obj : objects )
+        if( isOccluded(obj) )
+            occluded.push_back(obj);
+
+    _stats.tested   = objects.size();
+    _stats.occluded = occluded.size();
+    _stats.time     = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - started ).count();
+    return occluded;
+}
+
+void OcclusionCuller::setView( const GMlib::Camera& camera, int viewport_width, int viewport_height ) {
+
+    const auto aspect = viewport_height > 0 ? float(viewport_width) / float(viewport_height) : 1.0f;
+
+    _width  = _resolution;
+    _height = std::min( std::max( int( std::lround( float(_resolution) / aspect ) ), 8 ), 4 * _resolution );
+    _depth.resize( size_t(_width) * size_t(_height) );
+
+    // Orthonormal, as in SceneBvh::cull
+    const auto dir  = GMlib::Vector<float,3>( camera.getDir() ).getNormalized();
+    const auto side = ( dir ^ GMlib::Vector<float,3>( camera.getUp() ) ).getNormalized();
+    const auto up   = side ^ dir;
+    const auto& eye = camera.getPos();
+
+    _eye  = Vec{ eye(0), eye(1), eye(2) };
+    _dir  = Vec{ dir(0), dir(1), dir(2) };
+    _side = Vec{ side(0), side(1), side(2) };
+    _up   = Vec{ up(0), up(1), up(2) };
+    _near = camera.getNearPlane();
+
+    const auto tan_v = float( camera.getAngleTan() );
+    _scale_x = float(_width)  / ( 2.0f * tan_v * aspect );
+    _scale_y = float(_height) / ( 2.0f * tan_v );
+}
+
+OcclusionCuller::Vec OcclusionCuller::toView( const GMlib::Point<float,3>& p ) const {
+
+    const Vec d{ p(0) - _eye.x, p(1) - _eye.y, p(2) - _eye.z };
+    return Vec{ d.x * _side.x + d.y * _side.y + d.z * _side.z,
+                d.x * _up.x   + d.y * _up.y   + d.z * _up.z,
+                d.x * _dir.x  + d.y * _dir.y  + d.z * _dir.z };
+}
+
+OcclusionCuller::Vertex OcclusionCuller::project( const Vec& v ) const {
+
+    return Vertex{ 0.5f * float(_width)  + _scale_x * v.x / v.z,
+                   0.5f * float(_height) + _scale_y * v.y / v.z,
+                   1.0f / v.z };
+}
+
+void OcclusionCuller::addPolygon( std::vector<Vec> polygon ) {
+
+    // What is behind the near plane is cut off
+    std::vector<Vec> clipped;
+    for( size_t i = 0; i < polygon.size(); ++i ) {
+
+        const auto& a = polygon[i];
+        const auto& b = polygon[( i + 1 ) % polygon.size()];
+        const auto a_in = a.z >= _near;
+        const auto b_in = b.z >= _near;
+
+        if( a_in )
+            clipped.push_back(a);
+        if( a_in != b_in ) {
+            const auto t = ( _near - a.z ) / ( b.z - a.z );
+            clipped.push_back( Vec{ a.x + ( b.x - a.x ) * t, a.y + ( b.y - a.y ) * t, _near } );
+        }
+    }
+
+    // A fan, as the polygons are convex
+    for( size_t i = 2; i < clipped.size(); ++i )
+        _triangles.push_back( Triangle{ { project( clipped[0] ), project( clipped[i - 1] ), project( clipped[i] ) } } );
+}
+
+void OcclusionCuller::addOccluder( const GMlib::SceneObject* obj ) {
+
+    if( auto plane = dynamic_cast<const GMlib::PPlane<float>*>(obj) ) {
+
+        // Corner and spanning vectors, as Scenario::savePP writes them
+        const auto& p = const_cast<GMlib::PPlane<float>*>(plane)->evaluate( plane->getParStartU(), plane->getParStartV(), 1, 1 );
+        const auto matrix = PackedSurfaceVisualizer::getModelMatrix(obj);
+        const GMlib::Point<float,3> corners[4] = { p[0][0], p[0][0] + p[1][0], p[0][0] + p[1][0] + p[0][1], p[0][0] + p[0][1] };
+
+        std::vector<Vec> quad;
+        for( const auto& c : corners )
+            quad.push_back( toView( matrix * c ) );
+        addPolygon(quad);
+    }
+    else {
+
+        // Facing the camera through the center, so of one depth; the sphere is without the scale
+        const auto inset = sphereInset( static_cast<const GMlib::PSphere<float>*>(obj) );
+        if( inset <= 0.0f )
+            return;
+
+        const auto sphere = obj->getSurroundingSphereClean();
+        const auto c = toView( sphere.getPos() );
+        const auto r = sphere.getRadius() * minScale(obj) * inset;
+
+        std::vector<Vec> polygon;
+        for( auto i = 0; i < sphere_sides; ++i ) {
+            const auto a = 2.0f * float(M_PI) * float(i) / float(sphere_sides);
+            polygon.push_back( Vec{ c.x + r * std::cos(a), c.y + r * std::sin(a), c.z } );
+        }
+        addPolygon(polygon);
+    }
+}
+
+void OcclusionCuller::rasterize( int row_begin, int row_end ) {
+
+    for( const auto& t : _triangles )
+        rasterize( t, row_begin, row_end );
+}
+
+void OcclusionCuller::rasterize( const Triangle& t, int row_begin, int row_end ) {
+
+    const auto& v = t.v;
+
+    // Edges e(x,y) = a x + b y + c, positive inside
+    auto area = ( v[1].x - v[0].x ) * ( v[2].y - v[0].y ) - ( v[2].x - v[0].x ) * ( v[1].y - v[0].y );
+    if( std::abs(area) < 1.0e-6f )
+        return;
+    const auto sign = area > 0.0f ? 1.0f : -1.0f;
+    area *= sign;
+
+    float a[3], b[3], c[3];
+    for( auto i = 0; i < 3; ++i ) {
+        const auto& p = v[i];
+        const auto& q = v[( i + 1 ) % 3];
+        a[i] = sign * ( p.y - q.y );
+        b[i] = sign * ( q.x - p.x );
+        c[i] = sign * ( p.x * q.y - q.x * p.y );
+    }
+
+    // 1/z is linear on screen; edge i is opposite vertex (i + 2) % 3
+    auto dwdx = 0.0f, dwdy = 0.0f, w0 = 0.0f;
+    for( auto i = 0; i < 3; ++i ) {
+        const auto w = v[( i + 2 ) % 3].w / area;
+        dwdx += a[i] * w;
+        dwdy += b[i] * w;
+        w0   += c[i] * w;
+    }
+
+    // Whole pixels only, at the farthest depth within them
+    const auto depth_margin = 0.5f * ( std::abs(dwdx) + std::abs(dwdy) );
+
+    const auto y_min = std::min( { v[0].y, v[1].y, v[2].y } );
+    const auto y_max = std::max( { v[0].y, v[1].y, v[2].y } );
+    const auto y0 = std::max( row_begin, int( std::floor(y_min) ) );
+    const auto y1 = std::min( row_end,   int( std::ceil(y_max) ) );
+
+    for( auto y = y0; y < y1; ++y ) {
+
+        const auto cy = float(y) + 0.5f;
+        auto lo = 0.0f, hi = float(_width);
+        auto empty = false;
+
+        for( auto i = 0; i < 3 && !empty; ++i ) {
+
+            // Pixel center at least half a pixel inside, along both axes
+            const auto rest = 0.5f * ( std::abs(a[i]) + std::abs(b[i]) ) - b[i] * cy - c[i];
+            if( a[i] > 0.0f )      lo = std::max( lo, rest / a[i] );
+            else if( a[i] < 0.0f ) hi = std::min( hi, rest / a[i] );
+            else                   empty = rest > 0.0f;
+        }
+
+        const auto x0 = std::max( 0, int( std::ceil( lo - 0.5f ) ) );
+        const auto x1 = std::min( _width, int( std::floor( hi - 0.5f ) ) + 1 );
+        if( empty || x0 >= x1 )
+            continue;
+
+        fillSpan( _depth.data() + size_t(y) * size_t(_width), x0, x1,
+                  w0 + dwdy * cy + dwdx * 0.5f - depth_margin, dwdx );
+    }
+}
+
+bool OcclusionCuller::isOccluded( const GMlib::SceneObject* obj ) const {
+
+    const auto sphere = obj->getSurroundingSphere();
+    if( !sphere.isValid() )
+        return false;
+
+    const auto c = toView( sphere.getPos() );
+    const auto r = sphere.getRadius();
+    const auto z_near = c.z - r;
+    if( z_near <= _near )
+        return false;
+
+    // The sphere is within the box of its center and radius; on screen within the extremes
+    // of the corners of the box
+    auto x_min = HUGE_VALF, x_max = -HUGE_VALF, y_min = HUGE_VALF, y_max = -HUGE_VALF;
+    for( auto z : { c.z - r, c.z + r } )
+        for( auto s : { -r, r } ) {
+            x_min = std::min( x_min, ( c.x + s ) / z );
+            x_max = std::max( x_max, ( c.x + s ) / z );
+            y_min = std::min( y_min, ( c.y + s ) / z );
+            y_max = std::max( y_max, ( c.y + s ) / z );
+        }
+
+    const auto x0 = std::max( 0, int( std::floor( 0.5f * float(_width)  + _scale_x * x_min ) ) );
+    const auto x1 = std::min( _width, int( std::ceil( 0.5f * float(_width)  + _scale_x * x_max ) ) );
+    const auto y0 = std::max( 0, int( std::floor( 0.5f * float(_height) + _scale_y * y_min ) ) );
+    const auto y1 = std::min( _height, int( std::ceil( 0.5f * float(_height) + _scale_y * y_max ) ) );
+
+    // Off the buffer; left to the frustum test
+    if( x0 >= x1 || y0 >= y1 )
+        return false;
+
+    const auto w = 1.0f / z_near;
+    for( auto y = y0; y < y1; ++y )
+        if( anyBehind( _depth.data() + size_t(y) * size_t(_width), x0, x1, w ) )
+            return false;
+
+    return true;
+}
@@ -0,0 +1,100 @@
+#ifndef OCCLUSIONCULLER_H
+#define OCCLUSIONCULLER_H
+
+
+// local
+#include "threadpool.h"
+
+// gmlib
+#include <gmSceneModule>
+
+// stl
+#include <vector>
+
+
+// Software occlusion culling against a low resolution depth buffer drawn on the CPU, so it
+// costs no fill rate, which matters most with software GL.
+//
+// Each frame the largest objects on screen whose inside is known are drawn as occluder proxies
+// lying within them: the quad of a plane, and an octagon through the center of a sphere, facing
+// the camera, inset from its bounding sphere as far as its sampling cuts into it. Objects are then tested with the screen rectangle
+// and nearest depth of their bounding sphere, and are occluded when every pixel of the
+// rectangle holds an occluder in front of them. Occluders only cover pixels they cover wholly,
+// at the farthest depth within each, so nothing that shows is culled.
+//
+// The buffer holds 1/z, larger nearer, 0 where nothing is drawn. Its rows are drawn in bands
+// in parallel, on a pool of its own, as the shared ThreadPool may be busy sampling surfaces.
+// Spans are filled and tested eight pixels at a time with AVX2 where the CPU has it.
+class OcclusionCuller {
+public:
+    struct Stats {
+        size_t                                        occluders {0};
+        size_t                                        triangles {0};
+        size_t                                        tested {0};
+        size_t                                        occluded {0};
+        double                                        time {0.0};       // milliseconds, last cull
+    };
+
+    OcclusionCuller();
+
+    // Buffer width in pixels; the height follows the aspect of the viewport
+    void                                              setResolution( int width );
+    void                                              setMaxOccluders( int count );
+    // Smallest occluder radius on screen, as a fraction of the viewport height
+    void                                              setMinOccluderSize( float fraction );
+
+    // Render thread: the objects hidden behind the largest of them
+    std::vector<GMlib::SceneObject*>                  cull( const std::vector<GMlib::SceneObject*>& objects, const GMlib::Camera& camera,
+                                                            int viewport_width, int viewport_height );
+
+    const Stats&                                      getStats() const;
+
+private:
+    struct Vec {
+        float                                         x, y, z;
+    };
+
+    // Screen position and 1/z of a vertex
+    struct Vertex {
+        float                                         x, y, w;
+    };
+
+    struct Triangle {
+        Vertex                                        v[3];
+    };
+
+    struct Occluder {
+        const GMlib::SceneObject*                     obj;
+        float                                         size;
+    };
+
+    int                                               _resolution {256};
+    int                                               _max_occluders {32};
+    float                                             _min_size {0.05f};
+
+    int                                               _width {0};
+    int                                               _height {0};
+    std::vector<float>                                _depth;
+    std::vector<Triangle>                             _triangles;
+
+    // View frame, and the scale from x/z and y/z to pixels
+    Vec                                               _eye, _side, _up, _dir;
+    float                                             _near {0.0f};
+    float                                             _scale_x {1.0f};
+    float                                             _scale_y {1.0f};
+
+    ThreadPool                                        _pool;
+    Stats                                             _stats;
+
+    void                                              setView( const GMlib::Camera& camera, int viewport_width, int viewport_height );
+    Vec                                               toView( const GMlib::Point<float,3>& p ) const;
+    Vertex                                            project( const Vec& v ) const;
+
+    void                                              addPolygon( std::vector<Vec> polygon );
+    void                                              addOccluder( const GMlib::SceneObject* obj );
+    void                                              rasterize( int row_begin, int row_end );
+    void                                              rasterize( const Triangle& t, int row_begin, int row_end );
+    bool                                              isOccluded( const GMlib::SceneObject* obj ) const;
+};
+
+#endif // OCCLUSIONCULLER_H
@@ -44,12 +44,43 @@
 */
 
 
+/* MODIFIED */
+
 #include "openddl.h"
+#include <string.h>
 
 
 using namespace ODDL;
 
 
+namespace
+{
+  enum
+  {
+    kTextScanStructure,
+    kTextScanString,
+    kTextScanCharacter,
+    kTextScanLineComment,
+    kTextScanBlockComment
+  };
+
+
+  int32 CountLines(const char *text, const char *end)
+  {
+    int32 count = 0;
+    while (text != end)
+    {
+      if ((text++)[0] == '\n')
+      {
+        count++;
+      }
+    }
+
+    return (count);
+  }
+}
+
+
 namespace ODDL
 {
   namespace Data
@@ -1379,6 +1410,8 @@ DataResult Data::ReadFloatMagnitude(const char *text, int32 *textLength, double
   c = byte[0];
   if (c == '.')
   {
+    byte++;
+
     double decimal = 10.0;
     separator = false;
     for (;;)
@@ -1986,6 +2019,9 @@ Structure::Structure(StructureType type)
   structureType = type;
   baseStructureType = 0;
   globalNameFlag = true;
+
+  textLocation = nullptr;
+  textLine = 0;
 }
 
 Structure::~Structure()
@@ -2211,6 +2247,14 @@ bool RootStructure::ValidateSubstructure(const DataDescription *dataDescription,
 
 DataDescription::DataDescription()
 {
+  errorStructure = nullptr;
+  errorLine = 0;
+
+  pendingLine = 1;
+  scanLength = 0;
+  scanDepth = 0;
+  scanState = kTextScanStructure;
+  textResult = kDataOkay;
 }
 
 DataDescription::~DataDescription()
@@ -2630,3 +2674,220 @@ DataResult DataDescription::ProcessText(const char *text)
 
   return (result);
 }
+
+DataResult DataDescription::ParsePendingText(int32 length)
+{
+  char *start = pendingText;
+  int32 count = pendingText.GetElementCount() - 1;
+
+  char c = start[length];
+  start[length] = 0;
+
+  const char *text = start + Data::GetWhitespaceLength(start);
+  Structure *last = rootStructure.GetLastSubnode();
+
+  // A closing brace following the structures parsed before is where a single pass would have stopped.
+
+  DataResult result = ((last) && (text[0] == '}')) ? kDataSyntaxError : ParseStructures(text, &rootStructure);
+  if ((result == kDataOkay) && (text[0] != 0))
+  {
+    result = kDataSyntaxError;
+  }
+
+  if (result != kDataOkay)
+  {
+    errorLine = pendingLine + CountLines(start, text);
+    textResult = result;
+
+    rootStructure.PurgeSubtree();
+    pendingText.Purge();
+    return (result);
+  }
+
+  // The text locations are only valid until the parsed text is removed below.
+
+  const char *location = start;
+  Structure *structure = (last) ? last->Next() : rootStructure.GetFirstSubnode();
+  while (structure)
+  {
+    pendingLine += CountLines(location, structure->textLocation);
+    location = structure->textLocation;
+
+    structure->textLocation = nullptr;
+    structure->textLine = pendingLine;
+    structure = rootStructure.GetNextNode(structure);
+  }
+
+  start[length] = c;
+  pendingLine += CountLines(location, start + length);
+
+  memmove(start, start + length, count + 1 - length);
+  pendingText.SetElementCount(count + 1 - length);
+  scanLength -= length;
+
+  return (kDataOkay);
+}
+
+void DataDescription::BeginText(void)
+{
+  rootStructure.PurgeSubtree();
+
+  errorStructure = nullptr;
+  errorLine = 0;
+
+  pendingText.SetElementCount(1);
+  pendingText[0] = 0;
+
+  pendingLine = 1;
+  scanLength = 0;
+  scanDepth = 0;
+  scanState = kTextScanStructure;
+  textResult = kDataOkay;
+}
+
+DataResult DataDescription::AppendText(const char *text, int32 length)
+{
+  if (textResult != kDataOkay)
+  {
+    return (textResult);
+  }
+
+  int32 count = pendingText.GetElementCount() - 1;
+  pendingText.SetElementCount(count + length + 1);
+
+  char *pending = pendingText;
+  memcpy(pending + count, text, length);
+  count += length;
+  pending[count] = 0;
+
+  // Find where the last complete top-level structure ends. Braces inside of literals and comments are not counted,
+  // and a character that needs the one after it to be understood is left for the next piece.
+
+  int32 complete = 0;
+  int32 position = scanLength;
+  while (position < count)
+  {
+    char c = pending[position];
+    if (scanState == kTextScanStructure)
+    {
+      if (c == '"')
+      {
+        scanState = kTextScanString;
+      }
+      else if (c == '\'')
+      {
+        scanState = kTextScanCharacter;
+      }
+      else if (c == '/')
+      {
+        if (position + 1 == count)
+        {
+          break;
+        }
+
+        c = pending[position + 1];
+        if (c == '/')
+        {
+          scanState = kTextScanLineComment;
+          position++;
+        }
+        else if (c == '*')
+        {
+          scanState = kTextScanBlockComment;
+          position++;
+        }
+      }
+      else if (c == '{')
+      {
+        scanDepth++;
+      }
+      else if ((c == '}') && (scanDepth > 0))
+      {
+        if (--scanDepth == 0)
+        {
+          complete = position + 1;
+        }
+      }
+    }
+    else if (scanState == kTextScanLineComment)
+    {
+      if (c == '\n')
+      {
+        scanState = kTextScanStructure;
+      }
+    }
+    else if (scanState == kTextScanBlockComment)
+    {
+      if (c == '*')
+      {
+        if (position + 1 == count)
+        {
+          break;
+        }
+
+        if (pending[position + 1] == '/')
+        {
+          scanState = kTextScanStructure;
+          position++;
+        }
+      }
+    }
+    else
+    {
+      if (c == '\\')
+      {
+        if (position + 1 == count)
+        {
+          break;
+        }
+
+        position++;
+      }
+      else if (c == ((scanState == kTextScanString) ? '"' : '\''))
+      {
+        scanState = kTextScanStructure;
+      }
+    }
+
+    position++;
+  }
+
+  scanLength = position;
+
+  if (complete != 0)
+  {
+    return (ParsePendingText(complete));
+  }
+
+  return (kDataOkay);
+}
+
+DataResult DataDescription::EndText(void)
+{
+  if (textResult == kDataOkay)
+  {
+    const char *text = pendingText;
+    text += Data::GetWhitespaceLength(text);
+
+    if ((text[0] != 0) || (!rootStructure.GetFirstSubnode()))
+    {
+      ParsePendingText(pendingText.GetElementCount() - 1);
+    }
+  }
+
+  DataResult result = textResult;
+  if (result == kDataOkay)
+  {
+    result = ProcessData();
+    if (result != kDataOkay)
+    {
+      errorLine = (errorStructure) ? errorStructure->textLine : pendingLine;
+      rootStructure.PurgeSubtree();
+    }
+  }
+
+  pendingText.Purge();
+  textResult = kDataOkay;
+
+  return (result);
+}
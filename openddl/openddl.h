@@ -755,6 +755,7 @@ namespace ODDL {
       Map<Structure>      structureMap;
 
       const char      *   textLocation;
+      int32               textLine;
 
     protected:
 
@@ -1156,6 +1157,53 @@ namespace ODDL {
   //# \also  $@DataDescription::GetErrorLine@$
 
 
+  //# \function  DataDescription::BeginText    Starts parsing an OpenDDL file given in pieces.
+  //
+  //# \proto  void BeginText(void);
+  //
+  //# \desc
+  //# The $BeginText$ function clears the $DataDescription$ object in preparation for a file whose text is passed to
+  //# the $@DataDescription::AppendText@$ function in consecutive pieces, such as the output of a stream decompressor.
+  //# The file is finished by calling the $@DataDescription::EndText@$ function. The result is the same as passing
+  //# the whole text to the $@DataDescription::ProcessText@$ function at once.
+  //
+  //# \also  $@DataDescription::AppendText@$
+  //# \also  $@DataDescription::EndText@$
+  //# \also  $@DataDescription::ProcessText@$
+
+
+  //# \function  DataDescription::AppendText    Parses the next piece of an OpenDDL file.
+  //
+  //# \proto  DataResult AppendText(const char *text, int32 length);
+  //
+  //# \param  text    The next piece of the file. It does not need to be null terminated.
+  //# \param  length    The number of characters in the piece.
+  //
+  //# \desc
+  //# The $AppendText$ function parses every top-level data structure that is completed by the piece of text
+  //# specified by the $text$ and $length$ parameters, and only keeps the incomplete remainder of the text. Pieces can be
+  //# split at any character. If a syntax error is found, then the error is returned, and it is returned again by every
+  //# following call until the $@DataDescription::BeginText@$ function is called.
+  //
+  //# \also  $@DataDescription::BeginText@$
+  //# \also  $@DataDescription::EndText@$
+
+
+  //# \function  DataDescription::EndText    Finishes parsing an OpenDDL file given in pieces and processes its data.
+  //
+  //# \proto  DataResult EndText(void);
+  //
+  //# \desc
+  //# The $EndText$ function parses what is left of the text passed to the $@DataDescription::AppendText@$ function
+  //# and then processes the data in the same way as the $@DataDescription::ProcessText@$ function. The return value
+  //# and the line returned by the $@DataDescription::GetErrorLine@$ function are the same as they would be for
+  //# the $ProcessText$ function.
+  //
+  //# \also  $@DataDescription::BeginText@$
+  //# \also  $@DataDescription::AppendText@$
+  //# \also  $@DataDescription::ProcessText@$
+
+
   //# \function  DataDescription::GetErrorLine    Returns the line on which an error occurred.
   //
   //# \proto  int32 GetErrorLine(void) const;
@@ -1180,10 +1228,18 @@ namespace ODDL {
       const Structure    *errorStructure;
       int32        errorLine;
 
+      Array<char>      pendingText;
+      int32        pendingLine;
+      int32        scanLength;
+      int32        scanDepth;
+      int32        scanState;
+      DataResult      textResult;
+
       static Structure *CreatePrimitive(const String& identifier);
 
       DataResult ParseProperties(const char *& text, Structure *structure);
       DataResult ParseStructures(const char *& text, Structure *root);
+      DataResult ParsePendingText(int32 length);
 
     protected:
 
@@ -1211,6 +1267,10 @@ namespace ODDL {
       virtual bool ValidateTopLevelStructure(const Structure *structure) const;
 
       DataResult ProcessText(const char *text);
+
+      void BeginText(void);
+      DataResult AppendText(const char *text, int32 length);
+      DataResult EndText(void);
   };
 }
 
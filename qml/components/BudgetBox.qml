@@ -0,0 +1,35 @@
+import QtQuick 2.1
+
+Rectangle{
+
+    property real vertices : 0
+    property real vertexBudget : 0
+    property real triangles : 0
+    property real triangleBudget : 0
+    property real drawnObjects : 0
+    property real culledObjects : 0
+    property real occludedObjects : 0
+    color: "white";
+    opacity: 0.7;
+
+    border.color: (vertices > vertexBudget || triangles > triangleBudget) ? "red" : "black";
+    border.width: 2;
+
+    function millions(n) { return (n / 1000000).toFixed(2) + "M"; }
+
+    Column {
+        anchors.centerIn: parent
+
+        Text {
+            text: "Vertices: " + millions(vertices) + " / " + millions(vertexBudget);
+            color: vertices > vertexBudget ? "red" : "black";
+        }
+        Text {
+            text: "Triangles: " + millions(triangles) + " / " + millions(triangleBudget);
+            color: triangles > triangleBudget ? "red" : "black";
+        }
+        Text {
+            text: "Objects: " + drawnObjects + " drawn, " + culledObjects + " culled, " + occludedObjects + " occluded";
+        }
+    }
+}
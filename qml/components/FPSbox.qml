@@ -3,6 +3,9 @@ import QtQuick 2.1
 Rectangle{
 
     property int fps : 0
+    property string preset : ""
+    property real renderScale : 1
+    property int samples : 0
     color: "white";
     opacity: 0.7;
 
@@ -10,9 +13,16 @@ Rectangle{
     border.width: 2;
 
 
-    Text {
+    Column {
         anchors.centerIn: parent
-        text: "FPS: "+fps;
+
+        Text {
+            anchors.horizontalCenter: parent.horizontalCenter
+            text: "FPS: "+fps;
+        }
+        Text {
+            anchors.horizontalCenter: parent.horizontalCenter
+            text: preset + " " + Math.round(renderScale * 100) + "%" + (samples > 0 ? ", " + samples + "x MSAA" : "");
+        }
     }
 }
-
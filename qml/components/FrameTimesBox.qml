@@ -0,0 +1,47 @@
+import QtQuick 2.1
+
+Rectangle{
+
+    // From GMlibSceneRenderer.frameTimes; milliseconds over the latest samples of each phase
+    property var times : []
+
+    color: "white";
+    opacity: 0.7;
+
+    border.color: "black";
+    border.width: 2;
+
+    width: 330;
+    height: 26 + 16 * times.length;
+
+    function ms(t) { return t.toFixed(2); }
+
+    Column {
+        x: 8; y: 5
+
+        Row {
+            Text { width: 90; text: "ms"; font.bold: true }
+            Text { width: 55; text: "p50"; font.bold: true; horizontalAlignment: Text.AlignRight }
+            Text { width: 55; text: "p95"; font.bold: true; horizontalAlignment: Text.AlignRight }
+            Text { width: 55; text: "p99"; font.bold: true; horizontalAlignment: Text.AlignRight }
+            Text { width: 55; text: "max"; font.bold: true; horizontalAlignment: Text.AlignRight }
+        }
+
+        Repeater {
+            model: times
+
+            Row {
+                Text { width: 90; text: modelData.phase }
+                Text { width: 55; text: ms(modelData.p50); horizontalAlignment: Text.AlignRight }
+                Text { width: 55; text: ms(modelData.p95); horizontalAlignment: Text.AlignRight }
+                Text { width: 55; text: ms(modelData.p99); horizontalAlignment: Text.AlignRight }
+
+                // A max far past the p99 is a stutter the average hides
+                Text {
+                    width: 55; text: ms(modelData.max); horizontalAlignment: Text.AlignRight
+                    color: modelData.max > 2 * modelData.p99 && modelData.max > 16.7 ? "red" : "black"
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,109 @@
+import QtQuick 2.1
+
+Rectangle{
+
+    // From GMlibSceneRenderer.replotStats and replotTotals
+    property var stats : []
+    property var totals : ({})
+    property string sortKey : "time"
+    property bool expanded : false
+
+    signal csvRequested()
+
+    color: "white";
+    opacity: 0.7;
+
+    border.color: "black";
+    border.width: 2;
+
+    width: expanded ? 560 : 220;
+    height: expanded ? Math.min( 400, 50 + 16 * stats.length ) : 25;
+
+    function kib(bytes) { return (bytes / 1024).toFixed(1); }
+
+    // Most expensive first; objects by name
+    function sorted() {
+        var rows = stats.slice(0);
+        var key = sortKey;
+        rows.sort(function(a, b) {
+            if (key === "object")
+                return a.object < b.object ? -1 : (a.object > b.object ? 1 : 0);
+            return b[key] - a[key];
+        });
+        return rows;
+    }
+
+    Text {
+        id: title
+        x: 8; y: 5
+        text: "Tessellation: " + (totals.surfaces || 0) + " surfaces, "
+              + (totals.time || 0).toFixed(1) + " ms, "
+              + kib((totals.vertexBytes || 0) + (totals.indexBytes || 0)) + " KiB";
+
+        MouseArea {
+            anchors.fill: parent
+            onClicked: expanded = !expanded;
+        }
+    }
+
+    Text {
+        visible: expanded
+        anchors.right: parent.right
+        anchors.rightMargin: 8
+        y: 5
+        text: "CSV"
+        font.underline: true
+
+        MouseArea {
+            anchors.fill: parent
+            onClicked: csvRequested();
+        }
+    }
+
+    // Click a column title to sort by it
+    Row {
+        id: header
+        visible: expanded
+        x: 8; y: 25
+
+        Repeater {
+            model: [ { key: "object",  title: "Object",  width: 220 },
+                     { key: "samples", title: "Samples", width: 80 },
+                     { key: "time",    title: "ms",      width: 60 },
+                     { key: "bytes",   title: "KiB",     width: 70 },
+                     { key: "age",     title: "Age s",   width: 60 },
+                     { key: "shared",  title: "Shared",  width: 50 } ]
+
+            Text {
+                width: modelData.width
+                text: modelData.title + (sortKey === modelData.key ? " ▾" : "")
+                font.bold: true
+
+                MouseArea {
+                    anchors.fill: parent
+                    onClicked: sortKey = modelData.key;
+                }
+            }
+        }
+    }
+
+    ListView {
+        visible: expanded
+        clip: true
+        x: 8
+        anchors.top: header.bottom
+        anchors.bottom: parent.bottom
+        anchors.bottomMargin: 4
+        width: parent.width - 16
+        model: expanded ? sorted() : []
+
+        delegate: Row {
+            Text { width: 220; text: modelData.object; elide: Text.ElideRight }
+            Text { width: 80;  text: modelData.samplesText }
+            Text { width: 60;  text: modelData.time.toFixed(2) }
+            Text { width: 70;  text: kib(modelData.bytes) }
+            Text { width: 60;  text: modelData.age < 0 ? "-" : modelData.age.toFixed(0) }
+            Text { width: 50;  text: modelData.shared }
+        }
+    }
+}
@@ -12,7 +12,12 @@ Item {
 
     FPSbox {
 
+        id:fpsbox
+
         fps:renderer.fps
+        preset:renderer.performancePresetName
+        renderScale:renderer.renderScale
+        samples:renderer.samples
 
 anchors
     {
@@ -22,8 +27,61 @@ anchors
     right:parent.right
     }
 
-    width:100;
-    height:25;
+    width:180;
+    height:40;
+    }
+
+    BudgetBox {
+
+        id:budgetbox
+
+        vertices:renderer.vertices
+        vertexBudget:renderer.vertexBudget
+        triangles:renderer.triangles
+        triangleBudget:renderer.triangleBudget
+        drawnObjects:renderer.drawnObjects
+        culledObjects:renderer.culledObjects
+        occludedObjects:renderer.occludedObjects
+
+anchors
+    {
+
+    margins: 20
+    top: parent.top
+    left:parent.left
+    }
+
+    width:280;
+    height:60;
+    }
+
+    FrameTimesBox {
+
+        times:renderer.frameTimes
+
+anchors
+    {
+
+    topMargin: 10
+    top: budgetbox.bottom
+    left:budgetbox.left
+    }
+    }
+
+    ReplotStatsBox {
+
+        stats:renderer.replotStats
+        totals:renderer.replotTotals
+
+        onCsvRequested: renderer.writeReplotStats("replot_stats.csv")
+
+anchors
+    {
+
+    topMargin: 10
+    top: fpsbox.bottom
+    right:fpsbox.right
+    }
     }
 
 
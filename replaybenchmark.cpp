@@ -0,0 +1,291 @@
+#include "replaybenchmark.h"
+#include "scenario.h"
+
+// gmlib
+#include <gmCoreModule>
+
+// qt
+#include <QPoint>
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <iomanip>
+#include <sstream>
+
+
+namespace {
+
+    struct Summary {
+        double mean {0.0}, min {0.0}, p50 {0.0}, p95 {0.0}, p99 {0.0}, max {0.0};
+    };
+
+    // Nearest rank
+    Summary summarize( std::vector<double> values ) {
+
+        Summary s;
+        if( values.empty() )
+            return s;
+
+        std::sort( values.begin(), values.end() );
+        auto rank = [&values]( double fraction ) {
+            auto i = size_t( std::ceil( fraction * double(values.size()) ) );
+            return values[ std::min( std::max( i, size_t(1) ), values.size() ) - 1 ];
+        };
+
+        for( auto v : values )
+            s.mean += v;
+        s.mean /= double( values.size() );
+        s.min = values.front();
+        s.p50 = rank(0.50);
+        s.p95 = rank(0.95);
+        s.p99 = rank(0.99);
+        s.max = values.back();
+        return s;
+    }
+
+    void writeSummary( std::ostream& os, const char* name, const Summary& s ) {
+
+        os << "    \"" << name << "\": { \"mean\": " << s.mean << ", \"min\": " << s.min << ", \"p50\": " << s.p50
+           << ", \"p95\": " << s.p95 << ", \"p99\": " << s.p99 << ", \"max\": " << s.max << " }";
+    }
+
+    std::string jsonString( const std::string& s ) {
+
+        std::string quoted = "\"";
+        for( auto c : s ) {
+            if( c == '"' || c == '\\' ) quoted += '\\';
+            if( static_cast<unsigned char>(c) >= 0x20 ) quoted += c;
+        }
+        return quoted + "\"";
+    }
+
+    GMlib::Vector<float,3> lerp( const float* a, const float* b, float t ) {
+
+        return GMlib::Vector<float,3>( a[0] + ( b[0] - a[0] ) * t, a[1] + ( b[1] - a[1] ) * t, a[2] + ( b[2] - a[2] ) * t );
+    }
+}
+
+
+
+ReplayBenchmark::ReplayBenchmark( Scenario& scenario ) : _scenario(scenario) {}
+
+bool ReplayBenchmark::read( const std::string& path ) {
+
+    std::ifstream is(path);
+    if( !is ) {
+        _error = "can't read " + path;
+        return false;
+    }
+
+    _script = path;
+
+    std::string line;
+    for( auto number = 1; std::getline( is, line ); ++number ) {
+
+        line = line.substr( 0, line.find('#') );
+        std::istringstream words(line);
+
+        std::string command;
+        if( !( words >> command ) )
+            continue;
+
+        auto fail = [&]( const std::string& what ) {
+            _error = path + ":" + std::to_string(number) + ": " + what;
+            return false;
+        };
+
+        if( command == "timestep" ) {
+            if( !( words >> _timestep ) || _timestep <= 0.0 ) return fail("timestep takes seconds");
+        }
+        else if( command == "duration" ) {
+            if( !( words >> _duration ) || _duration < 0.0 ) return fail("duration takes seconds");
+        }
+        else if( command == "settle" ) {
+            std::string on;
+            words >> on;
+            _settle = on != "off";
+        }
+        else if( command == "camera" ) {
+            Key key;
+            words >> key.time;
+            for( auto v : { key.pos, key.dir, key.up } )
+                for( auto k = 0; k < 3; ++k )
+                    words >> v[k];
+            if( !words ) return fail("camera takes a time and nine numbers");
+            _keys.push_back(key);
+        }
+        else if( command == "load" || command == "replot" || command == "fly" ) {
+            Edit edit;
+            edit.command = command;
+            if( !( words >> edit.time ) ) return fail(command + " takes a time");
+            words >> edit.text;
+            if( command == "replot" && edit.text != "low" && edit.text != "high" ) return fail("replot low or high");
+            if( command == "fly" && ( edit.text.size() != 1 || std::string("UDLR").find(edit.text) == std::string::npos ) )
+                return fail("fly U, D, L or R");
+            _edits.push_back(edit);
+        }
+        else if( command == "select" || command == "move" || command == "rotate" ) {
+            Edit edit;
+            edit.command = command;
+            if( !( words >> edit.time >> edit.x >> edit.y ) ) return fail(command + " takes a time and two numbers");
+            words >> edit.text;
+            _edits.push_back(edit);
+        }
+        else if( command == "zoom" ) {
+            Edit edit;
+            edit.command = command;
+            if( !( words >> edit.time >> edit.x ) || edit.x <= 0.0f ) return fail("zoom takes a time and a factor");
+            _edits.push_back(edit);
+        }
+        else
+            return fail("unknown command " + command);
+    }
+
+    // In time order; edits at the same time as they are written
+    std::stable_sort( _keys.begin(), _keys.end(), []( const Key& a, const Key& b ) { return a.time < b.time; } );
+    std::stable_sort( _edits.begin(), _edits.end(), []( const Edit& a, const Edit& b ) { return a.time < b.time; } );
+
+    if( _duration < 0.0 ) {
+        _duration = 0.0;
+        if( !_keys.empty() )  _duration = std::max( _duration, _keys.back().time );
+        if( !_edits.empty() ) _duration = std::max( _duration, _edits.back().time );
+    }
+
+    _frame = 0;
+    _next_edit = 0;
+    _frames.clear();
+    return true;
+}
+
+const std::string& ReplayBenchmark::getError() const { return _error; }
+
+size_t ReplayBenchmark::getFrameCount() const { return size_t( std::floor( _duration / _timestep + 1.0e-9 ) ) + 1; }
+
+bool ReplayBenchmark::isDone() const { return _frame >= getFrameCount(); }
+
+void ReplayBenchmark::beginFrame() {
+
+    const auto time = double(_frame) * _timestep;
+
+    // Meshes asked for by the frame before are in place; not part of the frame time
+    if( _settle )
+        _scenario.finishTessellation();
+
+    while( _next_edit < _edits.size() && _edits[_next_edit].time <= time + 1.0e-9 )
+        apply( _edits[_next_edit++] );
+
+    applyCamera(time);
+
+    const auto now = std::chrono::steady_clock::now();
+
+    Frame frame;
+    frame.time = time;
+    if( _frame > 0 )
+        frame.interval = std::chrono::duration<double,std::milli>( now - _previous ).count();
+    else
+        _started = now;
+    _frames.push_back(frame);
+
+    _previous = now;
+}
+
+void ReplayBenchmark::endFrame( size_t vertices, size_t triangles ) {
+
+    if( _frames.size() <= _frame )
+        return;
+
+    auto& frame = _frames[_frame];
+    frame.render    = std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - _previous ).count();
+    frame.vertices  = vertices;
+    frame.triangles = triangles;
+    ++_frame;
+}
+
+void ReplayBenchmark::applyCamera( double time ) {
+
+    if( _keys.empty() )
+        return;
+
+    // The keys around time; held before the first and after the last
+    auto next = std::upper_bound( _keys.begin(), _keys.end(), time, []( double t, const Key& k ) { return t < k.time; } );
+    const auto& b = next == _keys.end() ? _keys.back() : *next;
+    const auto& a = next == _keys.begin() ? b : *( next - 1 );
+
+    const auto span = b.time - a.time;
+    const auto t = span > 0.0 ? float( ( time - a.time ) / span ) : 0.0f;
+
+    _scenario.setCameraFrame( GMlib::Point<float,3>( lerp( a.pos, b.pos, t ) ), lerp( a.dir, b.dir, t ), lerp( a.up, b.up, t ) );
+}
+
+void ReplayBenchmark::apply( const Edit& edit ) {
+
+    if( edit.command == "load" ) {
+        if( !edit.text.empty() )
+            _scenario.setScenePath( edit.text );
+
+        // Loading starts the simulation again, the replay runs without
+        _scenario.load();
+        _scenario.stopSimulation();
+    }
+    else if( edit.command == "select" ) {
+        QPoint pos( int(edit.x), int(edit.y) );
+        _scenario.tryToSelectObject( pos, edit.text == "add" ? 'a' : '1' );
+    }
+    else if( edit.command == "move" || edit.command == "rotate" ) {
+        QPoint prev( 0, 0 );
+        QPoint pos( int(edit.x), int(edit.y) );
+        if( edit.command == "move" )
+            _scenario.moveObject( pos, prev );
+        else
+            _scenario.rotateObj( pos, prev );
+    }
+    else if( edit.command == "replot" ) {
+        if( edit.text == "low" ) _scenario.replotLow();
+        else                     _scenario.replotHigh();
+    }
+    else if( edit.command == "fly" )
+        _scenario.camFly( edit.text[0] );
+    else if( edit.command == "zoom" )
+        _scenario.zoomCameraW( edit.x );
+}
+
+bool ReplayBenchmark::writeJson( const std::string& path, const std::string& mode ) const {
+
+    std::ofstream os(path);
+    if( !os )
+        return false;
+
+    std::vector<double> render, interval;
+    for( size_t i = 0; i < _frames.size(); ++i ) {
+        render.push_back( _frames[i].render );
+        if( i > 0 )
+            interval.push_back( _frames[i].interval );
+    }
+
+    const auto wall = _frames.empty() ? 0.0 : std::chrono::duration<double>( _previous - _started ).count();
+
+    os << std::setprecision(6);
+    os << "{\n";
+    os << "  \"script\": " << jsonString(_script) << ",\n";
+    os << "  \"mode\": " << jsonString(mode) << ",\n";
+    os << "  \"timestep\": " << _timestep << ",\n";
+    os << "  \"frames\": " << _frames.size() << ",\n";
+    os << "  \"seconds\": " << wall << ",\n";
+    os << "  \"summary\": {\n";
+    writeSummary( os, "render_ms", summarize(render) );
+    os << ",\n";
+    writeSummary( os, "interval_ms", summarize(interval) );
+    os << "\n  },\n";
+    os << "  \"per_frame\": [\n";
+    for( size_t i = 0; i < _frames.size(); ++i ) {
+        const auto& f = _frames[i];
+        os << "    { \"frame\": " << i << ", \"time\": " << f.time << ", \"render_ms\": " << f.render
+           << ", \"interval_ms\": " << f.interval << ", \"vertices\": " << f.vertices
+           << ", \"triangles\": " << f.triangles << " }" << ( i + 1 < _frames.size() ? "," : "" ) << "\n";
+    }
+    os << "  ]\n}\n";
+
+    return bool(os);
+}
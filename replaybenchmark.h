@@ -0,0 +1,95 @@
+#ifndef REPLAYBENCHMARK_H
+#define REPLAYBENCHMARK_H
+
+
+// stl
+#include <chrono>
+#include <cstddef>
+#include <string>
+#include <vector>
+
+
+class Scenario;
+
+
+// Plays a scripted camera path and edits back at a fixed timestep, one step a frame, and
+// keeps the time of every frame. Frames show the same thing from run to run however long they
+// take, so the timings of two builds, or of windowed and headless runs, can be compared.
+//
+// A script has a command a line; times are in seconds of replay time, '#' starts a comment:
+//
+//   timestep 0.0166667                      replay time a frame, 1/60 by default
+//   duration 10                             else up to the last camera key or edit
+//   settle on                               finish the background replots before each frame
+//   camera <t> px py pz dx dy dz ux uy uz   key of the camera path, linear in between
+//   load <t> [scene]                        the scene file, or the one given to the application
+//   select <t> <x> <y>                      pick at a pixel; 'add' after it keeps the selection
+//   move <t> <dx> <dy>                      drag the selection by pixels
+//   rotate <t> <dx> <dy>                    rotate the selection as a drag would
+//   replot <t> low|high                     the selection
+//   fly <t> U|D|L|R                         as the arrow keys
+//   zoom <t> <factor>                       as the mouse wheel
+//
+// The summary and the frames are written as JSON.
+class ReplayBenchmark {
+public:
+    struct Key {
+        double                                        time;
+        float                                         pos[3];
+        float                                         dir[3];
+        float                                         up[3];
+    };
+
+    struct Edit {
+        double                                        time;
+        std::string                                   command;
+        std::string                                   text;
+        float                                         x {0.0f};
+        float                                         y {0.0f};
+    };
+
+    struct Frame {
+        double                                        time;         // replay time
+        double                                        render {0.0}; // milliseconds in Scenario::render
+        double                                        interval {0.0};   // since the frame before
+        size_t                                        vertices {0};
+        size_t                                        triangles {0};
+    };
+
+    explicit ReplayBenchmark( Scenario& scenario );
+
+    // false with error set on a malformed script
+    bool                                              read( const std::string& path );
+    const std::string&                                getError() const;
+
+    bool                                              isDone() const;
+    size_t                                            getFrameCount() const;
+
+    // Render thread, around the frames: the camera and edits of the step, and its time
+    void                                              beginFrame();
+    void                                              endFrame( size_t vertices, size_t triangles );
+
+    bool                                              writeJson( const std::string& path, const std::string& mode ) const;
+
+private:
+    Scenario&                                         _scenario;
+    std::string                                       _script;
+    std::string                                       _error;
+
+    double                                            _timestep {1.0 / 60.0};
+    double                                            _duration {-1.0};
+    bool                                              _settle {true};
+    std::vector<Key>                                  _keys;
+    std::vector<Edit>                                 _edits;
+
+    size_t                                            _frame {0};
+    size_t                                            _next_edit {0};
+    std::vector<Frame>                                _frames;
+    std::chrono::steady_clock::time_point             _started;
+    std::chrono::steady_clock::time_point             _previous;
+
+    void                                              applyCamera( double time );
+    void                                              apply( const Edit& edit );
+};
+
+#endif // REPLAYBENCHMARK_H
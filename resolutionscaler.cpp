@@ -0,0 +1,88 @@
+#include "resolutionscaler.h"
+
+// stl
+#include <algorithm>
+#include <cmath>
+
+
+ResolutionScaler::ResolutionScaler( Preset preset ) { setPreset(preset); }
+
+ResolutionScaler::Settings ResolutionScaler::settings( Preset preset ) {
+
+    switch( preset ) {
+    case Quality:     return Settings{ 4, false, 1.0f,  1.0f,  1000.0 / 60.0 };
+    case Performance: return Settings{ 0, true,  0.75f, 0.25f, 1000.0 / 60.0 };
+    case Balanced:
+    default:          return Settings{ 0, true,  1.0f,  0.5f,  1000.0 / 60.0 };
+    }
+}
+
+const char* ResolutionScaler::name( Preset preset ) {
+
+    switch( preset ) {
+    case Quality:     return "quality";
+    case Balanced:    return "balanced";
+    case Performance: return "performance";
+    default:          return "";
+    }
+}
+
+void ResolutionScaler::setPreset( Preset preset ) {
+
+    _preset   = preset;
+    _settings = settings(preset);
+    _scale    = _settings.max_scale;
+    _sum      = 0.0;
+    _count    = 0;
+    _settle   = _settle_frames;
+}
+
+ResolutionScaler::Preset ResolutionScaler::getPreset() const { return _preset; }
+
+const ResolutionScaler::Settings& ResolutionScaler::getSettings() const { return _settings; }
+
+bool ResolutionScaler::record( double milliseconds ) {
+
+    if( !_settings.adaptive || milliseconds <= 0.0 )
+        return false;
+
+    if( _settle > 0 ) {
+        --_settle;
+        return false;
+    }
+
+    _sum += milliseconds;
+    if( ++_count < _window )
+        return false;
+
+    const auto mean = _sum / double(_count);
+    _sum   = 0.0;
+    _count = 0;
+
+    auto scale = _scale;
+    if( mean > _settings.target )
+        scale = std::floor( _scale * float( std::sqrt( _settings.target / mean ) ) / _step ) * _step;
+    else if( mean < _grow_below * _settings.target )
+        scale = _scale + _step;
+
+    scale = clamp(scale);
+    if( std::abs( scale - _scale ) < 0.5f * _step )
+        return false;
+
+    _scale  = scale;
+    _settle = _settle_frames;
+    return true;
+}
+
+float ResolutionScaler::getScale() const { return _scale; }
+
+void ResolutionScaler::scaledSize( int width, int height, int& scaled_width, int& scaled_height ) const {
+
+    scaled_width  = std::max( 1, int( std::lround( float(width)  * _scale ) ) );
+    scaled_height = std::max( 1, int( std::lround( float(height) * _scale ) ) );
+}
+
+float ResolutionScaler::clamp( float scale ) const {
+
+    return std::min( _settings.max_scale, std::max( _settings.min_scale, scale ) );
+}
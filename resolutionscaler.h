@@ -0,0 +1,68 @@
+#ifndef RESOLUTIONSCALER_H
+#define RESOLUTIONSCALER_H
+
+
+// stl
+#include <cstddef>
+
+
+// Resolution and multisampling of the scene FBO, as set by a performance preset.
+//
+// Adaptive presets scale the FBO down when the frames measured take longer than the target,
+// and back up while they are well within it. The time of a frame is taken to go with its
+// pixels, the square of the scale: over the target the scale drops at once to where the mean
+// of the latest frames would have met it, under it the scale grows a step at a time. Scales
+// are kept to steps, so that the FBO is not reallocated for every small change, and the
+// first frames after a change, which pay for the new FBO, are not measured.
+class ResolutionScaler {
+public:
+    enum Preset {
+        Quality,            // full resolution, multisampled; the default, as before presets
+        Balanced,           // adaptive, from full resolution
+        Performance,        // adaptive, from a lower resolution
+        PresetCount
+    };
+
+    struct Settings {
+        int                                           samples;        // of the FBO, 0 for none
+        bool                                          adaptive;
+        float                                         max_scale;
+        float                                         min_scale;
+        double                                        target;         // milliseconds a frame
+    };
+
+    explicit ResolutionScaler( Preset preset = Quality );
+
+    static Settings                                   settings( Preset preset );
+    static const char*                                name( Preset preset );
+
+    // Back to the largest scale of the preset
+    void                                              setPreset( Preset preset );
+    Preset                                            getPreset() const;
+    const Settings&                                   getSettings() const;
+
+    // Time of a frame drawn at the current scale; true when the scale changed
+    bool                                              record( double milliseconds );
+
+    float                                             getScale() const;
+    // Size of the FBO for a view of the given size, at least one pixel
+    void                                              scaledSize( int width, int height, int& scaled_width, int& scaled_height ) const;
+
+private:
+    Preset                                            _preset;
+    Settings                                          _settings;
+    float                                             _scale {1.0f};
+
+    float                                             _step {0.05f};
+    double                                            _grow_below {0.7};      // of the target
+    size_t                                            _window {8};            // frames to a mean
+    size_t                                            _settle_frames {3};
+
+    double                                            _sum {0.0};
+    size_t                                            _count {0};
+    size_t                                            _settle {0};
+
+    float                                             clamp( float scale ) const;
+};
+
+#endif // RESOLUTIONSCALER_H
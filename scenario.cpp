@@ -1,7 +1,22 @@
 #include "scenario.h"
 #include "testtorus.h"
+#include "threadpool.h"
+#include "materialpalette.h"
+#include "sceneshard.h"
+#include "lodmanager.h"
+#include "meshexporter.h"
+#include "simulationthread.h"
+#include "frameprofiler.h"
+#include "replaybenchmark.h"
+#include "scenebvh.h"
+#include "occlusionculler.h"
+#include "tessellation/tessellationqueue.h"
+#include "tessellation/meshcache.h"
+#include "tessellation/staticbatcher.h"
+#include "tessellation/replotstats.h"
 
 #include "gmlibsceneloader/gmlibsceneloaderdatadescription.h"
+#include "gmlibsceneloader/gmlibscenebuilder.h"
 
 
 // openddl
@@ -13,13 +28,147 @@
 #include <gmParametricsModule>
 
 // qt
-#include <QTimerEvent>
 #include <QDebug>
 
 // stl
+#include <algorithm>
 #include <cassert>
+#include <chrono>
+#include <cmath>
 #include <iostream>
 #include <iomanip>
+#include <fstream>
+#include <sstream>
+#include <future>
+#include <thread>
+
+namespace {
+
+    // Reads and parses a scene file; nullptr if it can not be read or is malformed
+    std::shared_ptr<GMlibSceneLoaderDataDescription> parseSceneFile( const std::string& filename ) {
+
+        auto gsdd = std::make_shared<GMlibSceneLoaderDataDescription>();
+
+        // The text is parsed as it is decompressed, only an unfinished top-level structure is held back
+        size_t text_length = 0;
+        auto parsed = true;
+        auto parse = [&]( const char* text, size_t size ) {
+
+            text_length += size;
+            parsed = gsdd->AppendText(text,ODDL::int32(size)) == ODDL::kDataOkay;
+            return parsed;
+        };
+
+        gsdd->BeginText();
+        if(!SceneFile::read(filename,parse) && parsed)
+        {
+            std::cerr << "Unable to open " << filename << " for reading..."
+                      << std::endl;
+            return nullptr;
+        }
+
+        std::cout << "Text length: " << text_length << std::endl;
+
+        ODDL::DataResult result = gsdd->EndText();
+
+        //for error
+        if(result != ODDL::kDataOkay)
+        {
+            auto res_to_char = [](auto nr, const ODDL::DataResult& result)
+            {
+                return char(((0xff << (8*nr)) & result ) >> (8*nr));
+            };
+
+            auto res_to_str = [&res_to_char](const ODDL::DataResult& result)
+            {
+                return std::string() + res_to_char(3,result) + res_to_char(2,result) + res_to_char(1,result) + res_to_char(0,result);
+            };
+
+            std::cerr << "!Data result not OK: " << res_to_str(result) << " (" << result << ")"
+                      << " at line " << gsdd->GetErrorLine() << " of " << filename << std::endl;
+            return nullptr;
+        }
+
+        std::cout << "Data result OK" << std::endl;
+
+        auto root = gsdd->GetRootStructure();
+        auto version = root->GetFirstSubstructure( int( GMStructTypes::GMlibVersion ) );
+        if( version && version->GetFirstSubnode() )
+        {
+            auto child = version->GetFirstSubnode();
+
+            if( child->GetStructureType() == int( ODDL::kDataInt32))
+            {
+
+                auto data = static_cast<ODDL::DataStructure<ODDL::Int32DataType>*>(child);
+                std::cout << data << std::endl;
+
+                if( data->GetDataElement(0) == GM_VERSION)
+                {
+                    std::cout << "Valid GMlibVersion" << std::endl;
+                }
+                else std::cout << "Non-valid GMlibVersion" << std::endl;
+            }
+            else std::cout << "Non-valid GMlibVersion" << std::endl;
+        }
+
+        return gsdd;
+    }
+
+    // "dir/" part of a path, empty in the working directory
+    std::string directoryOf( const std::string& path ) {
+
+        auto slash = path.find_last_of("/\\");
+        return slash == std::string::npos ? std::string() : path.substr(0, slash + 1);
+    }
+
+    // Path without its scene file extension
+    std::string stemOf( const std::string& path ) {
+
+        auto ext = SceneFile::extension( SceneFile::compression(path) );
+        if( path.size() > ext.size() && path.compare( path.size() - ext.size(), ext.size(), ext ) == 0 )
+            return path.substr( 0, path.size() - ext.size() );
+
+        auto dot = path.find_last_of('.');
+        if( dot == std::string::npos || dot < directoryOf(path).size() )
+            return path;
+        return path.substr(0, dot);
+    }
+
+    // OpenDDL string literal
+    std::string quoted( const std::string& str ) {
+
+        std::string out("\"");
+        for( auto c : str ) {
+            if( c == '"' || c == '\\' ) out += '\\';
+            out += c;
+        }
+        return out + '"';
+    }
+
+    // Hides the objects culled from a renderer pass, and shows them again after it.
+    // Objects hidden in the scene are left as they are
+    class HiddenObjects {
+    public:
+        explicit HiddenObjects( const std::vector<GMlib::SceneObject*>& objects ) {
+
+            for( auto obj : objects )
+                if( obj->isVisible() ) {
+                    obj->setVisible(false);
+                    _hidden.push_back(obj);
+                }
+        }
+
+        ~HiddenObjects() {
+
+            for( auto obj : _hidden )
+                obj->setVisible(true);
+        }
+
+    private:
+        std::vector<GMlib::SceneObject*> _hidden;
+    };
+}
 
 
 //class SimStateLock {
@@ -41,7 +190,7 @@
 
 
 
-Scenario::Scenario() : QObject(), _timer_id{0}/*, _select_renderer{nullptr}*/ {
+Scenario::Scenario() : QObject()/*, _select_renderer{nullptr}*/ {
 
     if(_instance != nullptr) {
 
@@ -52,6 +201,9 @@ Scenario::Scenario() : QObject(), _timer_id{0}/*, _select_renderer{nullptr}*/ {
     }
 
     _instance = std::unique_ptr<Scenario>(this);
+
+    // Read from the ui thread before the renderer is up
+    _replot_stats = std::make_unique<ReplotStats>();
 }
 
 Scenario::~Scenario() {
@@ -61,8 +213,23 @@ Scenario::~Scenario() {
 
 void Scenario::deinitialize() {
 
+    // A replay cut short leaves no results
+    _replay.reset();
+    _replaying = false;
+
     stopSimulation();
 
+    // Results still on their way are not wanted anymore
+    _tessellation->clear();
+    if(_export.valid())
+        _export.wait();
+    for( auto& shard : _shards )
+        if(shard->saving.valid())
+            finishUnload(*shard);
+
+    _mesh_cache->release(_testtorus.get());
+    _static_batcher->release(_testtorus.get());
+    _replot_stats->forget(_testtorus.get());
     _scene->remove(_testtorus.get());
     _testtorus.reset();
 
@@ -75,9 +242,19 @@ void Scenario::deinitialize() {
     _renderer.reset();
     _camera.reset();
 
+    _simulation.reset();
+    _bvh.reset();
+    _occlusion.reset();
     _scene->clear();
     _scene.reset();
 
+    // Shared tessellations go after the last surface drawing them
+    _mesh_cache->clear();
+    _static_batcher->clear();
+    _replot_stats->clear();
+    _shard_of.clear();
+    _shards.clear();
+
     // Clean up GMlib GL backend
     GMlib::GL::OpenGLManager::cleanUp();
 }
@@ -89,6 +266,22 @@ void Scenario::initialize() {
 
     // Setup and init the GMlib GMWindow
     _scene = std::make_shared<GMlib::Scene>();
+
+    // Only steps that move something ask for a frame
+    _simulation = std::make_unique<SimulationThread>(*_scene,_simulation_timestep);
+    _bvh = std::make_unique<SceneBvh>();
+    _occlusion = std::make_unique<OcclusionCuller>();
+    _simulation->setStepCallback([this](bool moved) { if(moved) requestRedraw(); });
+
+    _lod = std::make_unique<LodManager>();
+    _tessellation = std::make_unique<TessellationQueue>();
+    _mesh_cache = std::make_unique<MeshCache>(*_tessellation);
+    _static_batcher = std::make_unique<StaticBatcher>();
+
+    // Sampling and upload times of every pass
+    _tessellation->setMeasureCallback([this](const GMlib::PSurf<float,3>* s, const SurfaceSamples& samples, double upload_time) {
+        _replot_stats->tessellated(s,samples.m1,samples.m2,samples.pass,samples.time,upload_time);
+    });
 }
 
 void Scenario::initializeScenario() {
@@ -123,6 +316,7 @@ void Scenario::initializeScenario() {
     _camera->setCuttingPlanes( 1.0f, 8000.0f );
     _camera->rotateGlobal( GMlib::Angle(-45), GMlib::Vector<float,3>( 1.0f, 0.0f, 0.0f ) );
     _camera->translateGlobal( GMlib::Vector<float,3>( 0.0f, -20.0f, 20.0f ) );
+    // Culled by Scenario::cullObjects instead
     _camera->enableCulling(false);
     _scene->insertCamera( _camera.get() );
     _renderer->reshape( GMlib::Vector<int,2>(init_viewport_size, init_viewport_size) );
@@ -130,7 +324,7 @@ void Scenario::initializeScenario() {
     // Surfaces
     _testtorus = std::make_shared<TestTorus>();
     _testtorus->toggleDefaultVisualizer();
-    _testtorus->replot(200,200,1,1);
+    replot(_testtorus.get(),200,200,1,1);
     _testtorus->setMaterial(GMlib::GMmaterial::Pewter);
     _scene->insert(_testtorus.get());
 
@@ -140,7 +334,7 @@ void Scenario::initializeScenario() {
     //std::shared_ptr<GMlib::PCylinder<float>> cylinder= std::make_shared<GMlib::PCylinder<float>>(2,2,15) ;
     auto cylinder=new GMlib::PCylinder<float>(2,2,15);
     cylinder->toggleDefaultVisualizer();
-    cylinder->replot(100,100,20,20);
+    replot(cylinder,100,100,20,20);
     cylinder->set(GMlib::Point<float,3>(0,12,0), GMlib::Vector<float,3>( 1.0f, 1.0f, 0.0f ),
                   GMlib::Vector<float,3>( 0.0f, 0.0f, 1.0f ));
     cylinder->setMaterial(GMlib::GMmaterial::Bronze);
@@ -152,7 +346,7 @@ void Scenario::initializeScenario() {
     sphere->setMaterial(GMlib::GMmaterial::PolishedRed);
     sphere->setLighted(false);
     sphere->toggleDefaultVisualizer();
-    sphere->replot(50,50,10,10);
+    replot(sphere,50,50,10,10);
     _scene->insert(sphere);
 
 
@@ -161,9 +355,12 @@ void Scenario::initializeScenario() {
     plane->setMaterial(GMlib::GMmaterial::Snow);
     plane->setLighted(false);
     plane->toggleDefaultVisualizer();
-    plane->replot(50,50,1,1);
     _scene->insert(plane);
 
+    // The floor never moves
+    setStatic(plane,true);
+    replot(plane,50,50,1,1);
+
 }
 
 std::unique_ptr<Scenario> Scenario::_instance {nullptr};
@@ -174,6 +371,25 @@ void Scenario::prepare() { _scene->prepare(); }
 
 void Scenario::render( const QRect& viewport_in, GMlib::RenderTarget& target ) {
 
+    // What changes from here on asks for the next frame
+    auto requested = _redraw.exchange(false);
+
+    // Objects between the last two simulation steps, as of now
+    auto lock = _simulation->lock();
+
+    // The camera and edits of the replay step
+    if(_replay)
+        _replay->beginFrame();
+
+    {
+        FrameProfiler::Scope timing(FrameProfiler::Prepare);
+        _interpolating = _simulation->interpolate();
+        prepare();
+    }
+
+    // Meshes finished in the background since the last frame
+    _tessellation->upload();
+
     // Update viewport
     if(_viewport != viewport_in) {
 
@@ -184,38 +400,195 @@ void Scenario::render( const QRect& viewport_in, GMlib::RenderTarget& target ) {
         _camera->reshape( 0, 0, size.width(), size.height() );
     }
 
-    // Render and swap buffers
-    _renderer->render(target);
+    // Sample counts follow the projected size of the surfaces; after a change the frames go on
+    // until a pass has looked at it
+    if(requested || _interpolating)
+        _lod->invalidate();
+    for( const auto& r : _lod->update(*_scene,*_camera,_viewport.width(),_viewport.height()) )
+        replot(r.surface,r.samples_u,r.samples_v,r.surface->getDerivativesU(),r.surface->getDerivativesV());
+
+    // Static surfaces that moved, were replotted or changed material since the last frame
+    _static_batcher->update();
+
+    // Read by the ui thread
+    const auto& usage = _lod->getUsage();
+    const auto& budget = _lod->getBudget();
+    _vertices = usage.vertices;
+    _triangles = usage.triangles;
+    _vertex_budget = budget.vertices;
+    _triangle_budget = budget.triangles;
+
+    // Render and swap buffers; objects off the view frustum are left out of the pass
+    {
+        const HiddenObjects culled( cullObjects(true) );
+        PackedSurfaceVisualizer::beginFrame();
+        StaticBatchVisualizer::beginFrame();
+        _renderer->render(target);
+    }
+
+    // Replay frames are timed up to the GPU being done with them, windowed or not
+    if(_replay) {
+        glFinish();
+        _replay->endFrame(_vertices,_triangles);
+        if(_replay->isDone())
+            finishReplay();
+    }
+}
+
+bool Scenario::startReplay(const std::string &script, const std::string &json, const std::string &mode) {
+
+    auto replay = std::make_unique<ReplayBenchmark>(*this);
+    if(!replay->read(script)) {
+        std::cerr << "Replay: " << replay->getError() << std::endl;
+        return false;
+    }
+
+    // Steps follow the script alone, and every frame is drawn
+    stopSimulation();
+    _replay_on_demand = _render_on_demand;
+    setRenderOnDemand(false);
+
+    std::cout << "Replaying " << script << ", " << replay->getFrameCount() << " frames" << std::endl;
+
+    auto lock = lockScene();
+    _replay = std::move(replay);
+    _replay_json = json.empty() ? stemOf(script) + ".json" : json;
+    _replay_mode = mode;
+    _replaying = true;
+    return true;
+}
+
+bool Scenario::isReplaying() const { return _replaying; }
+
+void Scenario::finishReplay() {
+
+    if(_replay->writeJson(_replay_json,_replay_mode))
+        std::cout << "Replay results written to " << _replay_json << std::endl;
+    else
+        std::cerr << "Can't write " << _replay_json << std::endl;
+
+    _replay.reset();
+    _replaying = false;
+    setRenderOnDemand(_replay_on_demand);
+
+    emit signReplayFinished();
 }
 
 void Scenario::startSimulation() {
 
-    if( _timer_id || _scene->isRunning() )
+    if( !_simulation || _simulation->isRunning() )
         return;
 
-    _timer_id = startTimer(16, Qt::PreciseTimer);
     _scene->start();
+    _simulation->start();
 }
 
 void Scenario::stopSimulation() {
 
-    if( !_timer_id || !_scene->isRunning() )
+    if( !_simulation || !_simulation->isRunning() )
         return;
 
+    _simulation->stop();
     _scene->stop();
-    killTimer(_timer_id);
-    _timer_id = 0;
 }
 
-void Scenario::timerEvent(QTimerEvent* e) {
+void Scenario::toggleSimulation() { _scene->toggleRun(); }
 
-    e->accept();
+void Scenario::setSimulationTimestep(double seconds) {
 
-    _scene->simulate();
-    prepare();
+    _simulation_timestep = seconds;
+    if(_simulation)
+        _simulation->setTimestep(seconds);
 }
 
-void Scenario::toggleSimulation() { _scene->toggleRun(); }
+std::unique_lock<std::mutex> Scenario::lockScene() { return _simulation->lock(); }
+
+void Scenario::setFrustumCulling(bool on) { _frustum_culling = on; }
+
+void Scenario::toggleFrustumCulling() {
+
+    _frustum_culling = !_frustum_culling;
+    qDebug() << "Frustum culling" << (_frustum_culling ? "on" : "off");
+}
+
+size_t Scenario::getDrawnObjects() const { return _drawn_objects; }
+
+size_t Scenario::getCulledObjects() const { return _culled_objects; }
+
+void Scenario::setOcclusionCulling(bool on) { _occlusion_culling = on; }
+
+void Scenario::toggleOcclusionCulling() {
+
+    _occlusion_culling = !_occlusion_culling;
+    qDebug() << "Occlusion culling" << (_occlusion_culling ? "on" : "off");
+}
+
+size_t Scenario::getOccludedObjects() const { return _occluded_objects; }
+
+std::vector<GMlib::SceneObject*> Scenario::cullObjects(bool count) {
+
+    // Kept up to date either way, so turning culling on does not rebuild
+    _bvh->update(*_scene);
+
+    const auto w = _camera->getViewportW();
+    const auto h = _camera->getViewportH();
+
+    std::vector<GMlib::SceneObject*> culled;
+    if(_frustum_culling)
+        culled = _bvh->cull(*_camera,w,h);
+    const auto outside = culled.size();
+
+    // What is left is tested against the largest of it
+    if(_occlusion_culling) {
+
+        std::vector<GMlib::SceneObject*> inside;
+        const std::set<GMlib::SceneObject*> skip(culled.begin(),culled.end());
+        for( auto obj : _bvh->getObjects() )
+            if( !skip.count(obj) )
+                inside.push_back(obj);
+
+        const auto occluded = _occlusion->cull(inside,*_camera,w,h);
+        culled.insert(culled.end(),occluded.begin(),occluded.end());
+    }
+
+    // Read by the ui thread
+    if(count) {
+        _culled_objects = outside;
+        _occluded_objects = culled.size() - outside;
+        _drawn_objects = _bvh->getObjectCount() - culled.size();
+    }
+
+    return culled;
+}
+
+void Scenario::setRenderOnDemand(bool on) {
+
+    _render_on_demand = on;
+    requestRedraw();
+}
+
+bool Scenario::isRenderOnDemand() const { return _render_on_demand; }
+
+void Scenario::toggleRenderOnDemand() {
+
+    setRenderOnDemand(!_render_on_demand);
+    qDebug() << "Render on demand" << (_render_on_demand ? "on" : "off");
+}
+
+void Scenario::requestRedraw() {
+
+    // One queued update per frame is enough
+    if(!_redraw.exchange(true))
+        emit signRedrawRequested();
+}
+
+bool Scenario::needsRedraw() const {
+
+    // Meshes still being sampled are uploaded by the frames to come, and levels of detail
+    // are picked every few frames
+    return !_render_on_demand || _redraw || _interpolating || _tessellation->getPending() > 0 ||
+           _lod->isPending();
+}
 
 // **************************************************************
 
@@ -223,9 +596,9 @@ GMlib::Point<int, 2> Scenario::convertQtPointToGMlibViewPoint( const QPoint& pos
 
     int h =_camera->getViewportH();// cam.getViewportH(); // Height of the camera’s viewport
 
-    // QPoint
-    int q1 = pos.x();
-    int q2 = pos.y();
+    // QPoint, in the pixels of the viewport
+    int q1 = int(pos.x() * _input_scale_x);
+    int q2 = int(pos.y() * _input_scale_y);
     // GMlib Point
     int p1 = q1;
     int p2 = h - q2 - 1;
@@ -237,6 +610,12 @@ GMlib::Point<int, 2> Scenario::convertQtPointToGMlibViewPoint( const QPoint& pos
     return GMlib::Point<int, 2> (p1, p2);
 }
 
+void Scenario::setInputScale(float x, float y) {
+
+    _input_scale_x = x;
+    _input_scale_y = y;
+}
+
 GMlib::SceneObject* Scenario::findSceneObject(QPoint &pos)
 {
     GMlib::SceneObject *selected_obj = nullptr;
@@ -250,6 +629,9 @@ GMlib::SceneObject* Scenario::findSceneObject(QPoint &pos)
     //select code
     GMlib::Point <int,2> qp = convertQtPointToGMlibViewPoint(pos);
 
+    // What is off screen can't be under the cursor
+    const HiddenObjects culled( cullObjects(false) );
+
     _select_renderer->select(GMlib::GM_SO_TYPE_SELECTOR);
 
     selected_obj=_select_renderer->findObject(qp(0),qp(1));
@@ -264,6 +646,13 @@ GMlib::SceneObject* Scenario::findSceneObject(QPoint &pos)
     return selected_obj;
 }
 
+void Scenario::setCameraFrame(const GMlib::Point<float,3>& pos, const GMlib::Vector<float,3>& dir,
+                              const GMlib::Vector<float,3>& up) {
+
+    _camera->set(pos,dir,up);
+    requestRedraw();
+}
+
 void Scenario::camFly(char direction)
 {
     GMlib::Vector<float,3> dS;
@@ -495,39 +884,27 @@ void Scenario::changeColor()
 {
     const GMlib::Array<GMlib::SceneObject*> &selected_objects = _scene->getSelectedObjects();
 
-    std::vector<GMlib::Material> colors=
-    {GMlib::GMmaterial::BlackPlastic,GMlib::GMmaterial::BlackRubber,
-     GMlib::GMmaterial::Brass,GMlib::GMmaterial::Bronze,
-     GMlib::GMmaterial::Chrome,GMlib::GMmaterial::Copper,
-     GMlib::GMmaterial::Emerald,GMlib::GMmaterial::Gold,
-     GMlib::GMmaterial::Jade,GMlib::GMmaterial::Obsidian,
-     GMlib::GMmaterial::Pearl,GMlib::GMmaterial::Pewter,
-     GMlib::GMmaterial::Plastic,GMlib::GMmaterial::PolishedBronze,
-     GMlib::GMmaterial::PolishedCopper,GMlib::GMmaterial::PolishedGold,
-     GMlib::GMmaterial::PolishedGreen,GMlib::GMmaterial::PolishedRed,
-     GMlib::GMmaterial::PolishedSilver, GMlib::GMmaterial::Ruby,
-     GMlib::GMmaterial::Sapphire, GMlib::GMmaterial::Silver,
-     GMlib::GMmaterial::Snow, GMlib::GMmaterial::Turquoise};
+    const auto& colors = MaterialPalette::presets();
 
     for( int k = 0; k < selected_objects.getSize(); k++ )
     {
         GMlib::SceneObject* obj = selected_objects(k);
 
         auto cj = obj->getMaterial();
-        unsigned int color_num=0;
-        for (unsigned int i=0;i<colors.size(); i++){
-            if (cj == colors[i]){
+        int color_num=0;
+        for (int i=0;i<colors.getSize(); i++){
+            if (cj == colors.getMaterial(i)){
                 color_num = i;
                 break;
             }
         }
 
-        if(color_num<colors.size()){
-            obj->setMaterial(colors[++color_num]);
+        if(color_num<colors.getSize()){
+            obj->setMaterial(colors.getMaterial(++color_num));
             qDebug()<<"k="<<k<<" color="<<color_num;
         }
 
-        else obj->setMaterial(colors[0]);
+        else obj->setMaterial(colors.getMaterial(0));
 
     }
 
@@ -539,7 +916,7 @@ void Scenario::insertObject(const QPoint& pos, char object)
     {
         auto sphere = new GMlib::PSphere<float>(1);
         sphere->toggleDefaultVisualizer();
-        sphere->replot(200,200,1,1);
+        replot(sphere,200,200,1,1);
         sphere->setMaterial(GMlib::GMmaterial::Gold);
 
         auto gmPos = convertQtPointToGMlibViewPoint(pos);
@@ -564,15 +941,38 @@ void Scenario::insertObject(const QPoint& pos, char object)
 
 void Scenario::deleteObject()
 {
-    const GMlib::Array<GMlib::SceneObject*> &selected_objects = _scene->getSelectedObjects();
+    // A copy, releasing an object deselects it
+    const GMlib::Array<GMlib::SceneObject*> selected_objects = _scene->getSelectedObjects();
 
     for( int i = 0; i < selected_objects.getSize(); i++ )
     {
         GMlib::SceneObject* obj = selected_objects(i);
-        _scene->remove(obj);
+        releaseObject(obj);
     }
 }
 
+void Scenario::releaseObject(GMlib::SceneObject *obj) {
+
+    // The caches let go of the children themselves
+    _mesh_cache->release(obj);
+    _static_batcher->release(obj);
+    _replot_stats->forget(obj);
+    forgetObject(obj);
+    _scene->remove(obj);
+}
+
+void Scenario::forgetObject(GMlib::SceneObject *obj) {
+
+    const auto& children = obj->getChildren();
+    for(auto i = 0; i < children.getSize(); ++i )
+        forgetObject(children(i));
+
+    obj->setSelected(false);
+    _lod->forget(obj);
+    _tessellation->forget(dynamic_cast<GMlib::PSurf<float,3>*>(obj));
+    _shard_of.erase(obj);
+}
+
 #define Saving {
 
 void Scenario::save() {
@@ -580,39 +980,321 @@ void Scenario::save() {
     qDebug() << "Saving scene...";
     stopSimulation(); {
 
+        // Apart from the render thread, which also hides culled objects while drawing a frame
+        auto lock = lockScene();
 
-        auto filename = std::string("gmlib_save.openddl");
+        // Objects of loaded shards go back to their shard, the rest is written into the scene file itself.
+        // With a shard cell size, the loose objects are distributed over shards by position.
+        std::map<SceneShard*,std::vector<const GMlib::SceneObject*>> shard_objects;
+        std::vector<const GMlib::SceneObject*> objects;
 
-        auto os = std::ofstream(filename,std::ios_base::out);
-        if(!os.is_open()) {
-            std::cerr << "Unable to open " << filename << " for saving..."
-                      << std::endl;
+        std::map<std::string,SceneShard*> cells;
+        for( auto& shard : _shards ) {
+            if(shard->loaded) shard_objects[shard.get()];
+            cells[shard->group] = shard.get();
+        }
+
+        auto &scene = *_scene;
+        for( auto i = 0; i < scene.getSize(); ++i ) {
+
+            const GMlib::SceneObject* obj = scene[i];
+            if(dynamic_cast<const GMlib::Camera*>(obj)) continue;
+
+            auto owner = _shard_of.find(obj);
+            if(owner != _shard_of.end()) {
+                shard_objects[owner->second].push_back(obj);
+                continue;
+            }
+
+            if(_shard_cell_size <= 0.0f) {
+                objects.push_back(obj);
+                continue;
+            }
+
+            const auto& pos = obj->getPos();
+            std::ostringstream cell;
+            cell << "cell_" << int(std::floor(pos(0) / _shard_cell_size))
+                 << "_"     << int(std::floor(pos(1) / _shard_cell_size))
+                 << "_"     << int(std::floor(pos(2) / _shard_cell_size));
+
+            auto& shard = cells[cell.str()];
+            if(!shard) {
+
+                auto ext = SceneFile::extension( SceneFile::compression(_scene_path) );
+                _shards.push_back(std::make_unique<SceneShard>());
+                shard         = _shards.back().get();
+                shard->group  = cell.str();
+                shard->path   = stemOf(_scene_path) + "." + cell.str() + ext;
+                shard->file   = shard->path.substr( directoryOf(_scene_path).size() );
+                shard->loaded = true;
+            }
+
+            _shard_of[obj] = shard;
+            shard_objects[shard].push_back(obj);
+        }
+
+        std::set<const GMlib::SceneObject*> statics;
+        for( auto i = 0; i < scene.getSize(); ++i )
+            collectStatic(scene[i],statics);
+
+        auto saved = true;
+        for( auto& shard : shard_objects ) {
+
+            updateShardBounds(*shard.first,shard.second);
+            if(!saveFile(shard.first->path,shard.second,std::string(),statics))
+                saved = false;
+        }
+
+        std::ostringstream manifest;
+        saveShardTable(manifest);
+        if(!saveFile(_scene_path,objects,manifest.str(),statics))
+            saved = false;
+
+        if(!saved) {
+            startSimulation();
             return;
         }
 
-        os << "GMlibVersion { int { 0x"
+    }
+
+    startSimulation();
+    qDebug() << "The scene was success saved";
+
+}
+
+bool Scenario::saveFile(const std::string &filename, const std::vector<const GMlib::SceneObject *> &objects,
+                        const std::string &manifest, const std::set<const GMlib::SceneObject *> &statics) {
+
+    // Shards are also written off the render thread, the state of a save is shared
+    std::lock_guard<std::mutex> lock(_save_mutex);
+
+    auto compression = SceneFile::compression(filename);
+    if(!SceneFile::isSupported(compression)) {
+        std::cerr << "Compression of " << filename << " is not supported in this build" << std::endl;
+        return false;
+    }
+
+    std::ostringstream header;
+    header << "GMlibVersion { int32 { 0x"
            << std::setw(6) << std::setfill('0')
-           << std::hex << GM_VERSION
+           << std::hex << GM_VERSION << std::dec
            << " } }"
            << std::endl<<std::endl;
 
+    header << manifest;
 
-        auto &scene = *_scene;
-        for( auto i = 0; i < scene.getSize(); ++i ) {
+    // Which surfaces are static is given, the batcher is not to be asked off the render thread
+    _save_static = statics;
+
+    // Materials are written once, objects refer to them by name
+    _save_palette = std::make_unique<MaterialPalette>();
+    for( auto obj : objects )
+        collectMaterials(obj);
+    saveMaterialTable(header);
+
+    // So is the shape of identical surfaces, objects become instances of a prototype
+    for( auto obj : objects )
+        collectPrototypes(obj,header);
+    savePrototypes(header);
 
-            const auto obj = scene[i];
-            save(os,obj);
+    auto saved = false;
+    if(_parallel_save) {
 
+        // Every buffer inherits the formatting state of the header stream,
+        // so the output matches the serial path byte for byte.
+        // Compressed buffers are independent gzip members / zstd frames, the file is their concatenation.
+        auto buffers = saveParallel(header,compression,objects);
+        buffers.insert(buffers.begin(), SceneFile::compress(header.str(),compression));
+        saved = SceneFile::write(filename,buffers);
+    }
+    else if(compression != SceneFile::Compression::None) {
+
+        std::ostringstream os;
+        os << header.str();
+        os.copyfmt(header);
+        saveSerial(os,objects);
+        saved = SceneFile::write(filename,{SceneFile::compress(os.str(),compression)});
+    }
+    else {
+
+        auto os = std::ofstream(filename,std::ios_base::out);
+        if(os.is_open()) {
+
+            os << header.str();
+            os.copyfmt(header);
+            saveSerial(os,objects);
+            saved = bool(os);
         }
+    }
+
+    _save_palette.reset();
+    _save_static.clear();
+    _save_prototypes.clear();
+    _save_prototype_ids.clear();
+    _save_prototype_of.clear();
+
+    if(!saved)
+        std::cerr << "Unable to open " << filename << " for saving..."
+                  << std::endl;
+
+    return saved;
+}
+
+void Scenario::setParallelSave(bool parallel) { _parallel_save = parallel; }
+
+void Scenario::setScenePath(const std::string &path) { _scene_path = path; }
+
+const std::string& Scenario::scenePath() const { return _scene_path; }
 
+void Scenario::exportMeshes() {
+
+    if(_export.valid() && _export.wait_for(std::chrono::seconds(0)) != std::future_status::ready) {
+        qDebug() << "Export still running";
+        return;
     }
 
-    startSimulation();
-    qDebug() << "The scene was success saved";
+    auto path = _export_path.empty() ? stemOf(_scene_path) + ".glb" : _export_path;
+    MeshExporter::Format format;
+    if(!MeshExporter::format(path,format)) {
+        qDebug() << "Unknown export format:" << QString::fromStdString(path);
+        return;
+    }
+
+    // The snapshot is taken here; sampling and writing don't hold up the frames. The export
+    // is coordinated off the pool, its workers sample the surfaces.
+    auto exporter = std::make_shared<MeshExporter>();
+    exporter->collect(*_scene,_export_samples,_export_samples);
+
+    qDebug() << "Exporting meshes to" << QString::fromStdString(path);
+    _export = std::async(std::launch::async,[exporter,path,format]() {
+
+        auto result = exporter->write(path,format);
+        if(!result.written) {
+            qDebug() << "Export failed:" << QString::fromStdString(path);
+            return;
+        }
+
+        qDebug() << "Exported" << result.surfaces << "surfaces," << result.triangles << "triangles,"
+                 << result.bytes << "bytes in" << result.time << "ms";
+    });
+}
+
+void Scenario::setExportPath(const std::string &path) { _export_path = path; }
 
+void Scenario::setExportSamples(int samples) { _export_samples = std::max(samples,2); }
+
+void Scenario::collectMaterials(const GMlib::SceneObject *obj) {
+
+    if(dynamic_cast<const GMlib::Camera*>(obj)) return;
+
+    _save_palette->insert(obj->getMaterial());
+
+    const auto& children = obj->getChildren();
+    for(auto i = 0; i < children.getSize(); ++i )
+        collectMaterials(children(i));
 }
 
-void Scenario::save(std::ofstream &os, const GMlib::SceneObject *obj) {
+void Scenario::saveMaterialTable(std::ostream &os) {
+
+    using namespace std;
+
+    auto color = [&os](const GMlib::Color& c) {
+        os << "Color {"
+           << " double[3] { {" << c.getRedC()<<", "<<c.getGreenC()<<", "<<c.getBlueC()<<"} }"
+           << " }"<<endl;
+    };
+
+    os << "MaterialTable"<<endl<<"{"<<endl<<endl;
+    for( auto i = 0; i < _save_palette->getSize(); ++i ) {
+
+        const auto& m = _save_palette->getMaterial(i);
+        os << "Material $" << _save_palette->getName(i) <<endl<<"{"<<endl;
+        color(m.getAmb());
+        color(m.getDif());
+        color(m.getSpc());
+        os << "float {" << m.getShininess() << "}"<<endl
+           << "}"<<endl<<endl;
+    }
+    os << "}"<<endl<<endl;
+}
+
+void Scenario::collectPrototypes(const GMlib::SceneObject *obj, const std::ostream &fmt) {
+
+    if(dynamic_cast<const GMlib::Camera*>(obj)) return;
+
+    // The shape description itself is the key; equal text means equal tessellation
+    std::ostringstream shape;
+    shape.copyfmt(fmt);
+    saveShape(shape,obj);
+
+    if(!shape.str().empty()) {
+
+        auto id = _save_prototype_ids.find(shape.str());
+        if(id == _save_prototype_ids.end()) {
+
+            id = _save_prototype_ids.emplace(shape.str(),int(_save_prototypes.size())).first;
+
+            std::ostringstream prototype;
+            prototype << obj->getIdentity() << " $Prototype" << id->second << std::endl
+                      << "{" << std::endl << std::endl
+                      << shape.str()
+                      << "}" << std::endl << std::endl;
+            _save_prototypes.push_back(prototype.str());
+        }
+
+        _save_prototype_of[obj] = id->second;
+    }
+
+    const auto& children = obj->getChildren();
+    for(auto i = 0; i < children.getSize(); ++i )
+        collectPrototypes(children(i),fmt);
+}
+
+void Scenario::savePrototypes(std::ostream &os) {
+
+    using namespace std;
+
+    os << "Prototypes"<<endl<<"{"<<endl<<endl;
+    for( const auto& prototype : _save_prototypes )
+        os << prototype;
+    os << "}"<<endl<<endl;
+}
+
+void Scenario::saveSerial(std::ostream &os, const std::vector<const GMlib::SceneObject *> &objects) {
+
+    for( auto obj : objects )
+        save(os,obj);
+}
+
+std::vector<std::string> Scenario::saveParallel(const std::ostream &fmt, SceneFile::Compression compression,
+                                                const std::vector<const GMlib::SceneObject *> &objects) {
+
+    auto &pool  = ThreadPool::instance();
+
+    // One job per top-level object, each subtree is serialized into its own buffer
+    std::vector<std::future<std::string>> jobs;
+    jobs.reserve(objects.size());
+    for( auto obj : objects ) {
+
+        jobs.push_back( pool.submit( [this,obj,&fmt,compression]() {
+
+            std::ostringstream buffer;
+            buffer.copyfmt(fmt);
+            save(buffer,obj);
+            return SceneFile::compress(buffer.str(),compression);
+        }));
+    }
+
+    // Collect in scene order
+    std::vector<std::string> buffers;
+    buffers.reserve(jobs.size());
+    for( auto& job : jobs )
+        buffers.push_back(job.get());
+
+    return buffers;
+}
+
+void Scenario::save(std::ostream &os, const GMlib::SceneObject *obj) {
 
 
     auto cam_obj = dynamic_cast<const GMlib::Camera*>(obj);
@@ -624,6 +1306,24 @@ void Scenario::save(std::ofstream &os, const GMlib::SceneObject *obj) {
 
     saveSO(os,obj);
 
+    auto prototype = _save_prototype_of.find(obj);
+    if(prototype != _save_prototype_of.end())
+        os << "ref { $Prototype" << prototype->second << " }" << std::endl << std::endl;
+    else
+        saveShape(os,obj);
+
+
+    const auto& children = obj->getChildren();
+    for(auto i = 0; i < children.getSize(); ++i )
+        save(os,children(i));
+
+    os << "}"
+       << std::endl<<std::endl;
+
+}
+
+void Scenario::saveShape(std::ostream &os, const GMlib::SceneObject *obj) {
+
     auto torus = dynamic_cast<const GMlib::PTorus<float>*>(obj);
     if(torus)
         savePT(os,torus);
@@ -639,18 +1339,9 @@ void Scenario::save(std::ofstream &os, const GMlib::SceneObject *obj) {
     auto  plane = dynamic_cast<const GMlib::PPlane<float>*>(obj);
     if(plane)
         savePP(os,plane);
-
-
-    const auto& children = obj->getChildren();
-    for(auto i = 0; i < children.getSize(); ++i )
-        save(os,children(i));
-
-    os << "}"
-       << std::endl<<std::endl;
-
 }
 
-void Scenario::saveSO(std::ofstream &os, const GMlib::SceneObject *obj) {
+void Scenario::saveSO(std::ostream &os, const GMlib::SceneObject *obj) {
 
     using namespace std;
     os << "SceneObjectData" << endl
@@ -658,13 +1349,13 @@ void Scenario::saveSO(std::ofstream &os, const GMlib::SceneObject *obj) {
 
 
     os << "set"<<endl<<"{"<<endl<<"Point {"
-       << " float[3] { " << obj->getPos()(0)<<", "<<obj->getPos()(1)<<", "<<obj->getPos()(2)<<" }"
+       << " float[3] { {" << obj->getPos()(0)<<", "<<obj->getPos()(1)<<", "<<obj->getPos()(2)<<"} }"
        << " }"<<endl;
     os <<"Vector {"
-      << " float[3] { " << obj->getDir()(0)<<", "<<obj->getDir()(1)<<", "<<obj->getDir()(2)<<" }"
+      << " float[3] { {" << obj->getDir()(0)<<", "<<obj->getDir()(1)<<", "<<obj->getDir()(2)<<"} }"
       << " }"<<endl;
     os <<"Vector {"
-      << " float[3] { " << obj->getUp()(0)<<", "<<obj->getUp()(1)<<", "<<obj->getUp()(2)<<" }"
+      << " float[3] { {" << obj->getUp()(0)<<", "<<obj->getUp()(1)<<", "<<obj->getUp()(2)<<"} }"
       << " }"<<endl<<"}"<<endl<<endl;
 
 
@@ -677,29 +1368,24 @@ void Scenario::saveSO(std::ofstream &os, const GMlib::SceneObject *obj) {
     os << "setVisible{ bool {"
        << ( obj->isVisible()?"true":"false")
        << "} }"<<endl<<endl;
+    os << "setStatic{ bool {"
+       << ( _save_static.count(obj)?"true":"false")
+       << "} }"<<endl<<endl;
 
 
     os << "setColor"<<endl<<"{"<<endl<<"Color {"
-       << " double[3] { " << obj->getColor().getRedC()<<", "<<obj->getColor().getGreenC()<<", "<<obj->getColor().getBlueC()<<" }"
+       << " double[3] { {" << obj->getColor().getRedC()<<", "<<obj->getColor().getGreenC()<<", "<<obj->getColor().getBlueC()<<"} }"
        << " }"<<endl<<"}"<<endl<<endl;
 
 
-    os << "setMaterial"<<endl<<"{"<<endl<<"Material"<<endl<<"{"<<endl<<"Color {"
-       << " double[3] { " << obj->getMaterial().getAmb().getRedC()<<", "<<obj->getMaterial().getAmb().getGreenC()<<", "<<obj->getMaterial().getAmb().getBlueC()<<" }"
-       << " }"<<endl;
-    os <<"Color {"
-      << " double[3] { " << obj->getMaterial().getDif().getRedC()<<", "<<obj->getMaterial().getDif().getGreenC()<<", "<<obj->getMaterial().getDif().getBlueC()<<" }"
-      << " }"<<endl;
-    os <<"Color {"
-      << " double[3] { " << obj->getMaterial().getSpc().getRedC()<<", "<<obj->getMaterial().getSpc().getGreenC()<<", "<<obj->getMaterial().getSpc().getBlueC()<<" }"
-      << " }"<<endl;
-    os<< "float {" <<obj->getMaterial().getShininess()  << "}"<<endl
-      << "}"<<endl<<"}"<<endl;
+    os << "setMaterial"<<endl<<"{"<<endl
+       << "ref { $" << _save_palette->getName(_save_palette->find(obj->getMaterial())) << " }"<<endl
+       << "}"<<endl;
     os << "}" << endl<<endl;
 
 }
 
-void Scenario::savePT(std::ofstream &os, const GMlib::PTorus<float> *obj) {
+void Scenario::savePT(std::ostream &os, const GMlib::PTorus<float> *obj) {
 
     using namespace std;
 
@@ -707,10 +1393,10 @@ void Scenario::savePT(std::ofstream &os, const GMlib::PTorus<float> *obj) {
        <<"enableDefaultVisualize { bool {" << ( obj->getVisualizers()(0)?"true":"false")<<"} "
       << " }"<<endl<<endl;
     os <<"replot {"<<endl
-      << "int {" <<obj->getSamplesU()<<"}"<<endl
-      << "int {" <<obj->getSamplesV()<<"}"<<endl
-      << "int {" <<obj->getDerivativesU()<<"}"<<endl
-      << "int {" <<obj->getDerivativesV()<<"}"<<endl;
+      << "int32 {" <<obj->getSamplesU()<<"}"<<endl
+      << "int32 {" <<obj->getSamplesV()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesU()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesV()<<"}"<<endl;
     os << "}" <<endl<<"}"<<endl<<endl;
 
 
@@ -724,7 +1410,7 @@ void Scenario::savePT(std::ofstream &os, const GMlib::PTorus<float> *obj) {
     os << "}" <<endl<<endl;
 }
 
-void Scenario::savePS(std::ofstream &os, const GMlib::PSphere<float> *obj) {
+void Scenario::savePS(std::ostream &os, const GMlib::PSphere<float> *obj) {
 
     using namespace std;
 
@@ -732,10 +1418,10 @@ void Scenario::savePS(std::ofstream &os, const GMlib::PSphere<float> *obj) {
        <<"enableDefaultVisualize { bool {" << ( obj->getVisualizers()(0)?"true":"false")<<"} "
       << " }"<<endl<<endl;
     os <<"replot {"<<endl
-      << "int {" <<obj->getSamplesU()<<"}"<<endl
-      << "int {" <<obj->getSamplesV()<<"}"<<endl
-      << "int {" <<obj->getDerivativesU()<<"}"<<endl
-      << "int {" <<obj->getDerivativesV()<<"}"<<endl;
+      << "int32 {" <<obj->getSamplesU()<<"}"<<endl
+      << "int32 {" <<obj->getSamplesV()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesU()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesV()<<"}"<<endl;
     os << "}" <<endl<<"}"<<endl<<endl;
 
 
@@ -747,7 +1433,7 @@ void Scenario::savePS(std::ofstream &os, const GMlib::PSphere<float> *obj) {
     os << "}" <<endl<<endl;
 }
 
-void Scenario::savePC(std::ofstream &os, const GMlib::PCylinder<float> *obj) {
+void Scenario::savePC(std::ostream &os, const GMlib::PCylinder<float> *obj) {
 
     using namespace std;
 
@@ -755,10 +1441,10 @@ void Scenario::savePC(std::ofstream &os, const GMlib::PCylinder<float> *obj) {
        <<"enableDefaultVisualize { bool {" << ( obj->getVisualizers()(0)?"true":"false")<<"} "
       << " }"<<endl<<endl;
     os <<"replot {"<<endl
-      << "int {" <<obj->getSamplesU()<<"}"<<endl
-      << "int {" <<obj->getSamplesV()<<"}"<<endl
-      << "int {" <<obj->getDerivativesU()<<"}"<<endl
-      << "int {" <<obj->getDerivativesV()<<"}"<<endl;
+      << "int32 {" <<obj->getSamplesU()<<"}"<<endl
+      << "int32 {" <<obj->getSamplesV()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesU()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesV()<<"}"<<endl;
     os << "}" <<endl<<"}"<<endl<<endl;
 
 
@@ -771,11 +1457,9 @@ void Scenario::savePC(std::ofstream &os, const GMlib::PCylinder<float> *obj) {
       << "float {" <<obj->getRadiusY()<<"}"<<endl
       << "float {" <<obj->getHeight()<<"}"<<endl;
     os << "}" <<endl<<"}"<<endl<<endl;
-
-    os << "}" <<endl<<endl;
 }
 
-void Scenario::savePP(std::ofstream &os, const GMlib::PPlane<float> *obj) {
+void Scenario::savePP(std::ostream &os, const GMlib::PPlane<float> *obj) {
 
     using namespace std;
 
@@ -783,17 +1467,28 @@ void Scenario::savePP(std::ofstream &os, const GMlib::PPlane<float> *obj) {
        <<"enableDefaultVisualize { bool {" << ( obj->getVisualizers()(0)?"true":"false")<<"} "
       << " }"<<endl<<endl;
     os <<"replot {"<<endl
-      << "int {" <<obj->getSamplesU()<<"}"<<endl
-      << "int {" <<obj->getSamplesV()<<"}"<<endl
-      << "int {" <<obj->getDerivativesU()<<"}"<<endl
-      << "int {" <<obj->getDerivativesV()<<"}"<<endl;
+      << "int32 {" <<obj->getSamplesU()<<"}"<<endl
+      << "int32 {" <<obj->getSamplesV()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesU()<<"}"<<endl
+      << "int32 {" <<obj->getDerivativesV()<<"}"<<endl;
     os << "}" <<endl<<"}"<<endl<<endl;
 
 
     os << "PPlaneData" << std::endl
        << "{" << endl;
 
-    //os << "setRadius{ float {"<<  obj->getRadius()<< "} }"<<endl;
+    // Point and the two spanning vectors, in constructor order.
+    // The plane is parametrized over [0,1]x[0,1], so they are the position and first derivatives at the origin.
+    const auto& p = const_cast<GMlib::PPlane<float>*>(obj)->evaluate(obj->getParStartU(),obj->getParStartV(),1,1);
+    os << "Point {"
+       << " float[3] { {" << p[0][0](0)<<", "<<p[0][0](1)<<", "<<p[0][0](2)<<"} }"
+       << " }"<<endl;
+    os << "Vector {"
+       << " float[3] { {" << p[1][0](0)<<", "<<p[1][0](1)<<", "<<p[1][0](2)<<"} }"
+       << " }"<<endl;
+    os << "Vector {"
+       << " float[3] { {" << p[0][1](0)<<", "<<p[0][1](1)<<", "<<p[0][1](2)<<"} }"
+       << " }"<<endl;
 
     os << "}" <<endl<<endl;
 }
@@ -814,25 +1509,29 @@ void Scenario::replotLow()
         {
             //qDebug() << c;
             GMlib::PTorus<float> *objtorus = dynamic_cast<GMlib::PTorus<float>*>(obj);
-            objtorus->replot(4, 4, 1, 1);
+            _lod->setManual(objtorus);
+            replot(objtorus, 4, 4, 1, 1);
         }
         else if (str == "PSphere")
         {
             //qDebug() << c;
             GMlib::PSphere<float> *objsphere = dynamic_cast<GMlib::PSphere<float>*>(obj);
-            objsphere->replot(7, 7, 1, 1);
+            _lod->setManual(objsphere);
+            replot(objsphere, 7, 7, 1, 1);
         }
         else if (str == "PPlane")
         {
             //qDebug() << c;
             GMlib::PPlane<float> *objplane = dynamic_cast<GMlib::PPlane<float>*>(obj);
-            objplane->replot(1, 1, 1, 1);
+            _lod->setManual(objplane);
+            replot(objplane, 1, 1, 1, 1);
         }
         else if (str == "PCylinder")
         {
             //qDebug() << c;
             GMlib::PCylinder<float> *objcylinder = dynamic_cast<GMlib::PCylinder<float>*>(obj);
-            objcylinder->replot(5, 5, 1, 1);
+            _lod->setManual(objcylinder);
+            replot(objcylinder, 5, 5, 1, 1);
         }
     }
 
@@ -852,145 +1551,188 @@ void Scenario::replotHigh()
         {
             //qDebug() << c;
             GMlib::PTorus<float> *objtorus = dynamic_cast<GMlib::PTorus<float>*>(obj);
-            objtorus->replot(200, 200, 1, 1);
+            _lod->setManual(objtorus);
+            replot(objtorus, 201, 201, 1, 1);
         }
         else if (str == "PSphere")
         {
             //qDebug() << c;
             GMlib::PSphere<float> *objsphere = dynamic_cast<GMlib::PSphere<float>*>(obj);
-            objsphere->replot(200, 200, 1, 1);
+            _lod->setManual(objsphere);
+            replot(objsphere, 201, 201, 1, 1);
         }
         else if (str == "PPlane")
         {
             //qDebug() << c;
             GMlib::PPlane<float> *objplane = dynamic_cast<GMlib::PPlane<float>*>(obj);
-            objplane->replot(10, 10, 1, 1);
+            _lod->setManual(objplane);
+            replot(objplane, 10, 10, 1, 1);
         }
         else if (str == "PCylinder")
         {
             //qDebug() << c;
             GMlib::PCylinder<float> *objcylinder = dynamic_cast<GMlib::PCylinder<float>*>(obj);
-            objcylinder->replot(200, 200, 1, 1);
+            _lod->setManual(objcylinder);
+            replot(objcylinder, 201, 201, 1, 1);
         }
     }
 
 }
 
-void Scenario::load() {
+void Scenario::toggleAutomaticLod() {
 
-    qDebug() << "Open scene...";
-    //SimStateLock a(*this);
-    stopSimulation();
+    _lod->setEnabled(!_lod->isEnabled());
+    qDebug() << "Automatic level of detail" << (_lod->isEnabled() ? "on" : "off");
+}
 
-    auto filename = std::string("gmlib_save.openddl");
-    auto is = std::ifstream(filename,std::ios_base::in);
+void Scenario::toggleProgressiveReplot() {
 
-    if(!is.is_open())
-    {
-        std::cerr << "Unable to open " << filename << " for reading..."
-                  << std::endl;
+    _tessellation->setProgressive(!_tessellation->isProgressive());
+    qDebug() << "Progressive replot" << (_tessellation->isProgressive() ? "on" : "off");
+}
+
+void Scenario::togglePackedMeshes() {
+
+    _mesh_cache->setPacked(!_mesh_cache->isPacked());
+    qDebug() << "Packed meshes" << (_mesh_cache->isPacked() ? "on" : "off");
+}
+
+void Scenario::toggleInstancing() {
+
+    _mesh_cache->setInstanced(!_mesh_cache->isInstanced());
+    qDebug() << "Instancing" << (_mesh_cache->isInstanced() ? "on" : "off");
+}
+
+void Scenario::setStatic(GMlib::SceneObject *obj, bool is_static) {
+
+    auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj);
+    if(!surface || is_static == _static_batcher->contains(surface))
+        return;
+
+    // Back to drawing itself, with the sampling it had in the batch
+    if(!is_static) {
+        _static_batcher->remove(surface);
+        replot(surface,surface->getSamplesU(),surface->getSamplesV(),surface->getDerivativesU(),surface->getDerivativesV());
         return;
     }
 
-    is.seekg( 0, std::ios_base::end ); //Sets the position of the next character to be extracted from the input stream
-    auto buff_length = is.tellg(); //Get position in input sequence - buffer length
-    is.seekg( 0, std::ios_base::beg );
+    // Off a shared mesh first, so that the surface draws its own default visualizer
+    _mesh_cache->detach(surface);
+    _tessellation->forget(surface);
+    if(!_static_batcher->add(surface))
+        replot(surface,surface->getSamplesU(),surface->getSamplesV(),surface->getDerivativesU(),surface->getDerivativesV());
+}
 
-    std::vector<char> buffer(buff_length);
-    is.read(buffer.data(),buff_length);
+void Scenario::toggleStaticSelected() {
 
+    const GMlib::Array<GMlib::SceneObject*> &selected_objects = _scene->getSelectedObjects();
+    for( int i = 0; i < selected_objects.getSize(); i++ )
+        setStatic(selected_objects(i),!_static_batcher->contains(selected_objects(i)));
 
-    std::cout << "Buffer length: " << buff_length << std::endl;
+    _static_batcher->update();
+    const auto& stats = _static_batcher->getStats();
+    qDebug() << "Static surfaces:" << stats.members << "in" << stats.batches << "batches," << stats.vertices << "vertices";
+}
 
-    GMlibSceneLoaderDataDescription gsdd;
+void Scenario::replot(GMlib::PSurf<float,3> *surface, int m1, int m2, int d1, int d2) {
 
-    ODDL::DataResult result = gsdd.ProcessText(buffer.data());
+    // Sampling asked for by hand is kept within what is left of the tessellation budget
+    _lod->fitToBudget(surface,m1,m2);
 
-    //for error
-    if(result != ODDL::kDataOkay)
-    {
-        auto res_to_char = [](auto nr, const ODDL::DataResult& result)
-        {
-            return char(((0xff << (8*nr)) & result ) >> (8*nr));
-        };
+    // Only the derivatives the visualizers draw from are evaluated
+    auto e1 = d1, e2 = d2;
+    SurfaceSampler::neededDerivatives(surface,e1,e2);
 
-        auto res_to_str = [&res_to_char](const ODDL::DataResult& result)
-        {
-            return std::string() + res_to_char(3,result) + res_to_char(2,result) + res_to_char(1,result) + res_to_char(0,result);
-        };
+    // Static surfaces are sampled into their batch before the next frame,
+    // with the first derivatives for the normals
+    if(_static_batcher->replot(surface,m1,m2,d1,d2)) {
+        _replot_stats->record(surface,m1,m2,d1,d2,1,1,surface);
+        return;
+    }
 
-        std::cerr << "!Data result not OK: " << res_to_str(result) << " (" << result << ")" << std::endl;
+    // Identical surfaces share one tessellation, sampled in the background
+    if(_mesh_cache->replot(surface,m1,m2,e1,e2)) {
+        _replot_stats->record(surface,m1,m2,d1,d2,e1,e2,_mesh_cache->getMesh(surface));
         return;
     }
 
-    std::cout << "Data result OK" << std::endl;
+    // Known shapes are sampled in the background, the rest is replotted in place
+    _mesh_cache->detach(surface);
+    _replot_stats->record(surface,m1,m2,d1,d2,e1,e2,surface);
+    if(_tessellation->submit(surface,m1,m2,e1,e2))
+        return;
 
-    auto root = gsdd.GetRootStructure();
-    auto children = root->GetSubnodeCount();
-    auto node = root->GetFirstSubnode();
-    bool done = false;
+    _tessellation->forget(surface);
 
-    while (!done)
-    {
-        std::shared_ptr<GMlib::SceneObject> objectToQueue = nullptr;
+    auto started = std::chrono::steady_clock::now();
+    surface->replot(m1,m2,e1,e2);
+    std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - started;
+    _replot_stats->tessellated(surface,m1,m2,0,elapsed.count(),0.0);
+}
 
-        for( auto i = 0; i < children; i++)
-        {
-            if( node->GetStructureType() == int( GMStructTypes::PTorus))
-            {
-                std::shared_ptr<GMlib::PTorus<float>> torus = std::make_shared<GMlib::PTorus<float>>();
-                torus->toggleDefaultVisualizer();
-                torus->replot(200,200,1,1);
-                objectToQueue = torus;
-            }
-            else if( node->GetStructureType() == int( GMStructTypes::PSphere))
-            {
-                std::shared_ptr<GMlib::PSphere<float>> sphere = std::make_shared<GMlib::PSphere<float>>();
-                sphere->toggleDefaultVisualizer();
-                sphere->replot(50, 50, 10, 10);
-                objectToQueue = sphere;
-            }
-            else if( node->GetStructureType() == int( GMStructTypes::PCylinder))
-            {
-                std::shared_ptr<GMlib::PCylinder<float>> cylinder = std::make_shared<GMlib::PCylinder<float>>();
-                cylinder->toggleDefaultVisualizer();
-                cylinder->replot(50, 50, 10, 10);
-                objectToQueue = cylinder;
-            }
+void Scenario::printReplotStats() const {
 
-            else if( node->GetStructureType() == int( GMStructTypes::GMlibVersion ) )
-            {
-                if( node->GetFirstSubnode() )
-                {
-                    auto child = node->GetFirstSubnode();
+    _replot_stats->print(std::cout);
+}
 
-                    if( child->GetStructureType() == int( ODDL::kDataInt32))
-                    {
+std::vector<ReplotStats::Row> Scenario::getReplotRows() const { return _replot_stats->getRows(); }
 
-                        auto data = static_cast<ODDL::DataStructure<ODDL::Int32DataType>*>(child);
-                        std::cout << data << std::endl;
+ReplotStats::Totals Scenario::getReplotTotals() const { return _replot_stats->getTotals(); }
 
-                        if( data->GetDataElement(0) == GM_VERSION)
-                        {
-                            std::cout << "Valid GMlibVersion" << std::endl;
-                        }
-                        else std::cout << "Non-valid GMlibVersion" << std::endl;
-                    }
-                    else std::cout << "Non-valid GMlibVersion" << std::endl;
-                }
-            }
-        }
+bool Scenario::writeReplotStats(const std::string& path) const {
 
-        _sceneObjectQueue.push(objectToQueue);
-        if(!node)
-        {
-            if( node->Next() )
-            {
-                node = node->Next();
-            }
-        }
-        else done = true;
+    std::ofstream os(path);
+    if(!os)
+        return false;
+
+    _replot_stats->writeCsv(os);
+    qDebug() << "Replot stats written to" << QString::fromStdString(path);
+    return bool(os);
+}
+
+void Scenario::setMeshCacheBudget(size_t bytes) { _mesh_cache->setBudget(bytes); }
+
+void Scenario::finishTessellation() {
+
+    while(_tessellation->getPending() > 0) {
+        if(!_tessellation->upload())
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
     }
+}
+
+void Scenario::setTessellationBudget(size_t vertices, size_t triangles) { _lod->setBudget(vertices,triangles); }
+
+size_t Scenario::getVertices() const { return _vertices; }
+
+size_t Scenario::getTriangles() const { return _triangles; }
+
+size_t Scenario::getVertexBudget() const { return _vertex_budget; }
+
+size_t Scenario::getTriangleBudget() const { return _triangle_budget; }
+
+void Scenario::load() {
+
+    qDebug() << "Open scene...";
+    //SimStateLock a(*this);
+    stopSimulation();
+
+    auto gsdd = parseSceneFile(_scene_path);
+    if(!gsdd)
+    {
+        startSimulation();
+        return;
+    }
+
+    // Build the objects; shared materials are resolved once by the builder, shared tessellations by the mesh cache.
+    // Static surfaces are not sampled yet, so they go straight into the batcher and are sampled there.
+    GMlibSceneBuilder builder(*gsdd);
+    builder.setReplot( [this](GMlib::PSurf<float,3>* s, int m1, int m2, int d1, int d2) { replot(s,m1,m2,d1,d2); } );
+    builder.setStatic( [this](GMlib::PSurf<float,3>* s) { _static_batcher->add(s); } );
+    for( auto obj : builder.build() )
+        _sceneObjectQueue.push(obj);
+
+    // Shards listed in a manifest are only registered; they are read as the camera gets near
+    registerShards(gsdd->GetRootStructure(),directoryOf(_scene_path));
     //end of load
 
     //scene insert
@@ -999,7 +1741,7 @@ void Scenario::load() {
         auto obj = _sceneObjectQueue.front();
         if(obj)
         {
-            _scene->insert(obj.get());
+            _scene->insert(obj);
         }
         _sceneObjectQueue.pop();
     }
@@ -1007,6 +1749,283 @@ void Scenario::load() {
     startSimulation();
 }
 
+void Scenario::setShardCellSize(float size) { _shard_cell_size = size; }
+
+void Scenario::setShardDistances(float load, float unload) {
+
+    // Unloading further out than loading keeps a shard on the border from going in and out every frame
+    _shard_load_distance   = load;
+    _shard_unload_distance = std::max(load,unload);
+}
+
+void Scenario::expandShardGroup(const std::string &group, bool expanded) {
+
+    if(expanded) _expanded_groups.insert(group);
+    else         _expanded_groups.erase(group);
+}
+
+void Scenario::registerShards(const ODDL::Structure *root, const std::string &dir) {
+
+    for( auto sub = root->GetFirstSubnode(); sub; sub = sub->Next() ) {
+
+        if(sub->GetStructureType() != int( GMStructTypes::Shard )) continue;
+
+        // string {file} string {group} Point {center} float {radius}
+        auto shard = std::make_unique<SceneShard>();
+        auto strings = 0;
+        for( auto data = sub->GetFirstSubnode(); data; data = data->Next() ) {
+
+            if(data->GetStructureType() == ODDL::kDataString) {
+
+                auto str = static_cast<const ODDL::DataStructure<ODDL::StringDataType>*>(data);
+                if(str->GetDataElementCount() < 1) continue;
+
+                if(strings++ == 0) shard->file  = static_cast<const char*>(str->GetDataElement(0));
+                else               shard->group = static_cast<const char*>(str->GetDataElement(0));
+            }
+            else if(data->GetStructureType() == ODDL::kDataFloat) {
+
+                auto f = static_cast<const ODDL::DataStructure<ODDL::FloatDataType>*>(data);
+                if(f->GetDataElementCount() > 0) shard->radius = f->GetDataElement(0);
+            }
+            else if(data->GetStructureType() == int( GMStructTypes::Point ) && data->GetFirstSubnode()) {
+
+                auto f = static_cast<const ODDL::DataStructure<ODDL::FloatDataType>*>(data->GetFirstSubnode());
+                if(f->GetStructureType() == ODDL::kDataFloat)
+                    for( auto i = 0; i < 3 && i < f->GetDataElementCount(); ++i )
+                        shard->center[i] = f->GetDataElement(i);
+            }
+        }
+
+        if(shard->file.empty()) {
+            std::cerr << "Shard without a file name" << std::endl;
+            continue;
+        }
+        shard->path = shard->file[0] == '/' ? shard->file : dir + shard->file;
+
+        // The same manifest may be loaded twice
+        auto known = std::any_of( _shards.begin(), _shards.end(),
+                                  [&shard](const auto& s) { return s->path == shard->path; } );
+        if(!known)
+            _shards.push_back(std::move(shard));
+    }
+}
+
+void Scenario::updateShards() {
+
+    if(_shards.empty() || !_camera) return;
+
+    collectShards();
+
+    // Distances only need to be looked at every few frames
+    if(_shard_frame++ % 8) return;
+
+    checkShards();
+}
+
+void Scenario::finishShards() {
+
+    if(_shards.empty() || !_camera) return;
+
+    collectShards();
+    checkShards();
+
+    for( auto& shard : _shards ) {
+        if(shard->pending.valid()) shard->pending.wait();
+        if(shard->saving.valid())  shard->saving.wait();
+    }
+
+    collectShards();
+}
+
+void Scenario::collectShards() {
+
+    // Shards read in the background are built here, where the GL context is current
+    for( auto& shard : _shards ) {
+
+        if(!shard->pending.valid() ||
+           shard->pending.wait_for(std::chrono::seconds(0)) != std::future_status::ready)
+            continue;
+
+        auto description = shard->pending.get();
+        if(description) buildShard(*shard,*description);
+        else            shard->failed = true;
+    }
+
+    // So are the shards written back
+    for( auto& shard : _shards )
+        if(shard->saving.valid() &&
+           shard->saving.wait_for(std::chrono::seconds(0)) == std::future_status::ready)
+            finishUnload(*shard);
+}
+
+void Scenario::checkShards() {
+
+    const auto& cam = _camera->getPos();
+    for( auto& shard : _shards ) {
+
+        if(shard->failed || shard->pending.valid() || shard->saving.valid()) continue;
+
+        auto distance = (cam - shard->center).getLength() - shard->radius;
+        auto expanded = _expanded_groups.count(shard->group) > 0;
+
+        if(!shard->loaded && (expanded || distance < _shard_load_distance))
+            loadShard(*shard);
+        else if(shard->loaded && !expanded && distance > _shard_unload_distance)
+            unloadShard(*shard);
+    }
+}
+
+void Scenario::loadShard(SceneShard &shard) {
+
+    auto path = shard.path;
+    shard.pending = ThreadPool::instance().submit( [path]() { return parseSceneFile(path); } );
+}
+
+void Scenario::buildShard(SceneShard &shard, const GMlibSceneLoaderDataDescription &description) {
+
+    GMlibSceneBuilder builder(description);
+    builder.setReplot( [this](GMlib::PSurf<float,3>* s, int m1, int m2, int d1, int d2) { replot(s,m1,m2,d1,d2); } );
+    builder.setStatic( [this](GMlib::PSurf<float,3>* s) { _static_batcher->add(s); } );
+    for( auto obj : builder.build() ) {
+
+        _shard_of[obj] = &shard;
+        _scene->insert(obj);
+    }
+
+    shard.loaded = true;
+}
+
+void Scenario::unloadShard(SceneShard &shard) {
+
+    // Edits made while the shard was loaded are written back first. The objects leave the scene and
+    // the caches at once, so nothing else touches them while they are written off the render thread;
+    // they are deleted once the file is written, and put back if it could not be.
+    auto objects = shardObjects(&shard);
+    updateShardBounds(shard,objects);
+
+    shard.unloading.clear();
+    shard.unloading_static.clear();
+    for( auto obj : objects ) {
+
+        auto so = const_cast<GMlib::SceneObject*>(obj);
+        collectStatic(so,shard.unloading_static);
+        releaseObject(so);
+        shard.unloading.push_back(so);
+    }
+    shard.loaded = false;
+
+    auto path    = shard.path;
+    auto statics = shard.unloading_static;
+    shard.saving = std::async(std::launch::async,[this,path,objects,statics]() {
+        return saveFile(path,objects,std::string(),statics);
+    });
+}
+
+void Scenario::finishUnload(SceneShard &shard) {
+
+    if(shard.saving.get()) {
+
+        for( auto obj : shard.unloading )
+            delete obj;
+    }
+    else {
+
+        for( auto obj : shard.unloading ) {
+            _shard_of[obj] = &shard;
+            _scene->insert(obj);
+            reattachObject(obj,shard.unloading_static);
+        }
+        shard.loaded = true;
+    }
+
+    shard.unloading.clear();
+    shard.unloading_static.clear();
+}
+
+void Scenario::collectStatic(const GMlib::SceneObject *obj, std::set<const GMlib::SceneObject *> &statics) const {
+
+    const auto& children = obj->getChildren();
+    for(auto i = 0; i < children.getSize(); ++i )
+        collectStatic(children(i),statics);
+
+    if(_static_batcher->contains(obj))
+        statics.insert(obj);
+}
+
+void Scenario::reattachObject(GMlib::SceneObject *obj, const std::set<const GMlib::SceneObject *> &statics) {
+
+    const auto& children = obj->getChildren();
+    for(auto i = 0; i < children.getSize(); ++i )
+        reattachObject(children(i),statics);
+
+    // Into the caches again, with the sampling the surface had
+    auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj);
+    if(!surface)
+        return;
+
+    if(statics.count(surface))
+        setStatic(surface,true);
+    else
+        replot(surface,surface->getSamplesU(),surface->getSamplesV(),surface->getDerivativesU(),surface->getDerivativesV());
+}
+
+std::vector<const GMlib::SceneObject*> Scenario::shardObjects(const SceneShard *shard) const {
+
+    std::vector<const GMlib::SceneObject*> objects;
+
+    auto &scene = *_scene;
+    for( auto i = 0; i < scene.getSize(); ++i ) {
+
+        auto owner = _shard_of.find(scene[i]);
+        if(owner != _shard_of.end() && owner->second == shard)
+            objects.push_back(scene[i]);
+    }
+
+    return objects;
+}
+
+void Scenario::updateShardBounds(SceneShard &shard, const std::vector<const GMlib::SceneObject *> &objects) const {
+
+    if(objects.empty()) return;
+
+    auto sphereOf = [](const GMlib::SceneObject* obj) {
+        auto sphere = obj->getSurroundingSphere();
+        return sphere.isValid() ? sphere : GMlib::Sphere<float,3>(obj->getPos(),0.0f);
+    };
+
+    GMlib::Point<float,3> center(0.0f);
+    for( auto obj : objects )
+        center += sphereOf(obj).getPos();
+    center /= float(objects.size());
+
+    auto radius = 0.0f;
+    for( auto obj : objects ) {
+        auto sphere = sphereOf(obj);
+        radius = std::max( radius, (sphere.getPos() - center).getLength() + sphere.getRadius() );
+    }
+
+    shard.center = center;
+    shard.radius = radius;
+}
+
+void Scenario::saveShardTable(std::ostream &os) const {
+
+    using namespace std;
+
+    for( const auto& shard : _shards ) {
+
+        os << "Shard"<<endl<<"{"<<endl
+           << "string { " << quoted(shard->file) << " }"<<endl
+           << "string { " << quoted(shard->group) << " }"<<endl
+           << "Point { float[3] { {"
+           << shard->center(0) << ", " << shard->center(1) << ", " << shard->center(2)
+           << "} } }"<<endl
+           << "float { " << shard->radius << " }"<<endl
+           << "}"<<endl<<endl;
+    }
+}
+
 //void Scenario::load() {
 
 //    qDebug() << "Open scene...";
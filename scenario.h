@@ -5,6 +5,24 @@
 // local
 class TestTorus;
 class Vector;
+class MaterialPalette;
+class LodManager;
+class TessellationQueue;
+class MeshCache;
+class MeshExporter;
+class SimulationThread;
+class ReplayBenchmark;
+class SceneBvh;
+class OcclusionCuller;
+class StaticBatcher;
+struct SceneShard;
+class GMlibSceneLoaderDataDescription;
+
+// openddl
+namespace ODDL {
+
+class Structure;
+}
 
 
 // gmlib
@@ -19,6 +37,7 @@ class DefaultSelectRenderer;
 class RenderTarget;
 class SceneObject;
 
+template <typename T, int n> class PSurf;
 template <typename T> class PTorus;
 template <typename T> class PSphere;
 template <typename T> class PCylinder;
@@ -30,6 +49,10 @@ class Angle;
 // **************************************************************
 }
 
+// local
+#include "scenefile.h"
+#include "tessellation/replotstats.h"
+
 //
 // qt
 #include <QObject>
@@ -39,9 +62,16 @@ class Angle;
 #include <QKeyEvent>
 
 // stl
+#include <atomic>
+#include <future>
 #include <iostream>
+#include <map>
 #include <memory>
+#include <mutex>
 #include <queue>
+#include <set>
+#include <string>
+#include <vector>
 
 
 class Scenario: public QObject {
@@ -55,15 +85,50 @@ public:
     void                                              deinitialize();
     virtual void                                      initializeScenario();
 
+    // The simulation runs on a thread of its own in fixed steps, and is shown interpolated
     void                                              startSimulation();
     void                                              stopSimulation();
     void                                              toggleSimulation();
+    void                                              setSimulationTimestep( double seconds );
+
+    // Held while the scene is edited from the render thread, away from the simulation
+    std::unique_lock<std::mutex>                      lockScene();
+
+    // Render on demand: a frame is drawn when input arrives, the camera or an object changes,
+    // meshes are on their way, or the simulation animates something. Otherwise every frame
+    // schedules the next one
+    void                                              setRenderOnDemand( bool on );
+    bool                                              isRenderOnDemand() const;
+    void                                              toggleRenderOnDemand();
+    void                                              requestRedraw();    // any thread
+    bool                                              needsRedraw() const;
+
+    // Replays a benchmark script, see ReplayBenchmark, one step a frame with the simulation
+    // stopped and render on demand off; the results go to json when the last frame is done
+    bool                                              startReplay( const std::string& script, const std::string& json,
+                                                                   const std::string& mode );
+    bool                                              isReplaying() const;
+
+    // Objects off the view frustum, found with a bounding volume hierarchy, are left out of the
+    // render and select passes. Counts are of the objects at the top of the scene, last frame
+    void                                              setFrustumCulling( bool on );
+    void                                              toggleFrustumCulling();
+    size_t                                            getDrawnObjects() const;
+    size_t                                            getCulledObjects() const;
+
+    // Of what is left, objects behind the largest planes and spheres, as found on a CPU depth buffer
+    void                                              setOcclusionCulling( bool on );
+    void                                              toggleOcclusionCulling();
+    size_t                                            getOccludedObjects() const;
 
     void                                              render( const QRect& viewport, GMlib::RenderTarget& target );
     void                                              prepare();
 
     // **************************************************************
 
+    // Camera at pos, looking along dir, in the scene's coordinates
+    void                                              setCameraFrame(const GMlib::Point<float,3>& pos, const GMlib::Vector<float,3>& dir,
+                                                                     const GMlib::Vector<float,3>& up);
     void                                              camFly(char direction);
     void                                              zoomCameraW(const float &zoom_var);
     void                                              switchCamera(int n);
@@ -85,21 +150,76 @@ public:
     void                                              deleteObject();
     void                                              replotLow();
     void                                              replotHigh();
+    void                                              toggleAutomaticLod();
+    void                                              toggleProgressiveReplot();
+    void                                              togglePackedMeshes();
+    // Surfaces sharing a packed mesh drawn with one call
+    void                                              toggleInstancing();
+
+    // Static surfaces are drawn merged with the others of their material, one call for them all
+    void                                              setStatic( GMlib::SceneObject* obj, bool is_static );
+    void                                              toggleStaticSelected();
+
+    // Replots in the background where possible; the old mesh is shown until the new one is uploaded
+    void                                              replot( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 );
+    void                                              setMeshCacheBudget( size_t bytes );
+
+    // Render thread: waits for the background replots and uploads them, so that the next frame
+    // shows every surface as asked for
+    void                                              finishTessellation();
+
+    // Vertices and triangles of all surfaces, against the budget; as of the last frame rendered
+    void                                              setTessellationBudget( size_t vertices, size_t triangles );
+    size_t                                            getVertices() const;
+    size_t                                            getTriangles() const;
+    size_t                                            getVertexBudget() const;
+    size_t                                            getTriangleBudget() const;
+    void                                              printReplotStats() const;
+
+    // Per object tessellation cost; safe to call from the ui thread
+    std::vector<ReplotStats::Row>                     getReplotRows() const;
+    ReplotStats::Totals                               getReplotTotals() const;
+    bool                                              writeReplotStats( const std::string& path ) const;
 
     void                                               save();
     void                                               load();
+    void                                               setParallelSave(bool parallel);
+    void                                               setScenePath(const std::string& path);
+    const std::string&                                 scenePath() const;
+
+    // Tessellated visible surfaces, written in the background; STL, OBJ or glTF by the extension.
+    // Without an export path, next to the scene file as .glb
+    void                                               exportMeshes();
+    void                                               setExportPath(const std::string& path);
+    void                                               setExportSamples(int samples);
+
+    // Sharded scenes
+    void                                               setShardCellSize(float size);
+    void                                               setShardDistances(float load, float unload);
+    void                                               expandShardGroup(const std::string& group, bool expanded = true);
+    void                                               updateShards();
+
+    // Render thread: looks at the distances of the shards now, and waits for the shards it
+    // reads or writes, so that the next frame does not depend on how fast the disk is
+    void                                               finishShards();
 
     GMlib::Point<int, 2> convertQtPointToGMlibViewPoint( const QPoint& pos);
 
+    // Render thread: from the points of mouse positions to the pixels of the viewport, which
+    // the FBO may draw at a lower resolution
+    void                                              setInputScale( float x, float y );
+
     // **************************************************************
 
 
-protected:
-    void                                              timerEvent(QTimerEvent *e) override;
+signals:
+    void                                              signRedrawRequested();
+    void                                              signReplayFinished();
 
 private:
     std::shared_ptr<GMlib::Scene>                     _scene;
-    int                                               _timer_id;
+    std::unique_ptr<SimulationThread>                 _simulation;
+    double                                            _simulation_timestep {1.0 / 60.0};
 
     //select_renderer
     std::shared_ptr<GMlib::DefaultSelectRenderer>     _select_renderer {nullptr};
@@ -107,21 +227,99 @@ private:
     std::shared_ptr<GMlib::DefaultRenderer>           _renderer { nullptr };
     std::shared_ptr<GMlib::Camera>                    _camera   { nullptr };
     QRect                                             _viewport { QRect(0,0,1,1) };
+    float                                             _input_scale_x {1.0f};
+    float                                             _input_scale_y {1.0f};
 
     std::shared_ptr<GMlib::PointLight>                _light;
     std::shared_ptr<TestTorus>                        _testtorus;
+    std::unique_ptr<LodManager>                       _lod;
+    std::unique_ptr<TessellationQueue>                _tessellation;
+    std::unique_ptr<MeshCache>                        _mesh_cache;
+    std::unique_ptr<StaticBatcher>                    _static_batcher;
+    std::unique_ptr<ReplotStats>                      _replot_stats;
+    std::unique_ptr<SceneBvh>                         _bvh;
+    std::atomic<bool>                                 _frustum_culling {true};
+    std::atomic<size_t>                               _drawn_objects {0};
+    std::atomic<size_t>                               _culled_objects {0};
+    std::unique_ptr<OcclusionCuller>                  _occlusion;
+    std::atomic<bool>                                 _occlusion_culling {true};
+    std::atomic<size_t>                               _occluded_objects {0};
+    std::atomic<size_t>                               _vertices {0};
+    std::atomic<size_t>                               _triangles {0};
+    std::atomic<size_t>                               _vertex_budget {0};
+    std::atomic<size_t>                               _triangle_budget {0};
+    std::atomic<bool>                                 _render_on_demand {true};
+    std::atomic<bool>                                 _redraw {true};
+    std::atomic<bool>                                 _interpolating {false};
+
+    std::unique_ptr<ReplayBenchmark>                  _replay;
+    std::string                                       _replay_json;
+    std::string                                       _replay_mode;
+    bool                                              _replay_on_demand {true};
+    std::atomic<bool>                                 _replaying {false};
+
+    void                                              finishReplay();
+    std::vector<GMlib::SceneObject*>                  cullObjects( bool count );
+
+    // Drops obj and its children from the caches and the level of detail, and removes obj from the scene
+    void                                              releaseObject( GMlib::SceneObject* obj );
+    void                                              forgetObject( GMlib::SceneObject* obj );
 
     static std::unique_ptr<Scenario>                  _instance;
 
 
     // **************************************************************
-    std::queue<std::shared_ptr<GMlib::SceneObject>>   _sceneObjectQueue;
-    void                                              save( std::ofstream& os, const GMlib::SceneObject* obj);
-    void                                              saveSO( std::ofstream& os, const GMlib::SceneObject* obj);
-    void                                              savePT( std::ofstream& os, const GMlib::PTorus<float>* obj);
-    void                                              savePS(std::ofstream &os, const GMlib::PSphere<float> *obj);
-    void                                              savePC(std::ofstream &os, const GMlib::PCylinder<float> *obj);
-    void                                              savePP(std::ofstream &os, const GMlib::PPlane<float> *obj);
+    std::queue<GMlib::SceneObject*>                   _sceneObjectQueue;
+    bool                                              _parallel_save {true};
+    std::string                                       _scene_path {"gmlib_save.openddl"};
+    std::unique_ptr<MaterialPalette>                  _save_palette;
+    std::string                                       _export_path;
+    int                                               _export_samples {101};
+    std::future<void>                                 _export;
+    std::mutex                                        _save_mutex;
+    std::vector<std::string>                          _save_prototypes;
+    std::map<std::string,int>                         _save_prototype_ids;
+    std::map<const GMlib::SceneObject*,int>           _save_prototype_of;
+    std::set<const GMlib::SceneObject*>               _save_static;
+
+    std::vector<std::unique_ptr<SceneShard>>          _shards;
+    std::map<const GMlib::SceneObject*,SceneShard*>   _shard_of;
+    std::set<std::string>                             _expanded_groups;
+    float                                             _shard_cell_size {0.0f};
+    float                                             _shard_load_distance {100.0f};
+    float                                             _shard_unload_distance {150.0f};
+    unsigned int                                      _shard_frame {0};
+
+    void                                              registerShards( const ODDL::Structure* root, const std::string& dir );
+    void                                              collectShards();
+    void                                              checkShards();
+    void                                              loadShard( SceneShard& shard );
+    void                                              buildShard( SceneShard& shard, const GMlibSceneLoaderDataDescription& description );
+    void                                              unloadShard( SceneShard& shard );
+    void                                              finishUnload( SceneShard& shard );
+    void                                              collectStatic( const GMlib::SceneObject* obj, std::set<const GMlib::SceneObject*>& statics ) const;
+    void                                              reattachObject( GMlib::SceneObject* obj, const std::set<const GMlib::SceneObject*>& statics );
+    std::vector<const GMlib::SceneObject*>            shardObjects( const SceneShard* shard ) const;
+    void                                              updateShardBounds( SceneShard& shard, const std::vector<const GMlib::SceneObject*>& objects ) const;
+    void                                              saveShardTable( std::ostream& os ) const;
+
+    void                                              collectMaterials( const GMlib::SceneObject* obj );
+    void                                              saveMaterialTable( std::ostream& os );
+    void                                              collectPrototypes( const GMlib::SceneObject* obj, const std::ostream& fmt );
+    void                                              savePrototypes( std::ostream& os );
+    void                                              saveShape( std::ostream& os, const GMlib::SceneObject* obj );
+
+    bool                                              saveFile( const std::string& filename, const std::vector<const GMlib::SceneObject*>& objects,
+                                                                const std::string& manifest, const std::set<const GMlib::SceneObject*>& statics );
+    void                                              saveSerial( std::ostream& os, const std::vector<const GMlib::SceneObject*>& objects );
+    std::vector<std::string>                          saveParallel( const std::ostream& fmt, SceneFile::Compression compression,
+                                                                    const std::vector<const GMlib::SceneObject*>& objects );
+    void                                              save( std::ostream& os, const GMlib::SceneObject* obj);
+    void                                              saveSO( std::ostream& os, const GMlib::SceneObject* obj);
+    void                                              savePT( std::ostream& os, const GMlib::PTorus<float>* obj);
+    void                                              savePS(std::ostream &os, const GMlib::PSphere<float> *obj);
+    void                                              savePC(std::ostream &os, const GMlib::PCylinder<float> *obj);
+    void                                              savePP(std::ostream &os, const GMlib::PPlane<float> *obj);
 
     // **************************************************************
 
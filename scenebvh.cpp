@@ -0,0 +1,256 @@
+#include "scenebvh.h"
+
+// stl
+#include <algorithm>
+#include <cmath>
+
+
+SceneBvh::SceneBvh() {}
+
+void SceneBvh::setRebuildFactor( float factor ) { _rebuild_factor = std::max( 1.0f, factor ); }
+
+const SceneBvh::Stats& SceneBvh::getStats() const { return _stats; }
+
+size_t SceneBvh::getObjectCount() const { return _leaves.size(); }
+
+const std::vector<GMlib::SceneObject*>& SceneBvh::getObjects() const { return _objects; }
+
+size_t SceneBvh::getNodeCount() const { return _nodes.size(); }
+
+void SceneBvh::update( GMlib::Scene& scene ) {
+
+    _stats.rebuilt  = false;
+    _stats.refitted = 0;
+
+    // Only pointers are compared; objects gone from the scene are not looked at
+    std::vector<GMlib::SceneObject*> objects;
+    objects.reserve( _objects.size() );
+    for( auto i = 0; i < scene.getSize(); ++i )
+        if( isCullable( scene[i] ) )
+            objects.push_back( scene[i] );
+
+    if( objects != _objects ) {
+        _objects.swap(objects);
+        build();
+        return;
+    }
+
+    for( auto& leaf : _leaves ) {
+
+        const auto b = bound( leaf.obj );
+        if( equals( b, leaf.bound ) )
+            continue;
+
+        leaf.bound = b;
+        _nodes[size_t(leaf.node)].bound = b;
+        refit( _nodes[size_t(leaf.node)].parent );
+        ++_stats.refitted;
+    }
+
+    if( !_nodes.empty() && _built_radius > 0.0f && _nodes.front().bound.r > _rebuild_factor * _built_radius )
+        build();
+}
+
+std::vector<GMlib::SceneObject*> SceneBvh::cull( const GMlib::Camera& camera, int viewport_width, int viewport_height ) {
+
+    std::vector<GMlib::SceneObject*> culled;
+    if( _nodes.empty() ) {
+        _stats.drawn = _stats.culled = 0;
+        return culled;
+    }
+
+    // The camera frame, made orthonormal
+    const auto pos = camera.getPos();
+    const auto dir = GMlib::Vector<float,3>( camera.getDir() ).getNormalized();
+    const auto side = ( dir ^ GMlib::Vector<float,3>( camera.getUp() ) ).getNormalized();
+    const auto up = side ^ dir;
+
+    const auto tan_v = float( camera.getAngleTan() );
+    const auto tan_h = tan_v * ( viewport_height > 0 ? float(viewport_width) / float(viewport_height) : 1.0f );
+
+    auto plane = [&pos]( const GMlib::Vector<float,3>& normal, float offset ) {
+        const auto n = normal.getNormalized();
+        return Plane{ { n(0), n(1), n(2) }, -( n * GMlib::Vector<float,3>(pos) ) + offset };
+    };
+
+    // Normals point into the frustum
+    const Plane planes[6] = {
+        plane(  dir, -camera.getNearPlane() ),
+        plane( -dir,  camera.getFarPlane() ),
+        plane( dir * tan_h - side, 0.0f ),
+        plane( dir * tan_h + side, 0.0f ),
+        plane( dir * tan_v - up,   0.0f ),
+        plane( dir * tan_v + up,   0.0f )
+    };
+
+    std::vector<int> stack { 0 };
+    while( !stack.empty() ) {
+
+        const auto& node = _nodes[size_t( stack.back() )];
+        stack.pop_back();
+
+        // Without a sphere there is nothing to test; drawn
+        const auto& b = node.bound;
+        if( b.r < 0.0f )
+            continue;
+
+        auto outside = false;
+        auto inside  = true;
+        for( const auto& p : planes ) {
+            const auto distance = p.n[0] * b.c[0] + p.n[1] * b.c[1] + p.n[2] * b.c[2] + p.d;
+            if( distance < -b.r ) { outside = true; break; }
+            if( distance <  b.r ) inside = false;
+        }
+
+        if( outside )
+            collect( int( &node - _nodes.data() ), culled );
+        else if( !inside && node.leaf < 0 ) {
+            stack.push_back( node.left );
+            stack.push_back( node.right );
+        }
+    }
+
+    _stats.culled = culled.size();
+    _stats.drawn  = _leaves.size() - culled.size();
+    return culled;
+}
+
+void SceneBvh::build() {
+
+    _nodes.clear();
+    _leaves.clear();
+    _built_radius = 0.0f;
+    _stats.rebuilt = true;
+
+    if( _objects.empty() )
+        return;
+
+    std::vector<int> leaves;
+    for( auto obj : _objects ) {
+        leaves.push_back( int( _leaves.size() ) );
+        _leaves.push_back( Leaf{ obj, bound(obj), -1 } );
+    }
+
+    _nodes.reserve( 2 * _leaves.size() - 1 );
+    build( leaves, 0, leaves.size(), -1 );
+    _built_radius = _nodes.front().bound.r;
+}
+
+int SceneBvh::build( std::vector<int>& leaves, size_t begin, size_t end, int parent ) {
+
+    const auto index = int( _nodes.size() );
+    _nodes.push_back( Node() );
+    _nodes.back().parent = parent;
+
+    if( end - begin == 1 ) {
+        auto& leaf = _leaves[size_t( leaves[begin] )];
+        auto& node = _nodes.back();
+        node.bound  = leaf.bound;
+        node.leaf   = leaves[begin];
+        leaf.node   = index;
+        return index;
+    }
+
+    // Longest extent of the centers
+    float lo[3] = {  HUGE_VALF,  HUGE_VALF,  HUGE_VALF };
+    float hi[3] = { -HUGE_VALF, -HUGE_VALF, -HUGE_VALF };
+    for( auto i = begin; i < end; ++i )
+        for( auto k = 0; k < 3; ++k ) {
+            lo[k] = std::min( lo[k], _leaves[size_t( leaves[i] )].bound.c[k] );
+            hi[k] = std::max( hi[k], _leaves[size_t( leaves[i] )].bound.c[k] );
+        }
+
+    auto axis = 0;
+    for( auto k = 1; k < 3; ++k )
+        if( hi[k] - lo[k] > hi[axis] - lo[axis] )
+            axis = k;
+
+    const auto middle = begin + ( end - begin ) / 2;
+    std::nth_element( leaves.begin() + long(begin), leaves.begin() + long(middle), leaves.begin() + long(end),
+                      [this,axis]( int a, int b ) { return _leaves[size_t(a)].bound.c[axis] < _leaves[size_t(b)].bound.c[axis]; } );
+
+    const auto left  = build( leaves, begin, middle, index );
+    const auto right = build( leaves, middle, end, index );
+
+    // Indices, as the nodes may have moved
+    auto& node = _nodes[size_t(index)];
+    node.left   = left;
+    node.right  = right;
+    node.bound  = merge( _nodes[size_t(left)].bound, _nodes[size_t(right)].bound );
+    return index;
+}
+
+void SceneBvh::refit( int node ) {
+
+    // Up to where a bound no longer changes
+    while( node >= 0 ) {
+
+        auto& n = _nodes[size_t(node)];
+        const auto b = merge( _nodes[size_t(n.left)].bound, _nodes[size_t(n.right)].bound );
+        if( equals( b, n.bound ) )
+            return;
+
+        n.bound = b;
+        node = n.parent;
+    }
+}
+
+void SceneBvh::collect( int node, std::vector<GMlib::SceneObject*>& culled ) const {
+
+    const auto& n = _nodes[size_t(node)];
+    if( n.leaf >= 0 ) {
+        if( n.bound.r >= 0.0f )
+            culled.push_back( _leaves[size_t(n.leaf)].obj );
+        return;
+    }
+
+    collect( n.left, culled );
+    collect( n.right, culled );
+}
+
+bool SceneBvh::isCullable( const GMlib::SceneObject* obj ) {
+
+    return obj && !dynamic_cast<const GMlib::Camera*>(obj) && !dynamic_cast<const GMlib::Light*>(obj);
+}
+
+SceneBvh::Bound SceneBvh::bound( const GMlib::SceneObject* obj ) {
+
+    // Global, children included
+    const auto sphere = obj->getSurroundingSphere();
+
+    Bound b;
+    if( !sphere.isValid() )
+        return b;
+
+    const auto& c = sphere.getPos();
+    b.c[0] = c(0);
+    b.c[1] = c(1);
+    b.c[2] = c(2);
+    b.r = std::max( sphere.getRadius(), 0.0f );
+    return b;
+}
+
+SceneBvh::Bound SceneBvh::merge( const Bound& a, const Bound& b ) {
+
+    if( a.r < 0.0f ) return b;
+    if( b.r < 0.0f ) return a;
+
+    const float d[3] = { b.c[0] - a.c[0], b.c[1] - a.c[1], b.c[2] - a.c[2] };
+    const auto distance = std::sqrt( d[0] * d[0] + d[1] * d[1] + d[2] * d[2] );
+
+    // One inside the other
+    if( distance + b.r <= a.r ) return a;
+    if( distance + a.r <= b.r ) return b;
+
+    Bound m;
+    m.r = 0.5f * ( distance + a.r + b.r );
+    const auto t = ( m.r - a.r ) / distance;
+    for( auto k = 0; k < 3; ++k )
+        m.c[k] = a.c[k] + d[k] * t;
+    return m;
+}
+
+bool SceneBvh::equals( const Bound& a, const Bound& b ) {
+
+    return a.r == b.r && a.c[0] == b.c[0] && a.c[1] == b.c[1] && a.c[2] == b.c[2];
+}
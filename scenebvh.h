@@ -0,0 +1,89 @@
+#ifndef SCENEBVH_H
+#define SCENEBVH_H
+
+
+// gmlib
+#include <gmSceneModule>
+
+// stl
+#include <vector>
+
+
+// Bounding volume hierarchy over the world space bounding spheres of the objects at the top of
+// the scene, which enclose their children, for frustum culling. Built top down, split at the
+// median of the centers along the longest extent.
+//
+// Every update reads the spheres of the objects; the nodes above those that moved are refitted
+// up to the root, the rest of the tree is left alone. The tree is rebuilt when objects come or
+// go, or when refitting has let the root grow well past its size when built, as the refitted
+// nodes then overlap more and more.
+class SceneBvh {
+public:
+    struct Stats {
+        size_t                                        drawn {0};
+        size_t                                        culled {0};
+        size_t                                        refitted {0};     // leaves, last update
+        bool                                          rebuilt {false};  // last update
+    };
+
+    SceneBvh();
+
+    // Rebuild when the root has grown past factor times its radius when built
+    void                                              setRebuildFactor( float factor );
+
+    // Render thread, after the scene is prepared
+    void                                              update( GMlib::Scene& scene );
+
+    // Objects wholly outside the view frustum of camera, as of the last update.
+    // Objects without a valid sphere, and cameras and lights, are never culled
+    std::vector<GMlib::SceneObject*>                  cull( const GMlib::Camera& camera, int viewport_width, int viewport_height );
+
+    const Stats&                                      getStats() const;
+    size_t                                            getObjectCount() const;
+    const std::vector<GMlib::SceneObject*>&           getObjects() const;
+    size_t                                            getNodeCount() const;
+
+private:
+    struct Bound {
+        float                                         c[3] {0.0f, 0.0f, 0.0f};
+        float                                         r {-1.0f};         // negative: empty
+    };
+
+    struct Node {
+        Bound                                         bound;
+        int                                           parent {-1};
+        int                                           left {-1};
+        int                                           right {-1};
+        int                                           leaf {-1};         // index of the leaf, else -1
+    };
+
+    struct Leaf {
+        GMlib::SceneObject*                           obj;
+        Bound                                         bound;
+        int                                           node {-1};
+    };
+
+    struct Plane {
+        float                                         n[3];
+        float                                         d;                 // inside where n.x + d >= 0
+    };
+
+    std::vector<Node>                                 _nodes;
+    std::vector<Leaf>                                 _leaves;
+    std::vector<GMlib::SceneObject*>                  _objects;          // as of the last update, in scene order
+    float                                             _built_radius {0.0f};
+    float                                             _rebuild_factor {2.0f};
+    Stats                                             _stats;
+
+    void                                              build();
+    int                                               build( std::vector<int>& leaves, size_t begin, size_t end, int parent );
+    void                                              refit( int node );
+    void                                              collect( int node, std::vector<GMlib::SceneObject*>& culled ) const;
+
+    static bool                                       isCullable( const GMlib::SceneObject* obj );
+    static Bound                                      bound( const GMlib::SceneObject* obj );
+    static Bound                                      merge( const Bound& a, const Bound& b );
+    static bool                                       equals( const Bound& a, const Bound& b );
+};
+
+#endif // SCENEBVH_H
@@ -0,0 +1,372 @@
+#include "scenefile.h"
+
+// qt
+#include <QtGlobal>
+
+// zlib
+#include <zlib.h>
+
+// zstd
+#ifdef HAVE_ZSTD
+#include <zstd.h>
+#endif
+
+// stl
+#include <algorithm>
+#include <cerrno>
+#include <climits>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <memory>
+
+// posix
+#ifdef Q_OS_UNIX
+#include <fcntl.h>
+#include <limits.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+
+namespace {
+
+    // Size of the compressed chunks read from disk
+    constexpr size_t kChunkSize = 1 << 16;
+
+    bool endsWith( const std::string& str, const std::string& suffix ) {
+
+        return str.size() >= suffix.size() &&
+               str.compare( str.size() - suffix.size(), suffix.size(), suffix ) == 0;
+    }
+
+    SceneFile::Compression detect( const char* head, size_t size ) {
+
+        const unsigned char gzip[] = { 0x1f, 0x8b };
+        const unsigned char zstd[] = { 0x28, 0xb5, 0x2f, 0xfd };
+
+        if( size >= sizeof(gzip) && std::memcmp( head, gzip, sizeof(gzip) ) == 0 )
+            return SceneFile::Compression::Gzip;
+        if( size >= sizeof(zstd) && std::memcmp( head, zstd, sizeof(zstd) ) == 0 )
+            return SceneFile::Compression::Zstd;
+
+        return SceneFile::Compression::None;
+    }
+
+
+    // Decompressed text, handed on to the consumer one buffer at a time
+    class TextSink {
+    public:
+        explicit TextSink( const SceneFile::TextConsumer& consume )
+            : _consume(consume), _text(kChunkSize) {}
+
+        // Room for more bytes; a full buffer is handed on first
+        char*   reserve() {
+
+            if( _used == _text.size() )
+                flush();
+            return _text.data() + _used;
+        }
+        size_t  available() const                   { return _text.size() - _used; }
+        void    commit( size_t bytes )              { _used += bytes; }
+        void    append( const char* data, size_t n ) {
+
+            while( n ) {
+                auto to    = reserve();
+                auto count = std::min( n, available() );
+                std::memcpy( to, data, count );
+                commit(count);
+                data += count;
+                n    -= count;
+            }
+        }
+        void    flush() {
+
+            if( _used && _ok )
+                _ok = _consume( _text.data(), _used );
+            _used = 0;
+        }
+
+        // false once the consumer has given up
+        bool    ok() const                          { return _ok; }
+
+    private:
+        const SceneFile::TextConsumer&  _consume;
+        std::vector<char>               _text;
+        size_t                          _used {0};
+        bool                            _ok   {true};
+    };
+
+
+    // Stream decoders; feed() takes one chunk of the file at a time
+    class Decoder {
+    public:
+        virtual ~Decoder() = default;
+
+        virtual bool    feed( const char* data, size_t size, TextSink& sink ) = 0;
+        virtual bool    complete() const = 0;
+    };
+
+    class PlainDecoder : public Decoder {
+    public:
+        bool    feed( const char* data, size_t size, TextSink& sink ) override {
+
+            sink.append( data, size );
+            return true;
+        }
+        bool    complete() const override { return true; }
+    };
+
+    class GzipDecoder : public Decoder {
+    public:
+        GzipDecoder() {
+
+            std::memset( &_zs, 0, sizeof(_zs) );
+            _ok = inflateInit2( &_zs, 15 + 32 ) == Z_OK;   // gzip or zlib header
+        }
+        ~GzipDecoder() override { if( _ok ) inflateEnd( &_zs ); }
+
+        bool    feed( const char* data, size_t size, TextSink& sink ) override {
+
+            if( !_ok ) return false;
+
+            _zs.next_in  = reinterpret_cast<Bytef*>( const_cast<char*>(data) );
+            _zs.avail_in = uInt(size);
+
+            while( _zs.avail_in ) {
+
+                // Concatenated members, as written by a parallel save
+                if( _done ) {
+                    inflateReset( &_zs );
+                    _done = false;
+                }
+
+                _zs.next_out  = reinterpret_cast<Bytef*>( sink.reserve() );
+                _zs.avail_out = uInt( std::min( sink.available(), size_t(UINT_MAX) ) );
+                auto avail    = _zs.avail_out;
+
+                auto ret = inflate( &_zs, Z_NO_FLUSH );
+                sink.commit( avail - _zs.avail_out );
+
+                if( ret == Z_STREAM_END )
+                    _done = true;
+                else if( ret != Z_OK && ret != Z_BUF_ERROR )
+                    return false;
+            }
+
+            return true;
+        }
+        bool    complete() const override { return _done; }
+
+    private:
+        z_stream    _zs;
+        bool        _ok   {false};
+        bool        _done {false};
+    };
+
+#ifdef HAVE_ZSTD
+    class ZstdDecoder : public Decoder {
+    public:
+        ZstdDecoder() : _ds( ZSTD_createDStream() ) { if( _ds ) ZSTD_initDStream(_ds); }
+        ~ZstdDecoder() override { ZSTD_freeDStream(_ds); }
+
+        bool    feed( const char* data, size_t size, TextSink& sink ) override {
+
+            if( !_ds ) return false;
+
+            ZSTD_inBuffer in { data, size, 0 };
+            while( in.pos < in.size ) {
+
+                ZSTD_outBuffer out { sink.reserve(), sink.available(), 0 };
+
+                // Frames follow each other transparently; 0 means the last one ended
+                _left = ZSTD_decompressStream( _ds, &out, &in );
+                if( ZSTD_isError(_left) ) {
+                    std::cerr << "zstd: " << ZSTD_getErrorName(_left) << std::endl;
+                    return false;
+                }
+                sink.commit( out.pos );
+            }
+
+            return true;
+        }
+        bool    complete() const override { return _left == 0; }
+
+    private:
+        ZSTD_DStream*   _ds;
+        size_t          _left {1};
+    };
+#endif
+
+    std::unique_ptr<Decoder> decoder( SceneFile::Compression compression ) {
+
+        switch( compression ) {
+        case SceneFile::Compression::Gzip: return std::make_unique<GzipDecoder>();
+#ifdef HAVE_ZSTD
+        case SceneFile::Compression::Zstd: return std::make_unique<ZstdDecoder>();
+#endif
+        case SceneFile::Compression::None: return std::make_unique<PlainDecoder>();
+        default:                           return nullptr;
+        }
+    }
+}
+
+
+
+SceneFile::Compression SceneFile::compression( const std::string& filename ) {
+
+    if( endsWith( filename, ".gz" ) )  return Compression::Gzip;
+    if( endsWith( filename, ".zst" ) ) return Compression::Zstd;
+
+    return Compression::None;
+}
+
+bool SceneFile::isSupported( Compression compression ) {
+
+#ifdef HAVE_ZSTD
+    Q_UNUSED(compression)
+    return true;
+#else
+    return compression != Compression::Zstd;
+#endif
+}
+
+std::string SceneFile::extension( Compression compression ) {
+
+    switch( compression ) {
+    case Compression::Gzip: return ".oddl.gz";
+    case Compression::Zstd: return ".oddl.zst";
+    default:                return ".openddl";
+    }
+}
+
+std::string SceneFile::compress( const std::string& text, Compression compression ) {
+
+    if( compression == Compression::Gzip ) {
+
+        z_stream zs;
+        std::memset( &zs, 0, sizeof(zs) );
+        if( deflateInit2( &zs, Z_DEFAULT_COMPRESSION, Z_DEFLATED, 15 + 16, 8, Z_DEFAULT_STRATEGY ) != Z_OK )
+            return std::string();
+
+        std::string out( deflateBound( &zs, uLong(text.size()) ), '\0' );
+        zs.next_in   = reinterpret_cast<Bytef*>( const_cast<char*>(text.data()) );
+        zs.avail_in  = uInt(text.size());
+        zs.next_out  = reinterpret_cast<Bytef*>( &out[0] );
+        zs.avail_out = uInt(out.size());
+
+        auto ret = deflate( &zs, Z_FINISH );
+        out.resize( zs.total_out );
+        deflateEnd( &zs );
+
+        return ret == Z_STREAM_END ? out : std::string();
+    }
+#ifdef HAVE_ZSTD
+    else if( compression == Compression::Zstd ) {
+
+        std::string out( ZSTD_compressBound(text.size()), '\0' );
+        auto size = ZSTD_compress( &out[0], out.size(), text.data(), text.size(), 3 );
+        if( ZSTD_isError(size) )
+            return std::string();
+
+        out.resize(size);
+        return out;
+    }
+#endif
+
+    return text;
+}
+
+// On POSIX systems the buffers are written with vectored writes,
+// so they never have to be concatenated in memory.
+bool SceneFile::write( const std::string& filename, const std::vector<std::string>& buffers ) {
+
+#ifdef Q_OS_UNIX
+    auto fd = ::open( filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644 );
+    if( fd < 0 )
+        return false;
+
+    std::vector<iovec> iov;
+    iov.reserve(buffers.size());
+    for( const auto& buffer : buffers ) {
+        if( buffer.empty() ) continue;
+        iov.push_back( iovec{ const_cast<char*>(buffer.data()), buffer.size() } );
+    }
+
+    auto ok = true;
+    auto first = size_t(0);
+    while( ok && first < iov.size() ) {
+
+        auto count = int( std::min( iov.size() - first, size_t(IOV_MAX) ) );
+        auto written = ::writev( fd, &iov[first], count );
+        if( written < 0 ) {
+            ok = (errno == EINTR);
+            continue;
+        }
+
+        // Skip what went out, and adjust a partially written entry
+        auto left = size_t(written);
+        while( first < iov.size() && left >= iov[first].iov_len )
+            left -= iov[first++].iov_len;
+        if( left ) {
+            iov[first].iov_base = static_cast<char*>(iov[first].iov_base) + left;
+            iov[first].iov_len -= left;
+        }
+    }
+
+    return (::close(fd) == 0) && ok;
+#else
+    auto os = std::ofstream(filename,std::ios_base::out | std::ios_base::binary);
+    if(!os.is_open())
+        return false;
+
+    for( const auto& buffer : buffers )
+        os.write( buffer.data(), std::streamsize(buffer.size()) );
+
+    return bool(os);
+#endif
+}
+
+bool SceneFile::read( const std::string& filename, const TextConsumer& consume ) {
+
+    auto is = std::ifstream(filename,std::ios_base::in | std::ios_base::binary);
+    if(!is.is_open())
+        return false;
+
+    TextSink sink(consume);
+    std::vector<char> chunk(kChunkSize);
+    std::unique_ptr<Decoder> dec;
+
+    while( is ) {
+
+        is.read( chunk.data(), std::streamsize(chunk.size()) );
+        auto size = size_t( is.gcount() );
+        if( !size ) break;
+
+        // The first chunk tells what we are reading
+        if( !dec ) {
+
+            auto comp = detect( chunk.data(), size );
+            dec = decoder(comp);
+            if( !dec ) {
+                std::cerr << filename << " is compressed with zstd, which is not supported in this build" << std::endl;
+                return false;
+            }
+        }
+
+        if( !dec->feed( chunk.data(), size, sink ) ) {
+            std::cerr << "Corrupt compressed data in " << filename << std::endl;
+            return false;
+        }
+        if( !sink.ok() )
+            return false;
+    }
+
+    if( dec && !dec->complete() ) {
+        std::cerr << filename << " is truncated" << std::endl;
+        return false;
+    }
+
+    sink.flush();
+    return sink.ok() && !is.bad();
+}
@@ -0,0 +1,41 @@
+#ifndef SCENEFILE_H
+#define SCENEFILE_H
+
+
+// stl
+#include <functional>
+#include <string>
+#include <vector>
+
+
+// Scene file i/o.
+// The compression is picked from the file name when writing (".gz" gzip, ".zst" zstd),
+// and detected from the content when reading.
+namespace SceneFile {
+
+    enum class Compression {
+        None,
+        Gzip,
+        Zstd
+    };
+
+    Compression         compression( const std::string& filename );
+    bool                isSupported( Compression compression );
+    std::string         extension( Compression compression );
+
+    // Compresses text into one self contained gzip member or zstd frame.
+    // Such chunks are valid back to back, so the buffers of a scene can be compressed independently.
+    std::string         compress( const std::string& text, Compression compression );
+
+    // Writes the buffers back to back into filename, as they are
+    bool                write( const std::string& filename, const std::vector<std::string>& buffers );
+
+    // Takes a piece of decompressed text, which is not null terminated; false stops the reading
+    using TextConsumer = std::function<bool(const char* text, size_t size)>;
+
+    // Reads the file in chunks and hands the decompressed text on as it comes,
+    // so neither the file nor its text is ever whole in memory.
+    bool                read( const std::string& filename, const TextConsumer& consume );
+}
+
+#endif // SCENEFILE_H
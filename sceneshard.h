@@ -0,0 +1,39 @@
+#ifndef SCENESHARD_H
+#define SCENESHARD_H
+
+
+#include "gmlibsceneloader/gmlibsceneloaderdatadescription.h"
+
+// gmlib
+#include <gmCoreModule>
+#include <gmSceneModule>
+
+// stl
+#include <future>
+#include <memory>
+#include <set>
+#include <string>
+#include <vector>
+
+
+// One file of a sharded scene.
+// The manifest lists the shards with their bounds; a shard is read while the camera is near
+// it or its group is expanded, and written back and released when the camera moves away.
+struct SceneShard {
+
+    std::string                                                     file;       // as written in the manifest
+    std::string                                                     path;       // resolved against the manifest directory
+    std::string                                                     group;
+
+    GMlib::Point<float,3>                                           center {0.0f};
+    float                                                           radius {0.0f};
+
+    bool                                                            loaded {false};
+    bool                                                            failed {false};     // unreadable, not retried
+    std::future<std::shared_ptr<GMlibSceneLoaderDataDescription>>   pending;    // parsed in the background
+    std::future<bool>                                               saving;     // written back in the background
+    std::vector<GMlib::SceneObject*>                                unloading;  // out of the scene and the caches while written
+    std::set<const GMlib::SceneObject*>                             unloading_static;   // of those, to be static again if put back
+};
+
+#endif // SCENESHARD_H
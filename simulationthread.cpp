@@ -0,0 +1,279 @@
+#include "simulationthread.h"
+#include "frameprofiler.h"
+#include "gmlibaccess.h"
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+
+    bool equal( const GMlib::HqMatrix<float,3>& a, const GMlib::HqMatrix<float,3>& b ) {
+
+        return std::memcmp( a.getPtr(), b.getPtr(), 16 * sizeof(float) ) == 0;
+    }
+
+    // Element wise, with the rotation part made orthonormal again; fine for the small
+    // rotations between two steps
+    void blend( const GMlib::HqMatrix<float,3>& a, const GMlib::HqMatrix<float,3>& b, float t,
+                GMlib::HqMatrix<float,3>& result ) {
+
+        const auto pa = a.getPtr();
+        const auto pb = b.getPtr();
+        auto r = result.getPtr();
+        for( auto i = 0; i < 16; ++i )
+            r[i] = pa[i] + ( pb[i] - pa[i] ) * t;
+
+        // Gram-Schmidt on the rows of the upper left 3 x 3
+        float* rows[3] = { r, r + 4, r + 8 };
+        for( auto i = 0; i < 3; ++i ) {
+
+            for( auto j = 0; j < i; ++j ) {
+                const auto d = rows[i][0] * rows[j][0] + rows[i][1] * rows[j][1] + rows[i][2] * rows[j][2];
+                for( auto k = 0; k < 3; ++k )
+                    rows[i][k] -= d * rows[j][k];
+            }
+
+            const auto length = std::sqrt( rows[i][0] * rows[i][0] + rows[i][1] * rows[i][1] + rows[i][2] * rows[i][2] );
+            if( length > 0.0f )
+                for( auto k = 0; k < 3; ++k )
+                    rows[i][k] /= length;
+        }
+    }
+
+    bool isCamera( const GMlib::SceneObject* obj ) { return dynamic_cast<const GMlib::Camera*>(obj) != nullptr; }
+}
+
+
+
+SimulationThread::SimulationThread( GMlib::Scene& scene, double timestep )
+    : _scene(scene), _stepped( std::chrono::steady_clock::now() ), _timestep(timestep) {}
+
+SimulationThread::~SimulationThread() { stop(); }
+
+void SimulationThread::start() {
+
+    if( _thread.joinable() )
+        return;
+
+    _stopping = false;
+    _thread = std::thread( &SimulationThread::run, this );
+}
+
+void SimulationThread::stop() {
+
+    if( !_thread.joinable() )
+        return;
+
+    {
+        std::lock_guard<std::mutex> lock(_run_mutex);
+        _stopping = true;
+    }
+    _cond.notify_all();
+    _thread.join();
+}
+
+bool SimulationThread::isRunning() const { return _thread.joinable(); }
+
+void SimulationThread::setTimestep( double seconds ) { _timestep = std::max( seconds, 1.0e-4 ); }
+
+double SimulationThread::getTimestep() const { return _timestep; }
+
+void SimulationThread::setMaxStepsPerUpdate( int steps ) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_steps = std::max( steps, 1 );
+}
+
+void SimulationThread::setStepCallback( StepFunction stepped ) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _step_callback = stepped;
+}
+
+std::unique_lock<std::mutex> SimulationThread::lock() { return std::unique_lock<std::mutex>(_mutex); }
+
+unsigned long SimulationThread::getSteps() const { return _steps; }
+
+void SimulationThread::run() {
+
+    using clock = std::chrono::steady_clock;
+
+    auto last = clock::now();
+    auto accumulator = clock::duration::zero();
+    auto busy = false;
+
+    for(;;) {
+
+        const auto dt = _timestep.load();
+        const auto timestep = std::chrono::duration_cast<clock::duration>( std::chrono::duration<double>(dt) );
+
+        // Sleep until a step is due, or a little while the scene is taken
+        {
+            const auto sleep = busy ? clock::duration( std::chrono::milliseconds(1) ) : timestep - accumulator;
+            std::unique_lock<std::mutex> wait(_run_mutex);
+            if( _cond.wait_for( wait, sleep, [this]() { return _stopping; } ) )
+                return;
+        }
+
+        const auto now = clock::now();
+        accumulator += now - last;
+        last = now;
+
+        // Never waits for the scene, so whoever holds the lock may stop the thread
+        std::unique_lock<std::mutex> lock( _mutex, std::try_to_lock );
+        busy = !lock.owns_lock();
+        if( busy )
+            continue;
+
+        // A paused scene holds still and builds up no backlog
+        if( !_scene.isRunning() ) {
+            accumulator = clock::duration::zero();
+            continue;
+        }
+
+        auto moved = false;
+        for( auto steps = 0; accumulator >= timestep && steps < _max_steps; ++steps ) {
+            moved = step(dt) || moved;
+            accumulator -= timestep;
+        }
+
+        if( accumulator >= timestep )
+            accumulator = clock::duration::zero();
+
+        // Where the latest step stands in wall time
+        _stepped = now - accumulator;
+
+        auto stepped = _step_callback;
+        lock.unlock();
+
+        if( stepped )
+            stepped(moved);
+    }
+}
+
+bool SimulationThread::step( double dt ) {
+
+    FrameProfiler::Scope timing( FrameProfiler::Simulate );
+    ++_steps;
+
+    for( auto i = 0; i < _scene.getSize(); ++i )
+        restore( _scene[i] );
+
+    for( auto i = 0; i < _scene.getSize(); ++i )
+        _scene[i]->simulate(dt);
+    _scene.prepare();
+
+    auto moved = false;
+    for( auto i = 0; i < _scene.getSize(); ++i )
+        moved = capture( _scene[i] ) || moved;
+
+    prune();
+    return moved;
+}
+
+void SimulationThread::restore( GMlib::SceneObject* obj ) {
+
+    if( !isCamera(obj) ) {
+
+        auto state = _states.find(obj);
+        if( state != _states.end() ) {
+
+            auto& m = SceneObjectAccess::matrix(obj);
+            auto& s = state->second;
+
+            // Moved by hand since it was last shown: from here on
+            if( !equal( m, s.shown ) )
+                s.previous = s.current = s.shown = m;
+            else
+                m = s.current;
+        }
+    }
+
+    const auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        restore( children(i) );
+}
+
+bool SimulationThread::capture( GMlib::SceneObject* obj ) {
+
+    auto moved = false;
+    if( !isCamera(obj) ) {
+
+        const auto& m = SceneObjectAccess::matrix(obj);
+        auto state = _states.find(obj);
+        if( state == _states.end() )
+            _states[obj] = State{ m, m, m, _steps };
+        else {
+
+            auto& s = state->second;
+            s.previous = s.current;
+            s.current  = m;
+            s.shown    = m;
+            s.step     = _steps;
+            moved = !equal( s.previous, s.current );
+        }
+    }
+
+    const auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        moved = capture( children(i) ) || moved;
+
+    return moved;
+}
+
+bool SimulationThread::interpolate() {
+
+    const auto since = std::chrono::duration<double>( std::chrono::steady_clock::now() - _stepped ).count();
+    const auto t = float( std::min( std::max( since / _timestep, 0.0 ), 1.0 ) );
+
+    auto between = false;
+    for( auto i = 0; i < _scene.getSize(); ++i )
+        between = interpolate( _scene[i], t ) || between;
+
+    return between;
+}
+
+bool SimulationThread::interpolate( GMlib::SceneObject* obj, float t ) {
+
+    auto between = false;
+
+    if( !isCamera(obj) ) {
+
+        auto state = _states.find(obj);
+        if( state != _states.end() ) {
+
+            auto& m = SceneObjectAccess::matrix(obj);
+            auto& s = state->second;
+
+            if( !equal( m, s.shown ) )
+                s.previous = s.current = s.shown = m;
+            else if( t >= 1.0f || equal( s.previous, s.current ) )
+                m = s.shown = s.current;
+            else {
+                blend( s.previous, s.current, t, m );
+                s.shown = m;
+                between = true;
+            }
+        }
+    }
+
+    const auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        between = interpolate( children(i), t ) || between;
+
+    return between;
+}
+
+void SimulationThread::prune() {
+
+    // Objects no longer in the scene
+    for( auto state = _states.begin(); state != _states.end(); ) {
+        if( state->second.step != _steps )
+            state = _states.erase(state);
+        else
+            ++state;
+    }
+}
@@ -0,0 +1,87 @@
+#ifndef SIMULATIONTHREAD_H
+#define SIMULATIONTHREAD_H
+
+
+// gmlib
+#include <gmSceneModule>
+
+// stl
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <thread>
+
+
+// Simulates a scene on a thread of its own, in steps of a fixed length.
+// Wall time is gathered in an accumulator and simulated away a step at a time, so animation
+// does not depend on how busy the ui or render thread is. When too far behind, the backlog is
+// dropped after a few steps instead of being caught up.
+//
+// After every step the local matrix of each object is kept, along with the one of the step
+// before. The render thread shows the objects between the two, as far along as the time since
+// the last step; the simulation goes on from its own state. An object moved by anyone else in
+// the meantime keeps that move. Cameras are simulated, but not interpolated.
+//
+// The scene may only be touched outside the simulation while lock() is held. The simulation
+// never blocks on the lock, it skips ahead, so the thread may be stopped with the lock held.
+class SimulationThread {
+public:
+    // After every step, on the simulation thread; moved tells if any object did
+    using StepFunction = std::function<void(bool moved)>;
+
+    explicit SimulationThread( GMlib::Scene& scene, double timestep = 1.0 / 60.0 );
+    ~SimulationThread();
+
+    void                                              start();
+    void                                              stop();
+    bool                                              isRunning() const;
+
+    // Seconds of simulated time per step
+    void                                              setTimestep( double seconds );
+    double                                            getTimestep() const;
+    void                                              setMaxStepsPerUpdate( int steps );
+    void                                              setStepCallback( StepFunction stepped );
+
+    std::unique_lock<std::mutex>                      lock();
+
+    // Render thread, with the lock held; the scene still needs to be prepared after.
+    // true while objects are shown between two steps
+    bool                                              interpolate();
+
+    unsigned long                                     getSteps() const;
+
+private:
+    struct State {
+        GMlib::HqMatrix<float,3>                      previous;
+        GMlib::HqMatrix<float,3>                      current;
+        GMlib::HqMatrix<float,3>                      shown;    // as last left in the object
+        unsigned long                                 step;     // last seen in the scene
+    };
+
+    GMlib::Scene&                                     _scene;
+    std::map<const GMlib::SceneObject*,State>         _states;
+    std::chrono::steady_clock::time_point             _stepped;
+    std::atomic<unsigned long>                        _steps {0};
+    std::mutex                                        _mutex;       // the scene and the states
+
+    std::atomic<double>                               _timestep;
+    int                                               _max_steps {5};
+    StepFunction                                      _step_callback;
+
+    std::thread                                       _thread;
+    std::mutex                                        _run_mutex;
+    std::condition_variable                           _cond;
+    bool                                              _stopping {false};
+
+    void                                              run();
+    bool                                              step( double dt );
+    void                                              restore( GMlib::SceneObject* obj );
+    bool                                              capture( GMlib::SceneObject* obj );
+    bool                                              interpolate( GMlib::SceneObject* obj, float t );
+    void                                              prune();
+};
+
+#endif // SIMULATIONTHREAD_H
@@ -0,0 +1,366 @@
+#include "meshcache.h"
+
+// stl
+#include <algorithm>
+#include <tuple>
+
+
+namespace {
+
+    // Vertices as the default visualizer stores them (position, normal, texture coordinates),
+    // plus the indices of its triangle strips
+    size_t estimateBytes( int m1, int m2 ) {
+
+        m1 = std::max( m1, 2 );
+        m2 = std::max( m2, 2 );
+        return size_t(m1) * size_t(m2) * 8 * sizeof(float) +
+               size_t(m1 - 1) * size_t(m2) * 2 * sizeof(unsigned int);
+    }
+
+    // Position and octahedral normal, plus the strips and restarts of the bands
+    size_t estimatePackedBytes( int m1, int m2 ) {
+
+        m1 = std::max( m1, 2 );
+        m2 = std::max( m2, 2 );
+        return size_t(m1) * size_t(m2) * ( 3 * sizeof(float) + 2 * sizeof(short) ) +
+               size_t(m1 - 1) * size_t( 2 * m2 + m2 / 4 + 1 ) * sizeof(unsigned int);
+    }
+
+    bool drawsOwnMesh( const GMlib::PSurf<float,3>* surface ) {
+
+        auto visualizer = static_cast<const GMlib::Visualizer*>( surface->getDefaultVisualizer() );
+        const auto& visualizers = surface->getVisualizers();
+        for( auto i = 0; i < visualizers.getSize(); ++i )
+            if( visualizer && visualizers(i) == visualizer )
+                return true;
+
+        return false;
+    }
+}
+
+
+
+bool MeshCache::Key::operator < ( const Key& other ) const {
+
+    return std::tie( type, shape, m1, m2, d1, d2 ) <
+           std::tie( other.type, other.shape, other.m1, other.m2, other.d1, other.d2 );
+}
+
+MeshCache::MeshCache( TessellationQueue& queue ) : _queue(queue) {
+
+    _queue.setUploadCallback( [this]( GMlib::PSurf<float,3>* s, const SurfaceSamples& samples, bool last ) {
+        uploaded(s,samples,last);
+    });
+}
+
+MeshCache::~MeshCache() {
+
+    _queue.setUploadCallback( nullptr );
+    clear();
+}
+
+bool MeshCache::replot( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 ) {
+
+    // A surface with its default visualizer switched off is left alone
+    auto attached = _attached.find(surface);
+    auto waiting  = _waiting.find(surface);
+    if( attached == _attached.end() && waiting == _waiting.end() && !drawsOwnMesh(surface) )
+        return false;
+
+    Key key;
+    if( !makeKey( surface, m1, m2, d1, d2, key ) )
+        return false;
+
+    auto e = entry( surface, key );
+    if( !e )
+        return false;
+
+    // Already there, or on its way
+    if( attached != _attached.end() && attached->second == e ) {
+        if( waiting != _waiting.end() ) {
+            unuse(waiting->second);
+            _waiting.erase(waiting);
+        }
+        trim();
+        return true;
+    }
+    if( waiting != _waiting.end() ) {
+        if( waiting->second == e )
+            return true;
+
+        unuse(waiting->second);
+        _waiting.erase(waiting);
+    }
+
+    if( canSwitch( surface, e ) )
+        attach( surface, e );
+    else {
+        acquire(e);
+        _waiting[surface] = e;
+    }
+
+    trim();
+    return true;
+}
+
+const GMlib::PSurf<float,3>* MeshCache::getMesh( const GMlib::PSurf<float,3>* surface ) const {
+
+    auto s = const_cast<GMlib::PSurf<float,3>*>(surface);
+
+    auto waiting = _waiting.find(s);
+    if( waiting != _waiting.end() )
+        return waiting->second->carrier.get();
+
+    auto attached = _attached.find(s);
+    if( attached != _attached.end() )
+        return attached->second->carrier.get();
+
+    return nullptr;
+}
+
+void MeshCache::detach( GMlib::PSurf<float,3>* surface ) {
+
+    auto waiting = _waiting.find(surface);
+    if( waiting != _waiting.end() ) {
+        unuse(waiting->second);
+        _waiting.erase(waiting);
+    }
+
+    auto attached = _attached.find(surface);
+    if( attached != _attached.end() ) {
+        surface->removeVisualizer( visualizer(attached->second) );
+        surface->enableDefaultVisualizer(true);
+        if( attached->second->packed )
+            attached->second->packed->removeUser(surface);
+        unuse(attached->second);
+        _attached.erase(attached);
+    }
+
+    trim();
+}
+
+void MeshCache::release( GMlib::SceneObject* obj ) {
+
+    if( !obj ) return;
+
+    auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        release( children(i) );
+
+    if( auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj) )
+        detach(surface);
+}
+
+void MeshCache::clear() {
+
+    for( auto& carrier : _carriers )
+        _queue.forget(carrier.first);
+
+    _attached.clear();
+    _waiting.clear();
+    _unused.clear();
+    _carriers.clear();
+    _entries.clear();
+    _bytes = 0;
+}
+
+void MeshCache::setBudget( size_t bytes ) {
+
+    _budget = bytes;
+    trim();
+}
+
+size_t MeshCache::getBudget() const { return _budget; }
+
+size_t MeshCache::getBytes() const { return _bytes; }
+
+size_t MeshCache::getSize() const { return _entries.size(); }
+
+void MeshCache::setPacked( bool packed ) {
+
+    if( packed == _packed )
+        return;
+
+    // Meshes kept for reuse are of the other kind
+    _packed = packed;
+    while( !_unused.empty() )
+        evict( _unused.front() );
+}
+
+bool MeshCache::isPacked() const { return _packed; }
+
+void MeshCache::setInstanced( bool instanced ) {
+
+    _instanced = instanced;
+    for( auto& e : _entries )
+        if( e.second->packed )
+            e.second->packed->setInstanced(instanced);
+}
+
+bool MeshCache::isInstanced() const { return _instanced; }
+
+bool MeshCache::makeKey( const GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2, Key& key ) {
+
+    if( auto torus = dynamic_cast<const GMlib::PTorus<float>*>(surface) ) {
+        key.type  = "PTorus";
+        key.shape = { torus->getWheelRadius(), torus->getTubeRadius1(), torus->getTubeRadius2() };
+    }
+    else if( auto sphere = dynamic_cast<const GMlib::PSphere<float>*>(surface) ) {
+        key.type  = "PSphere";
+        key.shape = { sphere->getRadius() };
+    }
+    else if( auto cylinder = dynamic_cast<const GMlib::PCylinder<float>*>(surface) ) {
+        key.type  = "PCylinder";
+        key.shape = { cylinder->getRadiusX(), cylinder->getRadiusY(), cylinder->getHeight() };
+    }
+    else if( auto plane = dynamic_cast<const GMlib::PPlane<float>*>(surface) ) {
+
+        // Corner and spanning vectors
+        auto p = const_cast<GMlib::PPlane<float>*>(plane)->evaluate( plane->getParStartU(), plane->getParStartV(), 1, 1 );
+        key.type  = "PPlane";
+        key.shape.clear();
+        for( const auto& v : { p[0][0], p[1][0], p[0][1] } )
+            for( auto k = 0; k < 3; ++k )
+                key.shape.push_back( v[k] );
+    }
+    else
+        return false;
+
+    key.m1 = m1;
+    key.m2 = m2;
+    key.d1 = d1;
+    key.d2 = d2;
+    return true;
+}
+
+GMlib::PSurfVisualizer<float,3>* MeshCache::visualizer( const Entry* entry ) {
+
+    if( entry->packed )
+        return entry->packed.get();
+
+    return const_cast<GMlib::PSurfVisualizer<float,3>*>( entry->carrier->getDefaultVisualizer() );
+}
+
+MeshCache::Entry* MeshCache::entry( const GMlib::PSurf<float,3>* surface, const Key& key ) {
+
+    auto found = _entries.find(key);
+    if( found != _entries.end() )
+        return found->second.get();
+
+    std::unique_ptr<Entry> e( new Entry );
+    e->key = key;
+    e->carrier.reset( SurfaceSampler::copyShape(surface) );
+    if( !e->carrier )
+        return nullptr;
+
+    // A progressive replot may upload its first pass right away
+    if( _packed ) {
+        e->packed.reset( new PackedSurfaceVisualizer );
+        e->packed->setInstanced(_instanced);
+        e->carrier->insertVisualizer( e->packed.get() );
+    }
+    else
+        e->carrier->toggleDefaultVisualizer();
+    _carriers[e->carrier.get()] = e.get();
+    if( !_queue.submit( e->carrier.get(), key.m1, key.m2, key.d1, key.d2 ) ) {
+        _carriers.erase( e->carrier.get() );
+        return nullptr;
+    }
+
+    e->bytes  = _packed ? estimatePackedBytes( key.m1, key.m2 ) : estimateBytes( key.m1, key.m2 );
+    e->unused = _unused.insert( _unused.end(), e.get() );
+    _bytes += e->bytes;
+
+    return ( _entries[key] = std::move(e) ).get();
+}
+
+void MeshCache::uploaded( GMlib::PSurf<float,3>* carrier, const SurfaceSamples& samples, bool last ) {
+
+    auto found = _carriers.find(carrier);
+    if( found == _carriers.end() )
+        return;
+
+    auto e = found->second;
+    e->ready    = true;
+    e->complete = last;
+    e->sphere = samples.sphere;
+    e->m1     = samples.m1;
+    e->m2     = samples.m2;
+    e->d1     = samples.d1;
+    e->d2     = samples.d2;
+
+    // Refinement passes of a progressive replot change the mesh under the surfaces drawing it
+    for( auto& attached : _attached )
+        if( attached.second == e )
+            SurfaceSampler::adopt( attached.first, e->m1, e->m2, e->d1, e->d2, e->sphere );
+
+    // The surfaces waiting for the mesh switch over in the same frame
+    for( auto waiting = _waiting.begin(); waiting != _waiting.end(); ) {
+
+        if( waiting->second != e || !canSwitch( waiting->first, e ) ) {
+            ++waiting;
+            continue;
+        }
+
+        auto surface = waiting->first;
+        waiting = _waiting.erase(waiting);
+        attach( surface, e );
+        unuse(e);
+    }
+}
+
+bool MeshCache::canSwitch( const GMlib::PSurf<float,3>* surface, const Entry* entry ) {
+
+    // Early passes of a progressive replot only replace coarser meshes
+    return entry->complete ||
+           ( entry->ready && entry->m1 * entry->m2 >= surface->getSamplesU() * surface->getSamplesV() );
+}
+
+void MeshCache::attach( GMlib::PSurf<float,3>* surface, Entry* entry ) {
+
+    acquire(entry);
+
+    auto attached = _attached.find(surface);
+    if( attached != _attached.end() ) {
+        surface->removeVisualizer( visualizer(attached->second) );
+        if( attached->second->packed )
+            attached->second->packed->removeUser(surface);
+        unuse(attached->second);
+    }
+    else
+        surface->enableDefaultVisualizer(false);
+
+    surface->insertVisualizer( visualizer(entry) );
+    if( entry->packed )
+        entry->packed->addUser(surface);
+    _attached[surface] = entry;
+
+    SurfaceSampler::adopt( surface, entry->m1, entry->m2, entry->d1, entry->d2, entry->sphere );
+}
+
+void MeshCache::acquire( Entry* entry ) {
+
+    if( entry->users++ == 0 )
+        _unused.erase(entry->unused);
+}
+
+void MeshCache::unuse( Entry* entry ) {
+
+    if( --entry->users == 0 )
+        entry->unused = _unused.insert( _unused.end(), entry );
+}
+
+void MeshCache::trim() {
+
+    while( _bytes > _budget && !_unused.empty() )
+        evict( _unused.front() );
+}
+
+void MeshCache::evict( Entry* entry ) {
+
+    _unused.erase( entry->unused );
+    _queue.forget( entry->carrier.get() );
+    _carriers.erase( entry->carrier.get() );
+    _bytes -= entry->bytes;
+    _entries.erase( entry->key );
+}
@@ -0,0 +1,116 @@
+#ifndef MESHCACHE_H
+#define MESHCACHE_H
+
+
+#include "tessellationqueue.h"
+#include "packedsurfacevisualizer.h"
+
+// gmlib
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+// stl
+#include <list>
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+
+
+// Tessellations shared between identical surfaces.
+// A mesh is keyed by surface type, shape parameters and sampling (samples and derivatives in u
+// and v). Each mesh is held by a hidden carrier surface, tessellated through the
+// TessellationQueue; the surfaces using it draw the carrier's visualizer instead of their own
+// default visualizer. Until a new mesh is ready a surface keeps drawing its previous one;
+// with progressive replots it switches at the first pass at least as fine as that.
+//
+// With packed meshes on, meshes tessellated from then on are drawn by a PackedSurfaceVisualizer
+// (cache ordered indices, interleaved and quantized vertices) instead of a default visualizer.
+// Instanced, all the surfaces sharing a packed mesh are drawn with one call.
+//
+// Meshes no surface uses any more are kept for reuse, and evicted least recently used first
+// once the estimated size of all meshes is over budget. Meshes in use are never evicted.
+//
+// All member functions are to be called from the render thread.
+class MeshCache {
+public:
+    explicit MeshCache( TessellationQueue& queue );
+    ~MeshCache();
+
+    // false if the surface can not share a mesh; it then has to be replotted on its own
+    bool                                              replot( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 );
+
+    // Carrier of the mesh the surface draws, or is waiting for; nullptr if it has none
+    const GMlib::PSurf<float,3>*                      getMesh( const GMlib::PSurf<float,3>* surface ) const;
+
+    // The surface goes back to its own default visualizer
+    void                                              detach( GMlib::PSurf<float,3>* surface );
+
+    // Detaches obj and its children; before they are deleted or removed from the scene
+    void                                              release( GMlib::SceneObject* obj );
+
+    // Drops every mesh without touching the surfaces, for when the scene is gone
+    void                                              clear();
+
+    void                                              setBudget( size_t bytes );
+    size_t                                            getBudget() const;
+    size_t                                            getBytes() const;
+    size_t                                            getSize() const;
+
+    void                                              setPacked( bool packed );
+    bool                                              isPacked() const;
+
+    void                                              setInstanced( bool instanced );
+    bool                                              isInstanced() const;
+
+private:
+    struct Key {
+        std::string                                   type;
+        std::vector<float>                            shape;
+        int                                           m1, m2, d1, d2;
+
+        bool                                          operator < ( const Key& other ) const;
+    };
+
+    struct Entry {
+        Key                                           key;
+        std::unique_ptr<PackedSurfaceVisualizer>      packed;     // outlives the carrier drawing with it
+        std::unique_ptr<GMlib::PSurf<float,3>>        carrier;    // owns the shared default visualizer
+        size_t                                        bytes {0};
+        int                                           users {0};
+        bool                                          ready {false};      // a first pass is uploaded
+        bool                                          complete {false};   // no more passes to come
+
+        // Left on the surfaces using the mesh, as a replot would
+        GMlib::Sphere<float,3>                        sphere;
+        int                                           m1 {0}, m2 {0}, d1 {0}, d2 {0};
+
+        std::list<Entry*>::iterator                   unused;     // while users == 0
+    };
+
+    TessellationQueue&                                _queue;
+    std::map<Key,std::unique_ptr<Entry>>              _entries;
+    std::map<const GMlib::PSurf<float,3>*,Entry*>     _carriers;
+    std::map<GMlib::PSurf<float,3>*,Entry*>           _attached;  // drawing the mesh
+    std::map<GMlib::PSurf<float,3>*,Entry*>           _waiting;   // until the mesh is ready
+    std::list<Entry*>                                 _unused;    // least recently used first
+
+    size_t                                            _budget {size_t(256) << 20};
+    size_t                                            _bytes {0};
+    bool                                              _packed {false};
+    bool                                              _instanced {true};
+
+    static bool                                       makeKey( const GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2, Key& key );
+    static GMlib::PSurfVisualizer<float,3>*           visualizer( const Entry* entry );
+
+    Entry*                                            entry( const GMlib::PSurf<float,3>* surface, const Key& key );
+    void                                              uploaded( GMlib::PSurf<float,3>* carrier, const SurfaceSamples& samples, bool last );
+    static bool                                       canSwitch( const GMlib::PSurf<float,3>* surface, const Entry* entry );
+    void                                              attach( GMlib::PSurf<float,3>* surface, Entry* entry );
+    void                                              acquire( Entry* entry );
+    void                                              unuse( Entry* entry );
+    void                                              trim();
+    void                                              evict( Entry* entry );
+};
+
+#endif // MESHCACHE_H
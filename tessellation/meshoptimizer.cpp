@@ -0,0 +1,180 @@
+#include "meshoptimizer.h"
+
+// stl
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+
+namespace {
+
+    // Columns of cells per band; the rows of a band are band + 1 vertices wide, and a FIFO cache
+    // has to keep the previous row while the next one is loaded
+    int bandWidth( int cells, const MeshOptimizer::Options& options ) {
+
+        if( options.order == MeshOptimizer::Order::Rows )
+            return std::max( cells, 1 );
+
+        return std::max( options.cache_size / 2 - 2, 1 );
+    }
+
+    std::int16_t snorm16( float f ) {
+
+        return std::int16_t( std::lround( std::max( -1.0f, std::min( f, 1.0f ) ) * 32767.0f ) );
+    }
+
+    float sign( float f ) { return f < 0.0f ? -1.0f : 1.0f; }
+}
+
+
+
+constexpr std::uint32_t PackedMesh::restart_index;
+
+std::size_t PackedMesh::getBytes() const {
+
+    return vertices.size() + indices.size() * sizeof(std::uint32_t);
+}
+
+std::vector<std::uint32_t> MeshOptimizer::gridIndices( int m1, int m2, const Options& options ) {
+
+    std::vector<std::uint32_t> indices;
+    if( m1 < 2 || m2 < 2 )
+        return indices;
+
+    const auto strips = options.topology == PackedMesh::Topology::Strips;
+    const auto width  = bandWidth( m2 - 1, options );
+    auto vertex = [m2]( int i, int j ) { return std::uint32_t( i * m2 + j ); };
+
+    const auto bands = size_t( ( m2 - 2 ) / width + 1 );
+    indices.reserve( strips ? bands * size_t(m1 - 1) * size_t( 2 * ( width + 1 ) + 1 )
+                            : size_t(m1 - 1) * size_t(m2 - 1) * 6 );
+
+    // Same winding either way: (i,j) (i+1,j) (i,j+1) and (i,j+1) (i+1,j) (i+1,j+1)
+    for( auto begin = 0; begin < m2 - 1; begin += width ) {
+
+        const auto end = std::min( begin + width, m2 - 1 );
+        for( auto i = 0; i < m1 - 1; ++i ) {
+
+            if( strips ) {
+                if( !indices.empty() )
+                    indices.push_back( PackedMesh::restart_index );
+
+                for( auto j = begin; j <= end; ++j ) {
+                    indices.push_back( vertex( i, j ) );
+                    indices.push_back( vertex( i + 1, j ) );
+                }
+            }
+            else {
+                for( auto j = begin; j < end; ++j ) {
+                    indices.insert( indices.end(), { vertex( i, j ),     vertex( i + 1, j ), vertex( i, j + 1 ),
+                                                     vertex( i, j + 1 ), vertex( i + 1, j ), vertex( i + 1, j + 1 ) } );
+                }
+            }
+        }
+    }
+
+    return indices;
+}
+
+void MeshOptimizer::pack( const SurfaceSamples& samples, const Options& options, PackedMesh& mesh ) {
+
+    pack( samples.p, samples.normals, samples.m1, samples.m2, options, mesh );
+}
+
+void MeshOptimizer::pack( const GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+                          const GMlib::DMatrix<GMlib::Vector<float,3>>& normals,
+                          int m1, int m2, const Options& options, PackedMesh& mesh ) {
+
+    mesh.topology       = options.topology;
+    mesh.quantized      = options.quantize_normals;
+    mesh.stride         = int( 3 * sizeof(float) + ( mesh.quantized ? 2 * sizeof(std::int16_t) : 3 * sizeof(float) ) );
+    mesh.vertex_count   = size_t( std::max( m1, 0 ) ) * size_t( std::max( m2, 0 ) );
+    mesh.triangle_count = m1 > 1 && m2 > 1 ? 2 * size_t(m1 - 1) * size_t(m2 - 1) : 0;
+    mesh.vertices.resize( mesh.vertex_count * size_t(mesh.stride) );
+    mesh.indices = gridIndices( m1, m2, options );
+
+    auto out = mesh.vertices.data();
+    for( auto i = 0; i < m1; ++i ) {
+        for( auto j = 0; j < m2; ++j ) {
+
+            const auto& x = p[i][j][0][0];
+            const auto& n = normals[i][j];
+
+            float position[3] { x[0], x[1], x[2] };
+            std::memcpy( out, position, sizeof(position) );
+            out += sizeof(position);
+
+            if( mesh.quantized ) {
+                std::int16_t normal[2];
+                encodeOctahedral( n, normal );
+                std::memcpy( out, normal, sizeof(normal) );
+                out += sizeof(normal);
+            }
+            else {
+                float normal[3] { n[0], n[1], n[2] };
+                std::memcpy( out, normal, sizeof(normal) );
+                out += sizeof(normal);
+            }
+        }
+    }
+}
+
+double MeshOptimizer::acmr( const std::vector<std::uint32_t>& indices, std::size_t vertex_count,
+                            std::size_t triangle_count, int cache_size ) {
+
+    if( !triangle_count )
+        return 0.0;
+
+    // A vertex is in the cache while fewer than cache_size others were loaded after it
+    std::vector<long long> loaded( vertex_count, -1 );
+    long long loads = 0;
+    for( auto i : indices ) {
+
+        if( i == PackedMesh::restart_index || i >= vertex_count )
+            continue;
+
+        if( loaded[i] < 0 || loads - loaded[i] >= cache_size )
+            loaded[i] = loads++;
+    }
+
+    return double(loads) / double(triangle_count);
+}
+
+void MeshOptimizer::encodeOctahedral( const GMlib::Vector<float,3>& normal, std::int16_t* encoded ) {
+
+    const auto l1 = std::fabs( normal[0] ) + std::fabs( normal[1] ) + std::fabs( normal[2] );
+    if( l1 <= 0.0f ) {
+        encoded[0] = encoded[1] = 0;
+        return;
+    }
+
+    // Onto the octahedron, the lower half folded over the upper one
+    auto x = normal[0] / l1;
+    auto y = normal[1] / l1;
+    if( normal[2] < 0.0f ) {
+        const auto fx = ( 1.0f - std::fabs(y) ) * sign(x);
+        const auto fy = ( 1.0f - std::fabs(x) ) * sign(y);
+        x = fx;
+        y = fy;
+    }
+
+    encoded[0] = snorm16(x);
+    encoded[1] = snorm16(y);
+}
+
+GMlib::Vector<float,3> MeshOptimizer::decodeOctahedral( const std::int16_t* encoded ) {
+
+    // As the vertex shader of PackedSurfaceVisualizer does it
+    auto x = std::max( float(encoded[0]) / 32767.0f, -1.0f );
+    auto y = std::max( float(encoded[1]) / 32767.0f, -1.0f );
+    auto z = 1.0f - std::fabs(x) - std::fabs(y);
+    if( z < 0.0f ) {
+        const auto fx = ( 1.0f - std::fabs(y) ) * sign(x);
+        const auto fy = ( 1.0f - std::fabs(x) ) * sign(y);
+        x = fx;
+        y = fy;
+    }
+
+    GMlib::Vector<float,3> n( x, y, z );
+    return n / n.getLength();
+}
@@ -0,0 +1,71 @@
+#ifndef MESHOPTIMIZER_H
+#define MESHOPTIMIZER_H
+
+
+#include "surfacesampler.h"
+
+// stl
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+
+// Vertex and index buffers of a sampled surface, ready to upload as they are.
+// Vertices are interleaved: position, then the normal, either as three floats or octahedral
+// encoded in two 16 bit snorms. Triangles are given as a list, or as strips separated by
+// restart_index (GL_PRIMITIVE_RESTART).
+struct PackedMesh {
+    enum class Topology { Triangles, Strips };
+
+    static constexpr std::uint32_t                    restart_index {0xffffffff};
+
+    Topology                                          topology {Topology::Triangles};
+    bool                                              quantized {false};
+    int                                               stride {0};         // bytes per vertex
+    std::size_t                                       vertex_count {0};
+    std::size_t                                       triangle_count {0};
+
+    std::vector<unsigned char>                        vertices;
+    std::vector<std::uint32_t>                        indices;
+
+    std::size_t                                       getBytes() const;
+};
+
+
+// Post-tessellation stage between SurfaceSampler and the GPU.
+// A sample grid is regular, so there is no need for a general vertex cache optimizer: the
+// grid is walked in bands of columns narrow enough for two rows of a band to stay in the
+// post-transform cache, and each vertex is transformed about once. Row by row, as GMlib
+// does it, every vertex is transformed twice once a row no longer fits in the cache.
+// Strips are the default; they take a third of the index memory of a triangle list.
+namespace MeshOptimizer {
+
+    enum class Order { Rows, Bands };
+
+    struct Options {
+        PackedMesh::Topology                          topology {PackedMesh::Topology::Strips};
+        Order                                         order {Order::Bands};
+        int                                           cache_size {32};    // post-transform cache entries
+        bool                                          quantize_normals {true};
+    };
+
+    // Indices of an m1 x m2 grid of vertices, u major
+    std::vector<std::uint32_t>                        gridIndices( int m1, int m2, const Options& options );
+
+    void                                              pack( const SurfaceSamples& samples, const Options& options, PackedMesh& mesh );
+
+    // From what PSurfVisualizer::replot is given
+    void                                              pack( const GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+                                                            const GMlib::DMatrix<GMlib::Vector<float,3>>& normals,
+                                                            int m1, int m2, const Options& options, PackedMesh& mesh );
+
+    // Average cache miss ratio, vertex transforms per triangle, for a FIFO cache
+    double                                            acmr( const std::vector<std::uint32_t>& indices, std::size_t vertex_count,
+                                                            std::size_t triangle_count, int cache_size );
+
+    // Unit normal to two 16 bit snorms and back; a zero normal comes back as +z
+    void                                              encodeOctahedral( const GMlib::Vector<float,3>& normal, std::int16_t* encoded );
+    GMlib::Vector<float,3>                            decodeOctahedral( const std::int16_t* encoded );
+}
+
+#endif // MESHOPTIMIZER_H
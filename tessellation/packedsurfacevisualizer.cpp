@@ -0,0 +1,574 @@
+#include "packedsurfacevisualizer.h"
+
+// stl
+#include <algorithm>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+
+namespace {
+
+    const std::string program_name {"packed_surface_blinn_phong"};
+    const std::string instanced_program_name {"packed_surface_blinn_phong_instanced"};
+
+    // First of the eight vec4 instance attributes; bound explicitly, past those of the mesh
+    const GLuint instance_location {8};
+    const GLuint instance_attributes {8};
+
+    // Drawn when it, and every object above it, is visible
+    bool isShown( const GMlib::SceneObject* obj ) {
+
+        for( ; obj; obj = obj->getParent() )
+            if( !obj->isVisible() )
+                return false;
+
+        return true;
+    }
+
+    void copyColor( const GMlib::Color& color, float* to ) {
+
+        to[0] = float( color.getRedC() );
+        to[1] = float( color.getGreenC() );
+        to[2] = float( color.getBlueC() );
+        to[3] = float( color.getAlphaC() );
+    }
+
+    // General 4x4 inverse by cofactors; as the transpose of the inverse is the inverse of the
+    // transpose, it does not matter whether m is stored by rows or by columns
+    bool invert( const float* m, float* inverse ) {
+
+        float c[16];
+        c[0]  =  m[5]*m[10]*m[15] - m[5]*m[11]*m[14] - m[9]*m[6]*m[15] + m[9]*m[7]*m[14] + m[13]*m[6]*m[11] - m[13]*m[7]*m[10];
+        c[4]  = -m[4]*m[10]*m[15] + m[4]*m[11]*m[14] + m[8]*m[6]*m[15] - m[8]*m[7]*m[14] - m[12]*m[6]*m[11] + m[12]*m[7]*m[10];
+        c[8]  =  m[4]*m[9]*m[15]  - m[4]*m[11]*m[13] - m[8]*m[5]*m[15] + m[8]*m[7]*m[13] + m[12]*m[5]*m[11] - m[12]*m[7]*m[9];
+        c[12] = -m[4]*m[9]*m[14]  + m[4]*m[10]*m[13] + m[8]*m[5]*m[14] - m[8]*m[6]*m[13] - m[12]*m[5]*m[10] + m[12]*m[6]*m[9];
+        c[1]  = -m[1]*m[10]*m[15] + m[1]*m[11]*m[14] + m[9]*m[2]*m[15] - m[9]*m[3]*m[14] - m[13]*m[2]*m[11] + m[13]*m[3]*m[10];
+        c[5]  =  m[0]*m[10]*m[15] - m[0]*m[11]*m[14] - m[8]*m[2]*m[15] + m[8]*m[3]*m[14] + m[12]*m[2]*m[11] - m[12]*m[3]*m[10];
+        c[9]  = -m[0]*m[9]*m[15]  + m[0]*m[11]*m[13] + m[8]*m[1]*m[15] - m[8]*m[3]*m[13] - m[12]*m[1]*m[11] + m[12]*m[3]*m[9];
+        c[13] =  m[0]*m[9]*m[14]  - m[0]*m[10]*m[13] - m[8]*m[1]*m[14] + m[8]*m[2]*m[13] + m[12]*m[1]*m[10] - m[12]*m[2]*m[9];
+        c[2]  =  m[1]*m[6]*m[15]  - m[1]*m[7]*m[14]  - m[5]*m[2]*m[15] + m[5]*m[3]*m[14] + m[13]*m[2]*m[7]  - m[13]*m[3]*m[6];
+        c[6]  = -m[0]*m[6]*m[15]  + m[0]*m[7]*m[14]  + m[4]*m[2]*m[15] - m[4]*m[3]*m[14] - m[12]*m[2]*m[7]  + m[12]*m[3]*m[6];
+        c[10] =  m[0]*m[5]*m[15]  - m[0]*m[7]*m[13]  - m[4]*m[1]*m[15] + m[4]*m[3]*m[13] + m[12]*m[1]*m[7]  - m[12]*m[3]*m[5];
+        c[14] = -m[0]*m[5]*m[14]  + m[0]*m[6]*m[13]  + m[4]*m[1]*m[14] - m[4]*m[2]*m[13] - m[12]*m[1]*m[6]  + m[12]*m[2]*m[5];
+        c[3]  = -m[1]*m[6]*m[11]  + m[1]*m[7]*m[10]  + m[5]*m[2]*m[11] - m[5]*m[3]*m[10] - m[9]*m[2]*m[7]   + m[9]*m[3]*m[6];
+        c[7]  =  m[0]*m[6]*m[11]  - m[0]*m[7]*m[10]  - m[4]*m[2]*m[11] + m[4]*m[3]*m[10] + m[8]*m[2]*m[7]   - m[8]*m[3]*m[6];
+        c[11] = -m[0]*m[5]*m[11]  + m[0]*m[7]*m[9]   + m[4]*m[1]*m[11] - m[4]*m[3]*m[9]  - m[8]*m[1]*m[7]   + m[8]*m[3]*m[5];
+        c[15] =  m[0]*m[5]*m[10]  - m[0]*m[6]*m[9]   - m[4]*m[1]*m[10] + m[4]*m[2]*m[9]  + m[8]*m[1]*m[6]   - m[8]*m[2]*m[5];
+
+        const auto det = m[0] * c[0] + m[1] * c[4] + m[2] * c[8] + m[3] * c[12];
+        if( det == 0.0f )
+            return false;
+
+        for( auto i = 0; i < 16; ++i )
+            inverse[i] = c[i] / det;
+        return true;
+    }
+}
+
+
+
+unsigned int PackedSurfaceVisualizer::_frame {1};
+
+PackedSurfaceVisualizer::PackedSurfaceVisualizer( const MeshOptimizer::Options& options ) : _options(options) {
+
+    initShaderProgram();
+    initInstancedShaderProgram();
+
+    _prog.acquire( program_name );
+    _color_prog.acquire( "color" );
+    _instanced_prog.acquire( instanced_program_name );
+
+    _vbo.create();
+    _ibo.create();
+    _instance_vbo.create();
+}
+
+void PackedSurfaceVisualizer::render( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const {
+
+    if( !_index_count )
+        return;
+
+    if( _instanced && _users.size() > 1 )
+        renderInstanced( obj, renderer );
+    else
+        renderSingle( obj, renderer );
+}
+
+void PackedSurfaceVisualizer::renderSingle( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const {
+
+    const auto cam   = renderer->getCamera();
+    const auto& mvmat = obj->getModelViewMatrix(cam);
+    const auto& pmat  = obj->getProjectionMatrix(cam);
+
+    this->glSetDisplayMode();
+
+    _prog.bind(); {
+
+        _prog.uniform( "u_mvmat", mvmat );
+        _prog.uniform( "u_mvpmat", pmat * mvmat );
+        _prog.uniform( "u_octahedral", int(_quantized) );
+
+        const auto& m = obj->getMaterial();
+        _prog.uniform( "u_mat_amb", m.getAmb() );
+        _prog.uniform( "u_mat_dif", m.getDif() );
+        _prog.uniform( "u_mat_spc", m.getSpc() );
+        _prog.uniform( "u_mat_shi", m.getShininess() );
+
+        auto vertex_loc = _prog.getAttributeLocation( "in_vertex" );
+        auto normal_loc = _prog.getAttributeLocation( "in_normal" );
+
+        enableAttributes( vertex_loc, &normal_loc );
+        draw();
+        _vbo.disable( vertex_loc );
+        _vbo.disable( normal_loc );
+        _vbo.unbind();
+
+    } _prog.unbind();
+}
+
+void PackedSurfaceVisualizer::renderInstanced( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const {
+
+    // Drawn along with the first user this frame
+    if( _drawn_frame == _frame )
+        return;
+
+    // Without a view matrix, from a camera scaled flat, each surface is drawn on its own
+    const auto cam = renderer->getCamera();
+    GMlib::HqMatrix<float,3> view;
+    if( !getViewMatrix( cam, view ) ) {
+        renderSingle( obj, renderer );
+        return;
+    }
+    _drawn_frame = _frame;
+
+    updateInstances();
+    if( _instances.empty() )
+        return;
+
+    this->glSetDisplayMode();
+
+    _instanced_prog.bind(); {
+
+        _instanced_prog.uniform( "u_view", view );
+        _instanced_prog.uniform( "u_pmat", obj->getProjectionMatrix(cam) );
+        _instanced_prog.uniform( "u_octahedral", int(_quantized) );
+
+        auto vertex_loc = _instanced_prog.getAttributeLocation( "in_vertex" );
+        auto normal_loc = _instanced_prog.getAttributeLocation( "in_normal" );
+
+        enableAttributes( vertex_loc, &normal_loc );
+
+        _instance_vbo.bind();
+        for( GLuint i = 0; i < instance_attributes; ++i ) {
+            glEnableVertexAttribArray( instance_location + i );
+            glVertexAttribPointer( instance_location + i, 4, GL_FLOAT, GL_FALSE, GLsizei( sizeof(Instance) ),
+                                   reinterpret_cast<const GLvoid*>( i * 4 * sizeof(GLfloat) ) );
+            glVertexAttribDivisor( instance_location + i, 1 );
+        }
+
+        draw( GLsizei( _instances.size() ) );
+
+        for( GLuint i = 0; i < instance_attributes; ++i ) {
+            glVertexAttribDivisor( instance_location + i, 0 );
+            glDisableVertexAttribArray( instance_location + i );
+        }
+        _instance_vbo.unbind();
+
+        _vbo.disable( vertex_loc );
+        _vbo.disable( normal_loc );
+        _vbo.unbind();
+
+    } _instanced_prog.unbind();
+}
+
+void PackedSurfaceVisualizer::updateInstances() const {
+
+    _shown.clear();
+    for( auto obj : _users )
+        if( isShown(obj) )
+            _shown.push_back(obj);
+
+    auto instance = []( const GMlib::SceneObject* obj ) {
+
+        Instance i;
+        const auto model = getModelMatrix(obj);
+        const auto m = model.getPtr();
+        for( auto row = 0; row < 4; ++row )
+            for( auto col = 0; col < 4; ++col )
+                i.model[col * 4 + row] = m[row * 4 + col];
+
+        const auto& material = obj->getMaterial();
+        copyColor( material.getAmb(), i.amb );
+        copyColor( material.getDif(), i.dif );
+        copyColor( material.getSpc(), i.spc );
+        i.shininess[0] = float( material.getShininess() );
+        i.shininess[1] = i.shininess[2] = i.shininess[3] = 0.0f;
+        return i;
+    };
+
+    // Other surfaces shown, or in another order: all of it
+    if( _shown != _drawn ) {
+
+        _drawn = _shown;
+        _instances.resize( _drawn.size() );
+        for( size_t i = 0; i < _drawn.size(); ++i )
+            _instances[i] = instance( _drawn[i] );
+
+        _instance_vbo.bufferData( GLsizeiptr( _instances.size() * sizeof(Instance) ), _instances.data(), GL_DYNAMIC_DRAW );
+        return;
+    }
+
+    // Else the instances that changed, one upload for each run of them
+    auto upload = [this]( size_t begin, size_t end ) {
+        _instance_vbo.bufferSubData( GLintptr( begin * sizeof(Instance) ), GLsizeiptr( ( end - begin ) * sizeof(Instance) ),
+                                     _instances.data() + begin );
+    };
+
+    auto run = _instances.size();
+    for( size_t i = 0; i < _instances.size(); ++i ) {
+
+        const auto current = instance( _drawn[i] );
+        if( std::memcmp( &current, &_instances[i], sizeof(Instance) ) == 0 ) {
+            if( run < i )
+                upload( run, i );
+            run = _instances.size();
+            continue;
+        }
+
+        _instances[i] = current;
+        run = std::min( run, i );
+    }
+    if( run < _instances.size() )
+        upload( run, _instances.size() );
+}
+
+void PackedSurfaceVisualizer::renderGeometry( const GMlib::SceneObject* obj, const GMlib::Renderer* renderer,
+                                              const GMlib::Color& color ) const {
+
+    if( !_index_count )
+        return;
+
+    _color_prog.bind(); {
+
+        _color_prog.uniform( "u_color", color );
+        _color_prog.uniform( "u_mvpmat", obj->getModelViewProjectionMatrix( renderer->getCamera() ) );
+
+        auto vertex_loc = _color_prog.getAttributeLocation( "in_vertex" );
+
+        enableAttributes( vertex_loc, nullptr );
+        draw();
+        _vbo.disable( vertex_loc );
+        _vbo.unbind();
+
+    } _color_prog.unbind();
+}
+
+void PackedSurfaceVisualizer::replot( const GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+                                      const GMlib::DMatrix<GMlib::Vector<float,3>>& normals,
+                                      int m1, int m2, int /*d1*/, int /*d2*/,
+                                      bool /*closed_u*/, bool /*closed_v*/ ) {
+
+    PackedMesh mesh;
+    MeshOptimizer::pack( p, normals, m1, m2, _options, mesh );
+
+    _vbo.bufferData( GLsizeiptr( mesh.vertices.size() ), mesh.vertices.data(), GL_STATIC_DRAW );
+    _ibo.bufferData( GLsizeiptr( mesh.indices.size() * sizeof(std::uint32_t) ), mesh.indices.data(), GL_STATIC_DRAW );
+
+    _topology     = mesh.topology;
+    _quantized    = mesh.quantized;
+    _stride       = mesh.stride;
+    _index_count  = GLsizei( mesh.indices.size() );
+    _vertex_bytes = mesh.vertices.size();
+    _index_bytes  = mesh.indices.size() * sizeof(std::uint32_t);
+}
+
+std::size_t PackedSurfaceVisualizer::getVertexBytes() const { return _vertex_bytes; }
+
+std::size_t PackedSurfaceVisualizer::getIndexBytes() const { return _index_bytes; }
+
+void PackedSurfaceVisualizer::setInstanced( bool instanced ) { _instanced = instanced; }
+
+bool PackedSurfaceVisualizer::isInstanced() const { return _instanced; }
+
+void PackedSurfaceVisualizer::addUser( const GMlib::SceneObject* obj ) {
+
+    if( std::find( _users.begin(), _users.end(), obj ) == _users.end() )
+        _users.push_back(obj);
+}
+
+void PackedSurfaceVisualizer::removeUser( const GMlib::SceneObject* obj ) {
+
+    _users.erase( std::remove( _users.begin(), _users.end(), obj ), _users.end() );
+
+    // Not to be taken for the same surface, should another one come at its address
+    _drawn.clear();
+}
+
+void PackedSurfaceVisualizer::beginFrame() { ++_frame; }
+
+GMlib::HqMatrix<float,3> PackedSurfaceVisualizer::getModelMatrix( const GMlib::SceneObject* obj ) {
+
+    // The scale is applied in the object's own frame, after its matrix; GMlib only hands it out non-const
+    const auto scale = const_cast<GMlib::SceneObject*>(obj)->getScale().getScale();
+
+    auto model = obj->getMatrixToScene();
+    auto m = model.getPtr();
+    for( auto row = 0; row < 3; ++row )
+        for( auto col = 0; col < 3; ++col )
+            m[row * 4 + col] *= scale[col];
+
+    return model;
+}
+
+void PackedSurfaceVisualizer::getNormalMatrix( const GMlib::HqMatrix<float,3>& model, float* normal ) {
+
+    const auto m = model.getPtr();
+    auto a = [m]( int row, int col ) { return m[row * 4 + col]; };
+
+    for( auto row = 0; row < 3; ++row )
+        for( auto col = 0; col < 3; ++col ) {
+            const auto r0 = ( row + 1 ) % 3, r1 = ( row + 2 ) % 3;
+            const auto c0 = ( col + 1 ) % 3, c1 = ( col + 2 ) % 3;
+            normal[row * 3 + col] = a(r0,c0) * a(r1,c1) - a(r0,c1) * a(r1,c0);
+        }
+
+    const auto det = a(0,0) * normal[0] + a(0,1) * normal[1] + a(0,2) * normal[2];
+    if( det < 0.0f )
+        for( auto i = 0; i < 9; ++i )
+            normal[i] = -normal[i];
+}
+
+bool PackedSurfaceVisualizer::getViewMatrix( const GMlib::Camera* cam, GMlib::HqMatrix<float,3>& view ) {
+
+    if( !invert( getModelMatrix(cam).getPtr(), view.getPtr() ) )
+        return false;
+
+    view = cam->getModelViewMatrix(cam) * view;
+    return true;
+}
+
+void PackedSurfaceVisualizer::draw( GLsizei instances ) const {
+
+    const auto mode = _topology == PackedMesh::Topology::Strips ? GL_TRIANGLE_STRIP : GL_TRIANGLES;
+
+    _ibo.bind();
+
+    if( _topology == PackedMesh::Topology::Strips ) {
+        glEnable( GL_PRIMITIVE_RESTART );
+        glPrimitiveRestartIndex( PackedMesh::restart_index );
+    }
+
+    if( instances > 0 )
+        glDrawElementsInstanced( mode, _index_count, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(0x0), instances );
+    else
+        glDrawElements( mode, _index_count, GL_UNSIGNED_INT, reinterpret_cast<const GLvoid*>(0x0) );
+
+    if( _topology == PackedMesh::Topology::Strips )
+        glDisable( GL_PRIMITIVE_RESTART );
+
+    _ibo.unbind();
+}
+
+void PackedSurfaceVisualizer::enableAttributes( const GMlib::GL::AttributeLocation& vertex_loc,
+                                                const GMlib::GL::AttributeLocation* normal_loc ) const {
+
+    const auto normal_offset = reinterpret_cast<const GLvoid*>( 3 * sizeof(GLfloat) );
+
+    _vbo.bind();
+    _vbo.enable( vertex_loc, 3, GL_FLOAT, GL_FALSE, _stride, reinterpret_cast<const GLvoid*>(0x0) );
+    if( normal_loc ) {
+        if( _quantized )
+            _vbo.enable( *normal_loc, 2, GL_SHORT, GL_TRUE, _stride, normal_offset );
+        else
+            _vbo.enable( *normal_loc, 3, GL_FLOAT, GL_FALSE, _stride, normal_offset );
+    }
+}
+
+void PackedSurfaceVisualizer::initShaderProgram() {
+
+    GMlib::GL::Program prog;
+    if( prog.acquire( program_name ) )
+        return;
+
+    const std::string vs_src (
+        "uniform mat4 u_mvmat;\n"
+        "uniform mat4 u_mvpmat;\n"
+        "uniform int  u_octahedral;\n"
+        "\n"
+        "in vec4 in_vertex;\n"
+        "in vec3 in_normal;\n"
+        "\n"
+        "out vec3 ex_pos;\n"
+        "out vec3 ex_normal;\n"
+        "\n"
+        "vec3 octahedral( vec2 e ) {\n"
+        "\n"
+        "  vec3 n = vec3( e, 1.0 - abs(e.x) - abs(e.y) );\n"
+        "  if( n.z < 0.0 )\n"
+        "    n.xy = ( 1.0 - abs(e.yx) ) * vec2( e.x < 0.0 ? -1.0 : 1.0, e.y < 0.0 ? -1.0 : 1.0 );\n"
+        "  return normalize(n);\n"
+        "}\n"
+        "\n"
+        "void main() {\n"
+        "\n"
+        "  vec4 pos = u_mvmat * in_vertex;\n"
+        "  ex_pos = pos.xyz / pos.w;\n"
+        "\n"
+        "  // Float normals are zero at the poles, the fragment shader deals with that\n"
+        "  vec3 n = u_octahedral != 0 ? octahedral( in_normal.xy ) : in_normal;\n"
+        "  ex_normal = mat3(u_mvmat) * n;\n"
+        "\n"
+        "  gl_Position = u_mvpmat * in_vertex;\n"
+        "}\n"
+    );
+
+    const std::string fs_src (
+        "uniform vec4  u_mat_amb;\n"
+        "uniform vec4  u_mat_dif;\n"
+        "uniform vec4  u_mat_spc;\n"
+        "uniform float u_mat_shi;\n"
+        "\n"
+        "in vec3 ex_pos;\n"
+        "in vec3 ex_normal;\n"
+        "\n"
+        "out vec4 frag_color;\n"
+        "\n"
+        "void main() {\n"
+        "\n"
+        "  // Light at the camera, so light and view direction are the same\n"
+        "  vec3 v = normalize( -ex_pos );\n"
+        "  vec3 n = length(ex_normal) > 0.0 ? normalize(ex_normal) : v;\n"
+        "  if( !gl_FrontFacing ) n = -n;\n"
+        "\n"
+        "  float d = max( dot( n, v ), 0.0 );\n"
+        "  float s = d > 0.0 ? pow( d, u_mat_shi ) : 0.0;\n"
+        "\n"
+        "  frag_color = vec4( ( u_mat_amb + u_mat_dif * d + u_mat_spc * s ).rgb, u_mat_dif.a );\n"
+        "}\n"
+    );
+
+    GMlib::GL::VertexShader vshader;
+    vshader.create( program_name + "_vs" );
+    vshader.setPrerequisiteSource( GMlib::GL::OpenGLManager::glslDefHeader150Source() );
+    vshader.setSource( vs_src );
+    if( !vshader.compile() )
+        std::cerr << "PackedSurfaceVisualizer: " << vshader.getCompilerLog() << std::endl;
+
+    GMlib::GL::FragmentShader fshader;
+    fshader.create( program_name + "_fs" );
+    fshader.setPrerequisiteSource( GMlib::GL::OpenGLManager::glslDefHeader150Source() );
+    fshader.setSource( fs_src );
+    if( !fshader.compile() )
+        std::cerr << "PackedSurfaceVisualizer: " << fshader.getCompilerLog() << std::endl;
+
+    prog.create( program_name );
+    prog.attachShader( vshader );
+    prog.attachShader( fshader );
+    if( !prog.link() )
+        std::cerr << "PackedSurfaceVisualizer: " << prog.getLinkerLog() << std::endl;
+}
+
+void PackedSurfaceVisualizer::initInstancedShaderProgram() {
+
+    GMlib::GL::Program prog;
+    if( prog.acquire( instanced_program_name ) )
+        return;
+
+    // Instance attributes at fixed locations, so they can be set up without the program
+    const std::string vs_src (
+        "#extension GL_ARB_explicit_attrib_location : require\n"
+        "\n"
+        "uniform mat4 u_view;\n"
+        "uniform mat4 u_pmat;\n"
+        "uniform int  u_octahedral;\n"
+        "\n"
+        "in vec4 in_vertex;\n"
+        "in vec3 in_normal;\n"
+        "\n"
+        "layout(location = 8)  in vec4 in_model0;\n"
+        "layout(location = 9)  in vec4 in_model1;\n"
+        "layout(location = 10) in vec4 in_model2;\n"
+        "layout(location = 11) in vec4 in_model3;\n"
+        "layout(location = 12) in vec4 in_mat_amb;\n"
+        "layout(location = 13) in vec4 in_mat_dif;\n"
+        "layout(location = 14) in vec4 in_mat_spc;\n"
+        "layout(location = 15) in vec4 in_mat_shi;\n"
+        "\n"
+        "out vec3 ex_pos;\n"
+        "out vec3 ex_normal;\n"
+        "flat out vec4  ex_mat_amb;\n"
+        "flat out vec4  ex_mat_dif;\n"
+        "flat out vec4  ex_mat_spc;\n"
+        "flat out float ex_mat_shi;\n"
+        "\n"
+        "vec3 octahedral( vec2 e ) {\n"
+        "\n"
+        "  vec3 n = vec3( e, 1.0 - abs(e.x) - abs(e.y) );\n"
+        "  if( n.z < 0.0 )\n"
+        "    n.xy = ( 1.0 - abs(e.yx) ) * vec2( e.x < 0.0 ? -1.0 : 1.0, e.y < 0.0 ? -1.0 : 1.0 );\n"
+        "  return normalize(n);\n"
+        "}\n"
+        "\n"
+        "void main() {\n"
+        "\n"
+        "  mat4 mvmat = u_view * mat4( in_model0, in_model1, in_model2, in_model3 );\n"
+        "\n"
+        "  vec4 pos = mvmat * in_vertex;\n"
+        "  ex_pos = pos.xyz / pos.w;\n"
+        "\n"
+        "  vec3 n = u_octahedral != 0 ? octahedral( in_normal.xy ) : in_normal;\n"
+        "  ex_normal = mat3(mvmat) * n;\n"
+        "\n"
+        "  ex_mat_amb = in_mat_amb;\n"
+        "  ex_mat_dif = in_mat_dif;\n"
+        "  ex_mat_spc = in_mat_spc;\n"
+        "  ex_mat_shi = in_mat_shi.x;\n"
+        "\n"
+        "  gl_Position = u_pmat * pos;\n"
+        "}\n"
+    );
+
+    const std::string fs_src (
+        "in vec3 ex_pos;\n"
+        "in vec3 ex_normal;\n"
+        "flat in vec4  ex_mat_amb;\n"
+        "flat in vec4  ex_mat_dif;\n"
+        "flat in vec4  ex_mat_spc;\n"
+        "flat in float ex_mat_shi;\n"
+        "\n"
+        "out vec4 frag_color;\n"
+        "\n"
+        "void main() {\n"
+        "\n"
+        "  vec3 v = normalize( -ex_pos );\n"
+        "  vec3 n = length(ex_normal) > 0.0 ? normalize(ex_normal) : v;\n"
+        "  if( !gl_FrontFacing ) n = -n;\n"
+        "\n"
+        "  float d = max( dot( n, v ), 0.0 );\n"
+        "  float s = d > 0.0 ? pow( d, ex_mat_shi ) : 0.0;\n"
+        "\n"
+        "  frag_color = vec4( ( ex_mat_amb + ex_mat_dif * d + ex_mat_spc * s ).rgb, ex_mat_dif.a );\n"
+        "}\n"
+    );
+
+    GMlib::GL::VertexShader vshader;
+    vshader.create( instanced_program_name + "_vs" );
+    vshader.setPrerequisiteSource( GMlib::GL::OpenGLManager::glslDefHeader150Source() );
+    vshader.setSource( vs_src );
+    if( !vshader.compile() )
+        std::cerr << "PackedSurfaceVisualizer: " << vshader.getCompilerLog() << std::endl;
+
+    GMlib::GL::FragmentShader fshader;
+    fshader.create( instanced_program_name + "_fs" );
+    fshader.setPrerequisiteSource( GMlib::GL::OpenGLManager::glslDefHeader150Source() );
+    fshader.setSource( fs_src );
+    if( !fshader.compile() )
+        std::cerr << "PackedSurfaceVisualizer: " << fshader.getCompilerLog() << std::endl;
+
+    prog.create( instanced_program_name );
+    prog.attachShader( vshader );
+    prog.attachShader( fshader );
+    if( !prog.link() )
+        std::cerr << "PackedSurfaceVisualizer: " << prog.getLinkerLog() << std::endl;
+}
@@ -0,0 +1,108 @@
+#ifndef PACKEDSURFACEVISUALIZER_H
+#define PACKEDSURFACEVISUALIZER_H
+
+
+#include "meshoptimizer.h"
+
+// gmlib
+#include <gmOpenglModule>
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+// stl
+#include <vector>
+
+
+// Draws a surface from a PackedMesh: one interleaved vertex buffer and cache ordered indices,
+// instead of the vertex buffer, strip indices and normal map texture of the default visualizer.
+// Shaded Blinn-Phong with the material of the object, lit from the camera.
+//
+// Instanced, the visualizer draws every surface using it in one call: the first of them drawn
+// in a frame draws them all, the rest draw nothing. Model matrix and material of each come from
+// an instance buffer, rewritten where they changed since the last frame, so the calls per frame
+// do not grow with the number of surfaces sharing the mesh. Picking still draws them one by one.
+class PackedSurfaceVisualizer : public GMlib::PSurfVisualizer<float,3> {
+    GM_VISUALIZER(PackedSurfaceVisualizer)
+public:
+    explicit PackedSurfaceVisualizer( const MeshOptimizer::Options& options = MeshOptimizer::Options() );
+
+    void                                              render( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const override;
+    void                                              renderGeometry( const GMlib::SceneObject* obj, const GMlib::Renderer* renderer,
+                                                                      const GMlib::Color& color ) const override;
+
+    void                                              replot( const GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>& p,
+                                                              const GMlib::DMatrix<GMlib::Vector<float,3>>& normals,
+                                                              int m1, int m2, int d1, int d2,
+                                                              bool closed_u, bool closed_v ) override;
+
+    // Size of the uploaded buffers
+    std::size_t                                       getVertexBytes() const;
+    std::size_t                                       getIndexBytes() const;
+
+    void                                              setInstanced( bool instanced );
+    bool                                              isInstanced() const;
+
+    // The surfaces drawing with the visualizer; drawn with the first of them when instanced
+    void                                              addUser( const GMlib::SceneObject* obj );
+    void                                              removeUser( const GMlib::SceneObject* obj );
+
+    // Render thread, before each frame is rendered
+    static void                                       beginFrame();
+
+    // Object to scene, with the scale GMlib draws the object with
+    static GMlib::HqMatrix<float,3>                   getModelMatrix( const GMlib::SceneObject* obj );
+
+    // For the normals of a model matrix, row major 3 x 3: the cofactors of its upper left 3 x 3,
+    // which is the inverse transpose times the determinant, with its sign. Normals are to be normalized after.
+    static void                                       getNormalMatrix( const GMlib::HqMatrix<float,3>& model, float* normal );
+
+    // Scene to eye of cam: the model view matrix of the camera without its own model matrix.
+    // false for a camera scaled flat
+    static bool                                       getViewMatrix( const GMlib::Camera* cam, GMlib::HqMatrix<float,3>& view );
+
+private:
+    // Columns of the model matrix, then the material; one vec4 attribute each
+    struct Instance {
+        float                                         model[16];
+        float                                         amb[4];
+        float                                         dif[4];
+        float                                         spc[4];
+        float                                         shininess[4];
+    };
+
+    MeshOptimizer::Options                            _options;
+
+    GMlib::GL::Program                                _prog;
+    GMlib::GL::Program                                _color_prog;
+    GMlib::GL::Program                                _instanced_prog;
+    GMlib::GL::VertexBufferObject                     _vbo;
+    GMlib::GL::IndexBufferObject                      _ibo;
+
+    PackedMesh::Topology                              _topology {PackedMesh::Topology::Triangles};
+    bool                                              _quantized {false};
+    int                                               _stride {0};
+    GLsizei                                           _index_count {0};
+    std::size_t                                       _vertex_bytes {0};
+    std::size_t                                       _index_bytes {0};
+
+    bool                                              _instanced {true};
+    std::vector<const GMlib::SceneObject*>            _users;
+    mutable std::vector<const GMlib::SceneObject*>    _shown;
+    mutable std::vector<const GMlib::SceneObject*>    _drawn;     // in instance buffer order
+    mutable std::vector<Instance>                     _instances;
+    mutable GMlib::GL::VertexBufferObject             _instance_vbo;
+    mutable unsigned int                              _drawn_frame {0};
+
+    static unsigned int                               _frame;
+
+    void                                              renderSingle( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const;
+    void                                              renderInstanced( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const;
+    void                                              updateInstances() const;
+    void                                              draw( GLsizei instances = 0 ) const;
+    void                                              enableAttributes( const GMlib::GL::AttributeLocation& vertex_loc,
+                                                                        const GMlib::GL::AttributeLocation* normal_loc ) const;
+    static void                                       initShaderProgram();
+    static void                                       initInstancedShaderProgram();
+};
+
+#endif // PACKEDSURFACEVISUALIZER_H
@@ -0,0 +1,258 @@
+#include "replotstats.h"
+#include "packedsurfacevisualizer.h"
+
+// gmlib
+#include <gmParametricsModule>
+
+// stl
+#include <algorithm>
+#include <iomanip>
+#include <set>
+#include <sstream>
+
+
+namespace {
+
+    // Position and partial derivatives per sample
+    double termsPerSample( int d1, int d2 ) { return double(d1 + 1) * double(d2 + 1); }
+
+    double seconds( std::chrono::steady_clock::duration d ) {
+
+        return std::chrono::duration<double>(d).count();
+    }
+}
+
+
+
+ReplotStats::ReplotStats() : _started( std::chrono::steady_clock::now() ) {}
+
+void ReplotStats::record( const GMlib::PSurf<float,3>* surface, int m1, int m2,
+                          int requested_d1, int requested_d2, int evaluated_d1, int evaluated_d2,
+                          const GMlib::PSurf<float,3>* mesh ) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto& r = _records[surface];
+    auto previous = r.mesh;
+
+    r.identity    = surface->getIdentity();
+    r.samples_u   = m1;
+    r.samples_v   = m2;
+    r.requested_u = requested_d1;
+    r.requested_v = requested_d2;
+    r.evaluated_u = evaluated_d1;
+    r.evaluated_v = evaluated_d2;
+    r.mesh        = mesh;
+    ++r.replots;
+
+    if( previous && previous != mesh )
+        release(previous);
+}
+
+void ReplotStats::tessellated( const GMlib::PSurf<float,3>* mesh, int m1, int m2, int pass,
+                               double sample_time, double upload_time ) {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    // A pass no later than the last one is the start of a new request
+    auto& m = _meshes[mesh];
+    if( pass < m.passes )
+        m.upload_time = 0.0;
+
+    // Sampling time is carried over from pass to pass, uploads add up here
+    m.samples_u    = m1;
+    m.samples_v    = m2;
+    m.sample_time  = sample_time;
+    m.upload_time += upload_time;
+    m.passes       = pass + 1;
+    m.uploaded     = std::chrono::steady_clock::now();
+    measure( mesh, m );
+}
+
+void ReplotStats::forget( const GMlib::SceneObject* obj ) {
+
+    if( !obj ) return;
+
+    auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        forget( children(i) );
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    auto record = _records.find(obj);
+    if( record == _records.end() )
+        return;
+
+    auto mesh = record->second.mesh;
+    _records.erase(record);
+    if( mesh )
+        release(mesh);
+}
+
+void ReplotStats::clear() {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    _records.clear();
+    _meshes.clear();
+}
+
+std::vector<ReplotStats::Row> ReplotStats::getRows() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return rows();
+}
+
+ReplotStats::Totals ReplotStats::getTotals() const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    return totals();
+}
+
+void ReplotStats::print( std::ostream& os ) const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    os << std::left << std::setw(12) << "surface" << std::setw(14) << "object" << std::right
+       << std::setw(12) << "samples" << std::setw(12) << "requested" << std::setw(12) << "evaluated"
+       << std::setw(10) << "replots" << std::setw(10) << "ms" << std::setw(10) << "KiB" << std::endl;
+
+    auto requested = 0.0;
+    auto evaluated = 0.0;
+    for( const auto& record : _records ) {
+
+        const auto& r = record.second;
+        auto mesh = _meshes.find(r.mesh);
+        auto time = mesh != _meshes.end() ? mesh->second.sample_time + mesh->second.upload_time : 0.0;
+        auto kib  = mesh != _meshes.end() ? double( mesh->second.vertex_bytes + mesh->second.index_bytes ) / 1024.0 : 0.0;
+
+        os << std::left << std::setw(12) << r.identity << std::setw(14) << record.first << std::right
+           << std::setw(7) << r.samples_u << " x " << std::setw(2) << r.samples_v
+           << std::setw(7) << r.requested_u << " x " << std::setw(2) << r.requested_v
+           << std::setw(7) << r.evaluated_u << " x " << std::setw(2) << r.evaluated_v
+           << std::setw(10) << r.replots
+           << std::fixed << std::setprecision(2) << std::setw(10) << time << std::setw(10) << kib
+           << std::defaultfloat << std::endl;
+
+        const auto samples = double(r.samples_u) * double(r.samples_v);
+        requested += samples * termsPerSample( r.requested_u, r.requested_v );
+        evaluated += samples * termsPerSample( r.evaluated_u, r.evaluated_v );
+    }
+
+    auto t = totals();
+    os << _records.size() << " surfaces, " << std::setprecision(3) << evaluated / 1.0e6 << "M of "
+       << requested / 1.0e6 << "M requested derivative terms evaluated" << std::endl;
+    os << t.meshes << " meshes, " << t.time << " ms tessellating, "
+       << double( t.vertex_bytes + t.index_bytes ) / double(1 << 20) << " MiB of vertices and indices" << std::endl;
+}
+
+void ReplotStats::writeCsv( std::ostream& os ) const {
+
+    std::lock_guard<std::mutex> lock(_mutex);
+
+    os << "object,identity,samples_u,samples_v,time_ms,vertex_bytes,index_bytes,uploaded_s,age_s,replots,shared\n";
+    for( const auto& r : rows() )
+        os << r.object << ',' << r.identity << ',' << r.samples_u << ',' << r.samples_v << ','
+           << r.time << ',' << r.vertex_bytes << ',' << r.index_bytes << ','
+           << r.uploaded << ',' << r.age << ',' << r.replots << ',' << r.shared << '\n';
+
+    auto t = totals();
+    os << "total,,,," << t.time << ',' << t.vertex_bytes << ',' << t.index_bytes << ",,,,\n";
+}
+
+std::vector<ReplotStats::Row> ReplotStats::rows() const {
+
+    std::map<const GMlib::PSurf<float,3>*,int> users;
+    for( const auto& record : _records )
+        ++users[record.second.mesh];
+
+    const auto now = std::chrono::steady_clock::now();
+
+    std::vector<Row> rows;
+    rows.reserve( _records.size() );
+    for( const auto& record : _records ) {
+
+        const auto& r = record.second;
+
+        std::ostringstream object;
+        object << r.identity << " " << record.first;
+
+        Row row;
+        row.object    = object.str();
+        row.identity  = r.identity;
+        row.samples_u = r.samples_u;
+        row.samples_v = r.samples_v;
+        row.replots   = r.replots;
+        row.shared    = users[r.mesh];
+
+        auto mesh = _meshes.find(r.mesh);
+        if( mesh != _meshes.end() ) {
+
+            const auto& m = mesh->second;
+            row.samples_u    = m.samples_u;
+            row.samples_v    = m.samples_v;
+            row.time         = m.sample_time + m.upload_time;
+            row.vertex_bytes = m.vertex_bytes;
+            row.index_bytes  = m.index_bytes;
+            row.uploaded     = seconds( m.uploaded - _started );
+            row.age          = seconds( now - m.uploaded );
+        }
+
+        rows.push_back(row);
+    }
+
+    return rows;
+}
+
+ReplotStats::Totals ReplotStats::totals() const {
+
+    // Shared meshes once
+    std::set<const GMlib::PSurf<float,3>*> meshes;
+    for( const auto& record : _records )
+        meshes.insert( record.second.mesh );
+
+    Totals t;
+    t.surfaces = _records.size();
+    for( auto mesh : meshes ) {
+
+        auto m = _meshes.find(mesh);
+        if( m == _meshes.end() )
+            continue;
+
+        ++t.meshes;
+        t.time         += m->second.sample_time + m->second.upload_time;
+        t.vertex_bytes += m->second.vertex_bytes;
+        t.index_bytes  += m->second.index_bytes;
+    }
+
+    return t;
+}
+
+void ReplotStats::release( const GMlib::PSurf<float,3>* mesh ) {
+
+    for( const auto& record : _records )
+        if( record.second.mesh == mesh )
+            return;
+
+    _meshes.erase(mesh);
+}
+
+void ReplotStats::measure( const GMlib::PSurf<float,3>* mesh, Mesh& m ) {
+
+    const auto& visualizers = mesh->getVisualizers();
+    for( auto i = 0; i < visualizers.getSize(); ++i ) {
+
+        if( auto packed = dynamic_cast<const PackedSurfaceVisualizer*>( visualizers(i) ) ) {
+            m.vertex_bytes = packed->getVertexBytes();
+            m.index_bytes  = packed->getIndexBytes();
+            return;
+        }
+    }
+
+    // The default visualizer: position and texture coordinates, a float normal map texel per
+    // sample, and a triangle strip per row
+    const auto m1 = std::max( m.samples_u, 2 );
+    const auto m2 = std::max( m.samples_v, 2 );
+    m.vertex_bytes = size_t(m1) * size_t(m2) * 8 * sizeof(float);
+    m.index_bytes  = size_t(m1 - 1) * size_t(m2) * 2 * sizeof(unsigned int);
+}
@@ -0,0 +1,108 @@
+#ifndef REPLOTSTATS_H
+#define REPLOTSTATS_H
+
+
+// gmlib; declared only, the ui thread reads the stats through Scenario
+namespace GMlib {
+
+class SceneObject;
+template <typename T, int n> class PSurf;
+}
+
+// stl
+#include <chrono>
+#include <cstddef>
+#include <map>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <vector>
+
+
+// What was asked of the latest replot of each surface, what was actually evaluated, and what
+// the mesh it draws cost: sampling and upload time, and vertex and index memory.
+// Evaluation cost grows with the number of partial derivatives per sample, (d1+1) x (d2+1).
+//
+// The mesh of a surface is either its own, or one shared through the MeshCache; a shared mesh
+// is counted once in the totals. Rows and totals may be read from any thread.
+class ReplotStats {
+public:
+    struct Record {
+        std::string                                   identity;
+        int                                           samples_u {0};
+        int                                           samples_v {0};
+        int                                           requested_u {0};
+        int                                           requested_v {0};
+        int                                           evaluated_u {0};
+        int                                           evaluated_v {0};
+        unsigned int                                  replots {0};
+        const GMlib::PSurf<float,3>*                  mesh {nullptr};   // the surface, or the carrier of a shared mesh
+    };
+
+    struct Mesh {
+        int                                           samples_u {0};
+        int                                           samples_v {0};
+        double                                        sample_time {0.0};  // milliseconds, all passes
+        double                                        upload_time {0.0};
+        int                                           passes {0};
+        size_t                                        vertex_bytes {0};
+        size_t                                        index_bytes {0};
+        std::chrono::steady_clock::time_point         uploaded;
+    };
+
+    // One per surface, for display
+    struct Row {
+        std::string                                   object;
+        std::string                                   identity;
+        int                                           samples_u {0};
+        int                                           samples_v {0};
+        double                                        time {0.0};         // milliseconds, sampling and upload
+        size_t                                        vertex_bytes {0};
+        size_t                                        index_bytes {0};
+        double                                        uploaded {-1.0};    // seconds after the stats started, -1 before the first upload
+        double                                        age {-1.0};         // seconds since the last upload
+        unsigned int                                  replots {0};
+        int                                           shared {1};         // surfaces drawing the mesh
+    };
+
+    struct Totals {
+        size_t                                        surfaces {0};
+        size_t                                        meshes {0};
+        double                                        time {0.0};
+        size_t                                        vertex_bytes {0};
+        size_t                                        index_bytes {0};
+    };
+
+    ReplotStats();
+
+    void                                              record( const GMlib::PSurf<float,3>* surface, int m1, int m2,
+                                                              int requested_d1, int requested_d2, int evaluated_d1, int evaluated_d2,
+                                                              const GMlib::PSurf<float,3>* mesh );
+
+    // A pass of mesh was handed to its visualizers; pass 0 starts a new mesh
+    void                                              tessellated( const GMlib::PSurf<float,3>* mesh, int m1, int m2, int pass,
+                                                                   double sample_time, double upload_time );
+
+    void                                              forget( const GMlib::SceneObject* obj );
+    void                                              clear();
+
+    std::vector<Row>                                  getRows() const;
+    Totals                                            getTotals() const;
+
+    // One line per surface and a total
+    void                                              print( std::ostream& os ) const;
+    void                                              writeCsv( std::ostream& os ) const;
+
+private:
+    mutable std::mutex                                _mutex;
+    std::map<const GMlib::SceneObject*,Record>        _records;
+    std::map<const GMlib::PSurf<float,3>*,Mesh>       _meshes;
+    std::chrono::steady_clock::time_point             _started;
+
+    std::vector<Row>                                  rows() const;
+    Totals                                            totals() const;
+    void                                              release( const GMlib::PSurf<float,3>* mesh );
+    static void                                       measure( const GMlib::PSurf<float,3>* mesh, Mesh& m );
+};
+
+#endif // REPLOTSTATS_H
@@ -0,0 +1,268 @@
+#include "staticbatcher.h"
+#include "surfacesampler.h"
+#include "packedsurfacevisualizer.h"
+
+// stl
+#include <algorithm>
+#include <cstring>
+
+
+namespace {
+
+    bool drawsOwnMesh( const GMlib::PSurf<float,3>* surface ) {
+
+        auto visualizer = static_cast<const GMlib::Visualizer*>( surface->getDefaultVisualizer() );
+        const auto& visualizers = surface->getVisualizers();
+        for( auto i = 0; i < visualizers.getSize(); ++i )
+            if( visualizer && visualizers(i) == visualizer )
+                return true;
+
+        return false;
+    }
+}
+
+
+
+StaticBatcher::StaticBatcher() {}
+
+StaticBatcher::~StaticBatcher() { clear(); }
+
+bool StaticBatcher::add( GMlib::PSurf<float,3>* surface ) {
+
+    if( !surface || contains(surface) || !drawsOwnMesh(surface) || !SurfaceSampler::create(surface) )
+        return false;
+
+    std::unique_ptr<Member> member( new Member );
+    member->surface = surface;
+    member->m1 = surface->getSamplesU();
+    member->m2 = surface->getSamplesV();
+    member->d1 = surface->getDerivativesU();
+    member->d2 = surface->getDerivativesV();
+    std::fill( std::begin(member->matrix), std::end(member->matrix), 0.0f );
+
+    surface->enableDefaultVisualizer(false);
+    join( *member, batch( surface->getMaterial() ) );
+    _members[surface] = std::move(member);
+    return true;
+}
+
+void StaticBatcher::remove( GMlib::PSurf<float,3>* surface ) {
+
+    auto found = _members.find(surface);
+    if( found == _members.end() )
+        return;
+
+    leave( *found->second );
+    surface->enableDefaultVisualizer(true);
+    _members.erase(found);
+}
+
+bool StaticBatcher::contains( const GMlib::SceneObject* obj ) const { return _members.count(obj) > 0; }
+
+void StaticBatcher::release( GMlib::SceneObject* obj ) {
+
+    if( !obj ) return;
+
+    auto& children = obj->getChildren();
+    for( auto i = 0; i < children.getSize(); ++i )
+        release( children(i) );
+
+    if( auto surface = dynamic_cast<GMlib::PSurf<float,3>*>(obj) )
+        remove(surface);
+}
+
+void StaticBatcher::clear() {
+
+    _members.clear();
+    _batches.clear();
+    _stats = Stats();
+}
+
+bool StaticBatcher::replot( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 ) {
+
+    auto found = _members.find(surface);
+    if( found == _members.end() )
+        return false;
+
+    // Sampled again even at the same counts, as a replot would; the shape may have changed
+    auto& member = *found->second;
+    member.sampled = false;
+    member.m1 = m1;
+    member.m2 = m2;
+    member.d1 = d1;
+    member.d2 = d2;
+    return true;
+}
+
+void StaticBatcher::update() {
+
+    _stats.sampled = _stats.transformed = _stats.uploaded = 0;
+
+    for( auto& m : _members ) {
+
+        auto& member = *m.second;
+
+        // Another material, another batch
+        const auto& material = member.surface->getMaterial();
+        if( material != member.batch->material ) {
+            leave(member);
+            join( member, batch(material) );
+        }
+
+        if( !member.sampled ) {
+            sample(member);
+            member.batch->layout = true;
+            ++_stats.sampled;
+        }
+
+        const auto model = PackedSurfaceVisualizer::getModelMatrix( member.surface );
+        const auto matrix = model.getPtr();
+        if( member.changed || std::memcmp( matrix, member.matrix, sizeof(member.matrix) ) != 0 ) {
+            std::copy( matrix, matrix + 16, member.matrix );
+            transform(member);
+            member.changed = true;
+            ++_stats.transformed;
+        }
+    }
+
+    // Batches left without members go
+    _batches.erase( std::remove_if( _batches.begin(), _batches.end(),
+                                    []( const std::unique_ptr<Batch>& b ) { return b->members.empty(); } ),
+                    _batches.end() );
+
+    _stats.vertices = 0;
+    for( auto& b : _batches ) {
+
+        if( b->layout ) {
+            upload(*b);
+            ++_stats.uploaded;
+        }
+        else
+            for( auto member : b->members )
+                if( member->changed )
+                    b->visualizer->update( member->first, member->vertices );
+
+        for( auto member : b->members ) {
+            member->changed = false;
+            _stats.vertices += member->vertices.size() / 6;
+        }
+    }
+
+    _stats.batches = _batches.size();
+    _stats.members = _members.size();
+}
+
+const StaticBatcher::Stats& StaticBatcher::getStats() const { return _stats; }
+
+StaticBatcher::Batch* StaticBatcher::batch( const GMlib::Material& material ) {
+
+    for( auto& b : _batches )
+        if( b->material == material )
+            return b.get();
+
+    std::unique_ptr<Batch> b( new Batch );
+    b->material = material;
+    b->visualizer.reset( new StaticBatchVisualizer );
+    _batches.push_back( std::move(b) );
+    return _batches.back().get();
+}
+
+void StaticBatcher::join( Member& member, Batch* batch ) {
+
+    member.batch = batch;
+    member.changed = true;
+    batch->members.push_back(&member);
+    batch->layout = true;
+    member.surface->insertVisualizer( batch->visualizer.get() );
+}
+
+void StaticBatcher::leave( Member& member ) {
+
+    auto batch = member.batch;
+    member.surface->removeVisualizer( batch->visualizer.get() );
+    batch->members.erase( std::remove( batch->members.begin(), batch->members.end(), &member ), batch->members.end() );
+    batch->layout = true;
+    member.batch = nullptr;
+}
+
+void StaticBatcher::upload( Batch& batch ) {
+
+    std::vector<float>  vertices;
+    std::vector<GLuint> indices;
+    std::vector<StaticBatchVisualizer::Range> ranges;
+
+    for( auto member : batch.members ) {
+
+        member->first = vertices.size() / 6;
+        ranges.push_back( StaticBatchVisualizer::Range{ member->surface, indices.size(), member->indices.size() } );
+
+        vertices.insert( vertices.end(), member->vertices.begin(), member->vertices.end() );
+        for( auto i : member->indices )
+            indices.push_back( GLuint( member->first ) + i );
+    }
+
+    batch.visualizer->upload( vertices, indices, ranges );
+    batch.layout = false;
+}
+
+void StaticBatcher::sample( Member& member ) {
+
+    member.sampled = true;
+    member.changed = true;
+    member.local.clear();
+    member.indices.clear();
+
+    auto sampler = SurfaceSampler::create( member.surface );
+    if( !sampler || member.m1 < 2 || member.m2 < 2 )
+        return;
+
+    // Normals only take the first derivatives
+    const auto samples = sampler->sample( member.m1, member.m2, 1, 1 );
+    const auto m1 = samples->m1;
+    const auto m2 = samples->m2;
+
+    member.local.reserve( size_t(m1) * size_t(m2) * 6 );
+    for( auto i = 0; i < m1; ++i )
+        for( auto j = 0; j < m2; ++j ) {
+            const auto& p = samples->p[i][j][0][0];
+            const auto& n = samples->normals[i][j];
+            member.local.insert( member.local.end(), { p[0], p[1], p[2], n[0], n[1], n[2] } );
+        }
+
+    member.indices.reserve( size_t(m1 - 1) * size_t(m2 - 1) * 6 );
+    for( auto i = 0; i < m1 - 1; ++i )
+        for( auto j = 0; j < m2 - 1; ++j ) {
+            const auto a = GLuint( i * m2 + j );
+            const auto b = a + GLuint(m2);
+            member.indices.insert( member.indices.end(), { a, b, a + 1, a + 1, b, b + 1 } );
+        }
+
+    // As a replot would leave the surface, for the level of detail and culling
+    SurfaceSampler::adopt( member.surface, m1, m2, member.d1, member.d2, samples->sphere );
+}
+
+void StaticBatcher::transform( Member& member ) {
+
+    // To the scene, scaled as the surface is drawn; the normals by the inverse transpose,
+    // which keeps them normal to a surface scaled unevenly
+    const auto matrix = PackedSurfaceVisualizer::getModelMatrix( member.surface );
+    float t[9];
+    PackedSurfaceVisualizer::getNormalMatrix( matrix, t );
+
+    member.vertices.resize( member.local.size() );
+    for( size_t i = 0; i < member.local.size(); i += 6 ) {
+
+        const auto l = member.local.data() + i;
+        const auto p = matrix * GMlib::Point<float,3>( l[0], l[1], l[2] );
+        auto n = GMlib::Vector<float,3>( t[0] * l[3] + t[1] * l[4] + t[2] * l[5],
+                                         t[3] * l[3] + t[4] * l[4] + t[5] * l[5],
+                                         t[6] * l[3] + t[7] * l[4] + t[8] * l[5] );
+        const auto length = n.getLength();
+        if( length > 0.0f )
+            n = n / length;
+
+        auto v = member.vertices.data() + i;
+        v[0] = p[0]; v[1] = p[1]; v[2] = p[2];
+        v[3] = n[0]; v[4] = n[1]; v[5] = n[2];
+    }
+}
@@ -0,0 +1,102 @@
+#ifndef STATICBATCHER_H
+#define STATICBATCHER_H
+
+
+#include "staticbatchvisualizer.h"
+
+// gmlib
+#include <gmSceneModule>
+#include <gmParametricsModule>
+
+// stl
+#include <map>
+#include <memory>
+#include <vector>
+
+
+// Merges the tessellations of static surfaces into one vertex and index buffer for each
+// material, in scene space, drawn by a StaticBatchVisualizer with one call a batch instead of
+// one a surface. Surfaces are static by choice; they may still be moved or edited, it is only
+// that every change costs an upload.
+//
+// Members are sampled on the render thread, at what replots ask of them, and keep their local
+// samples. At each update a member that moved or was scaled is transformed again, one
+// replotted is sampled again, and one whose material changed goes over to the batch of that
+// material. Only the vertices of the members that changed are uploaded again, unless members
+// came, went or changed their number of vertices; the batch is then uploaded whole, from the
+// vertices kept of the other members.
+//
+// All member functions are to be called from the render thread.
+class StaticBatcher {
+public:
+    struct Stats {
+        size_t                                        batches {0};
+        size_t                                        members {0};
+        size_t                                        vertices {0};
+        size_t                                        sampled {0};      // members, last update
+        size_t                                        transformed {0};  // members, last update
+        size_t                                        uploaded {0};     // whole batches, last update
+    };
+
+    StaticBatcher();
+    ~StaticBatcher();
+
+    // The surface draws from the batch of its material instead of its default visualizer;
+    // false for shapes the sampler does not know, or surfaces not drawing their own mesh
+    bool                                              add( GMlib::PSurf<float,3>* surface );
+
+    // Back to the default visualizer, which then needs a replot
+    void                                              remove( GMlib::PSurf<float,3>* surface );
+    bool                                              contains( const GMlib::SceneObject* obj ) const;
+
+    // Removes obj and its children; before they are deleted or removed from the scene
+    void                                              release( GMlib::SceneObject* obj );
+
+    // Drops every batch without touching the surfaces, for when the scene is gone
+    void                                              clear();
+
+    // false if the surface is not static; it is sampled so at the next update otherwise
+    bool                                              replot( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 );
+
+    // Before each frame is rendered
+    void                                              update();
+
+    const Stats&                                      getStats() const;
+
+private:
+    struct Batch;
+
+    struct Member {
+        GMlib::PSurf<float,3>*                        surface;
+        Batch*                                        batch {nullptr};
+        int                                           m1 {0}, m2 {0}, d1 {1}, d2 {1};   // asked for
+        bool                                          sampled {false};
+        std::vector<float>                            local;      // position and normal, six floats a vertex
+        std::vector<GLuint>                           indices;    // triangles, from the first vertex of the member
+        std::vector<float>                            vertices;   // local, in the scene
+        float                                         matrix[16]; // to the scene with the scale, as transformed
+        size_t                                        first {0};  // vertex in the batch
+        bool                                          changed {false};
+    };
+
+    struct Batch {
+        GMlib::Material                               material;
+        std::unique_ptr<StaticBatchVisualizer>        visualizer;
+        std::vector<Member*>                          members;    // in buffer order
+        bool                                          layout {true};      // to be uploaded whole
+    };
+
+    std::map<const GMlib::SceneObject*,std::unique_ptr<Member>>    _members;
+    std::vector<std::unique_ptr<Batch>>               _batches;
+    Stats                                             _stats;
+
+    Batch*                                            batch( const GMlib::Material& material );
+    void                                              join( Member& member, Batch* batch );
+    void                                              leave( Member& member );
+    void                                              upload( Batch& batch );
+
+    static void                                       sample( Member& member );
+    static void                                       transform( Member& member );
+};
+
+#endif // STATICBATCHER_H
@@ -0,0 +1,231 @@
+#include "staticbatchvisualizer.h"
+#include "packedsurfacevisualizer.h"
+
+// stl
+#include <iostream>
+#include <string>
+
+
+namespace {
+
+    const std::string program_name {"static_batch_blinn_phong"};
+
+    const GLsizei stride = 6 * sizeof(GLfloat);
+
+    // Drawn when it, and every object above it, is visible
+    bool isShown( const GMlib::SceneObject* obj ) {
+
+        for( ; obj; obj = obj->getParent() )
+            if( !obj->isVisible() )
+                return false;
+
+        return true;
+    }
+
+    const GLvoid* indexOffset( size_t first ) {
+
+        return reinterpret_cast<const GLvoid*>( first * sizeof(GLuint) );
+    }
+}
+
+
+
+unsigned int StaticBatchVisualizer::_frame {1};
+
+StaticBatchVisualizer::StaticBatchVisualizer() {
+
+    initShaderProgram();
+
+    _prog.acquire( program_name );
+    _color_prog.acquire( "color" );
+
+    _vbo.create();
+    _ibo.create();
+}
+
+void StaticBatchVisualizer::render( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const {
+
+    // Drawn along with the first member this frame
+    if( _ranges.empty() || _drawn_frame == _frame )
+        return;
+
+    const auto cam = renderer->getCamera();
+    GMlib::HqMatrix<float,3> view;
+    if( !PackedSurfaceVisualizer::getViewMatrix( cam, view ) )
+        return;
+    _drawn_frame = _frame;
+
+    // The ranges of the members shown, neighbours joined
+    _counts.clear();
+    _offsets.clear();
+    size_t end = 0;
+    for( const auto& r : _ranges ) {
+
+        if( !isShown( r.obj ) )
+            continue;
+
+        if( !_counts.empty() && r.first == end )
+            _counts.back() += GLsizei( r.count );
+        else {
+            _counts.push_back( GLsizei( r.count ) );
+            _offsets.push_back( indexOffset( r.first ) );
+        }
+        end = r.first + r.count;
+    }
+    if( _counts.empty() )
+        return;
+
+    this->glSetDisplayMode();
+
+    _prog.bind(); {
+
+        _prog.uniform( "u_view", view );
+        _prog.uniform( "u_pmat", obj->getProjectionMatrix(cam) );
+
+        const auto& m = obj->getMaterial();
+        _prog.uniform( "u_mat_amb", m.getAmb() );
+        _prog.uniform( "u_mat_dif", m.getDif() );
+        _prog.uniform( "u_mat_spc", m.getSpc() );
+        _prog.uniform( "u_mat_shi", m.getShininess() );
+
+        auto vertex_loc = _prog.getAttributeLocation( "in_vertex" );
+        auto normal_loc = _prog.getAttributeLocation( "in_normal" );
+
+        enableAttributes( vertex_loc, &normal_loc );
+        _ibo.bind();
+        glMultiDrawElements( GL_TRIANGLES, _counts.data(), GL_UNSIGNED_INT, _offsets.data(), GLsizei( _counts.size() ) );
+        _ibo.unbind();
+        _vbo.disable( vertex_loc );
+        _vbo.disable( normal_loc );
+        _vbo.unbind();
+
+    } _prog.unbind();
+}
+
+void StaticBatchVisualizer::renderGeometry( const GMlib::SceneObject* obj, const GMlib::Renderer* renderer,
+                                            const GMlib::Color& color ) const {
+
+    const auto cam = renderer->getCamera();
+    GMlib::HqMatrix<float,3> view;
+    if( !PackedSurfaceVisualizer::getViewMatrix( cam, view ) )
+        return;
+
+    for( const auto& r : _ranges ) {
+
+        if( r.obj != obj || !r.count )
+            continue;
+
+        _color_prog.bind(); {
+
+            _color_prog.uniform( "u_color", color );
+            _color_prog.uniform( "u_mvpmat", obj->getProjectionMatrix(cam) * view );
+
+            auto vertex_loc = _color_prog.getAttributeLocation( "in_vertex" );
+
+            enableAttributes( vertex_loc, nullptr );
+            _ibo.bind();
+            glDrawElements( GL_TRIANGLES, GLsizei( r.count ), GL_UNSIGNED_INT, indexOffset( r.first ) );
+            _ibo.unbind();
+            _vbo.disable( vertex_loc );
+            _vbo.unbind();
+
+        } _color_prog.unbind();
+        return;
+    }
+}
+
+void StaticBatchVisualizer::upload( const std::vector<float>& vertices, const std::vector<GLuint>& indices,
+                                    const std::vector<Range>& ranges ) {
+
+    _vbo.bufferData( GLsizeiptr( vertices.size() * sizeof(float) ), vertices.data(), GL_STATIC_DRAW );
+    _ibo.bufferData( GLsizeiptr( indices.size() * sizeof(GLuint) ), indices.data(), GL_STATIC_DRAW );
+    _ranges = ranges;
+}
+
+void StaticBatchVisualizer::update( size_t first, const std::vector<float>& vertices ) {
+
+    _vbo.bufferSubData( GLintptr( first * stride ), GLsizeiptr( vertices.size() * sizeof(float) ), vertices.data() );
+}
+
+void StaticBatchVisualizer::beginFrame() { ++_frame; }
+
+void StaticBatchVisualizer::enableAttributes( const GMlib::GL::AttributeLocation& vertex_loc,
+                                              const GMlib::GL::AttributeLocation* normal_loc ) const {
+
+    _vbo.bind();
+    _vbo.enable( vertex_loc, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>(0x0) );
+    if( normal_loc )
+        _vbo.enable( *normal_loc, 3, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const GLvoid*>( 3 * sizeof(GLfloat) ) );
+}
+
+void StaticBatchVisualizer::initShaderProgram() {
+
+    GMlib::GL::Program prog;
+    if( prog.acquire( program_name ) )
+        return;
+
+    // Vertices are in the scene already
+    const std::string vs_src (
+        "uniform mat4 u_view;\n"
+        "uniform mat4 u_pmat;\n"
+        "\n"
+        "in vec4 in_vertex;\n"
+        "in vec3 in_normal;\n"
+        "\n"
+        "out vec3 ex_pos;\n"
+        "out vec3 ex_normal;\n"
+        "\n"
+        "void main() {\n"
+        "\n"
+        "  vec4 pos = u_view * in_vertex;\n"
+        "  ex_pos = pos.xyz / pos.w;\n"
+        "  ex_normal = mat3(u_view) * in_normal;\n"
+        "\n"
+        "  gl_Position = u_pmat * pos;\n"
+        "}\n"
+    );
+
+    const std::string fs_src (
+        "uniform vec4  u_mat_amb;\n"
+        "uniform vec4  u_mat_dif;\n"
+        "uniform vec4  u_mat_spc;\n"
+        "uniform float u_mat_shi;\n"
+        "\n"
+        "in vec3 ex_pos;\n"
+        "in vec3 ex_normal;\n"
+        "\n"
+        "out vec4 frag_color;\n"
+        "\n"
+        "void main() {\n"
+        "\n"
+        "  vec3 v = normalize( -ex_pos );\n"
+        "  vec3 n = length(ex_normal) > 0.0 ? normalize(ex_normal) : v;\n"
+        "  if( !gl_FrontFacing ) n = -n;\n"
+        "\n"
+        "  float d = max( dot( n, v ), 0.0 );\n"
+        "  float s = d > 0.0 ? pow( d, u_mat_shi ) : 0.0;\n"
+        "\n"
+        "  frag_color = vec4( ( u_mat_amb + u_mat_dif * d + u_mat_spc * s ).rgb, u_mat_dif.a );\n"
+        "}\n"
+    );
+
+    GMlib::GL::VertexShader vshader;
+    vshader.create( program_name + "_vs" );
+    vshader.setPrerequisiteSource( GMlib::GL::OpenGLManager::glslDefHeader150Source() );
+    vshader.setSource( vs_src );
+    if( !vshader.compile() )
+        std::cerr << "StaticBatchVisualizer: " << vshader.getCompilerLog() << std::endl;
+
+    GMlib::GL::FragmentShader fshader;
+    fshader.create( program_name + "_fs" );
+    fshader.setPrerequisiteSource( GMlib::GL::OpenGLManager::glslDefHeader150Source() );
+    fshader.setSource( fs_src );
+    if( !fshader.compile() )
+        std::cerr << "StaticBatchVisualizer: " << fshader.getCompilerLog() << std::endl;
+
+    prog.create( program_name );
+    prog.attachShader( vshader );
+    prog.attachShader( fshader );
+    if( !prog.link() )
+        std::cerr << "StaticBatchVisualizer: " << prog.getLinkerLog() << std::endl;
+}
@@ -0,0 +1,60 @@
+#ifndef STATICBATCHVISUALIZER_H
+#define STATICBATCHVISUALIZER_H
+
+
+// gmlib
+#include <gmOpenglModule>
+#include <gmSceneModule>
+
+// stl
+#include <vector>
+
+
+// Draws a batch of static surfaces sharing a material, from one vertex buffer of positions and
+// normals in the scene and one index buffer of triangles. Every member draws with the
+// visualizer: the first of them drawn in a frame draws the index ranges of all those shown in
+// one call, the rest draw nothing. Picking draws the range of the member picked.
+class StaticBatchVisualizer : public GMlib::Visualizer {
+    GM_VISUALIZER(StaticBatchVisualizer)
+public:
+    // Indices of a member
+    struct Range {
+        const GMlib::SceneObject*                     obj;
+        size_t                                        first;
+        size_t                                        count;
+    };
+
+    StaticBatchVisualizer();
+
+    void                                              render( const GMlib::SceneObject* obj, const GMlib::DefaultRenderer* renderer ) const override;
+    void                                              renderGeometry( const GMlib::SceneObject* obj, const GMlib::Renderer* renderer,
+                                                                      const GMlib::Color& color ) const override;
+
+    // Six floats a vertex, position and normal
+    void                                              upload( const std::vector<float>& vertices, const std::vector<GLuint>& indices,
+                                                              const std::vector<Range>& ranges );
+    // Vertices rewritten in place, from vertex first on
+    void                                              update( size_t first, const std::vector<float>& vertices );
+
+    // Render thread, before each frame is rendered
+    static void                                       beginFrame();
+
+private:
+    GMlib::GL::Program                                _prog;
+    GMlib::GL::Program                                _color_prog;
+    GMlib::GL::VertexBufferObject                     _vbo;
+    GMlib::GL::IndexBufferObject                      _ibo;
+
+    std::vector<Range>                                _ranges;
+    mutable std::vector<GLsizei>                      _counts;
+    mutable std::vector<const GLvoid*>                _offsets;
+    mutable unsigned int                              _drawn_frame {0};
+
+    static unsigned int                               _frame;
+
+    void                                              enableAttributes( const GMlib::GL::AttributeLocation& vertex_loc,
+                                                                        const GMlib::GL::AttributeLocation* normal_loc ) const;
+    static void                                       initShaderProgram();
+};
+
+#endif // STATICBATCHVISUALIZER_H
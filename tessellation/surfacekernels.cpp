@@ -0,0 +1,409 @@
+#include "surfacekernels.h"
+
+// stl
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+
+#if defined(__GNUC__) && ( defined(__x86_64__) || defined(__i386__) )
+#define SURFACEKERNELS_AVX2
+#include <immintrin.h>
+#endif
+
+
+namespace {
+
+    using Isa = SurfaceKernels::Isa;
+
+    bool detectAvx2() {
+
+#ifdef SURFACEKERNELS_AVX2
+        return __builtin_cpu_supports("avx2");
+#else
+        return false;
+#endif
+    }
+
+    const bool        has_avx2 = detectAvx2();
+    std::atomic<int>  selected { int( has_avx2 ? Isa::Avx2 : Isa::Scalar ) };
+
+
+    // out[i][j] = a[i] * t[j]
+    void scaleRowsScalar( const float* a, const float* t, float* out, int m1, int m2 ) {
+
+        for( auto i = 0; i < m1; ++i, out += m2 )
+            for( auto j = 0; j < m2; ++j )
+                out[j] = a[i] * t[j];
+    }
+
+    // out[i][j] = a[i] + t[j]
+    void addRowsScalar( const float* a, const float* t, float* out, int m1, int m2 ) {
+
+        for( auto i = 0; i < m1; ++i, out += m2 )
+            for( auto j = 0; j < m2; ++j )
+                out[j] = a[i] + t[j];
+    }
+
+    // n = su ^ sv / |su ^ sv| over count samples, as SurfaceSampler does per sample
+    void normalsScalar( const float* su[3], const float* sv[3], float* n[3], size_t begin, size_t count ) {
+
+        for( auto s = begin; s < count; ++s ) {
+
+            auto x = su[1][s] * sv[2][s] - su[2][s] * sv[1][s];
+            auto y = su[2][s] * sv[0][s] - su[0][s] * sv[2][s];
+            auto z = su[0][s] * sv[1][s] - su[1][s] * sv[0][s];
+            auto length = std::sqrt( x * x + y * y + z * z );
+            if( length > 0.0f ) {
+                x /= length;
+                y /= length;
+                z /= length;
+            }
+            n[0][s] = x;
+            n[1][s] = y;
+            n[2][s] = z;
+        }
+    }
+
+#ifdef SURFACEKERNELS_AVX2
+
+    // No FMA: products and sums are rounded as in the scalar code
+
+    __attribute__((target("avx2")))
+    void scaleRowsAvx2( const float* a, const float* t, float* out, int m1, int m2 ) {
+
+        for( auto i = 0; i < m1; ++i, out += m2 ) {
+
+            auto ai = _mm256_set1_ps( a[i] );
+            auto j = 0;
+            for( ; j + 8 <= m2; j += 8 )
+                _mm256_storeu_ps( out + j, _mm256_mul_ps( ai, _mm256_loadu_ps( t + j ) ) );
+            for( ; j < m2; ++j )
+                out[j] = a[i] * t[j];
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void addRowsAvx2( const float* a, const float* t, float* out, int m1, int m2 ) {
+
+        for( auto i = 0; i < m1; ++i, out += m2 ) {
+
+            auto ai = _mm256_set1_ps( a[i] );
+            auto j = 0;
+            for( ; j + 8 <= m2; j += 8 )
+                _mm256_storeu_ps( out + j, _mm256_add_ps( ai, _mm256_loadu_ps( t + j ) ) );
+            for( ; j < m2; ++j )
+                out[j] = a[i] + t[j];
+        }
+    }
+
+    __attribute__((target("avx2")))
+    void normalsAvx2( const float* su[3], const float* sv[3], float* n[3], size_t count ) {
+
+        const auto zero = _mm256_setzero_ps();
+
+        size_t s = 0;
+        for( ; s + 8 <= count; s += 8 ) {
+
+            auto ux = _mm256_loadu_ps( su[0] + s ), uy = _mm256_loadu_ps( su[1] + s ), uz = _mm256_loadu_ps( su[2] + s );
+            auto vx = _mm256_loadu_ps( sv[0] + s ), vy = _mm256_loadu_ps( sv[1] + s ), vz = _mm256_loadu_ps( sv[2] + s );
+
+            auto x = _mm256_sub_ps( _mm256_mul_ps( uy, vz ), _mm256_mul_ps( uz, vy ) );
+            auto y = _mm256_sub_ps( _mm256_mul_ps( uz, vx ), _mm256_mul_ps( ux, vz ) );
+            auto z = _mm256_sub_ps( _mm256_mul_ps( ux, vy ), _mm256_mul_ps( uy, vx ) );
+
+            auto dot    = _mm256_add_ps( _mm256_add_ps( _mm256_mul_ps( x, x ), _mm256_mul_ps( y, y ) ), _mm256_mul_ps( z, z ) );
+            auto length = _mm256_sqrt_ps( dot );
+
+            // Zero lengths divide by one instead
+            auto degenerate = _mm256_cmp_ps( length, zero, _CMP_LE_OQ );
+            auto divisor    = _mm256_blendv_ps( length, _mm256_set1_ps( 1.0f ), degenerate );
+
+            _mm256_storeu_ps( n[0] + s, _mm256_div_ps( x, divisor ) );
+            _mm256_storeu_ps( n[1] + s, _mm256_div_ps( y, divisor ) );
+            _mm256_storeu_ps( n[2] + s, _mm256_div_ps( z, divisor ) );
+        }
+
+        normalsScalar( su, sv, n, s, count );
+    }
+
+#endif
+
+    void scaleRows( const float* a, const float* t, float* out, int m1, int m2 ) {
+
+#ifdef SURFACEKERNELS_AVX2
+        if( selected == int( Isa::Avx2 ) )
+            return scaleRowsAvx2( a, t, out, m1, m2 );
+#endif
+        scaleRowsScalar( a, t, out, m1, m2 );
+    }
+
+    void addRows( const float* a, const float* t, float* out, int m1, int m2 ) {
+
+#ifdef SURFACEKERNELS_AVX2
+        if( selected == int( Isa::Avx2 ) )
+            return addRowsAvx2( a, t, out, m1, m2 );
+#endif
+        addRowsScalar( a, t, out, m1, m2 );
+    }
+
+
+    // sin and cos at the sample parameters of one direction.
+    // The k-th derivative of cos and sin is the same function a quarter turn further on,
+    // so every derivative order is one of the two tables, possibly negated.
+    struct TrigTable {
+        std::vector<float>   cos, sin;
+
+        explicit TrigTable( const std::vector<float>& t ) : cos( t.size() ), sin( t.size() ) {
+
+            for( size_t i = 0; i < t.size(); ++i ) {
+                cos[i] = std::cos(t[i]);
+                sin[i] = std::sin(t[i]);
+            }
+        }
+
+        // scale * d^k/dt^k cos(t)
+        void cosD( int k, float scale, std::vector<float>& out ) const {
+
+            static const float sign[4] = { 1.0f, -1.0f, -1.0f, 1.0f };
+            signedCopy( k % 2 ? sin : cos, scale * sign[k % 4], out );
+        }
+
+        // scale * d^k/dt^k sin(t)
+        void sinD( int k, float scale, std::vector<float>& out ) const {
+
+            static const float sign[4] = { 1.0f, 1.0f, -1.0f, -1.0f };
+            signedCopy( k % 2 ? cos : sin, scale * sign[k % 4], out );
+        }
+
+    private:
+        static void signedCopy( const std::vector<float>& in, float scale, std::vector<float>& out ) {
+
+            out.resize( in.size() );
+            for( size_t i = 0; i < in.size(); ++i )
+                out[i] = scale * in[i];
+        }
+    };
+
+    // Parameter values of one direction
+    std::vector<float> parameters( float start, float delta, int m ) {
+
+        std::vector<float> t( static_cast<size_t>(m) );
+        for( auto i = 0; i < m; ++i )
+            t[size_t(i)] = start + float(i) * delta;
+        return t;
+    }
+
+    void fill( float* out, size_t count, float value ) {
+
+        std::fill( out, out + count, value );
+    }
+
+
+    // x = cos(u) (a + b cos(v)),  y = sin(u) (a + b cos(v)),  z = c sin(v)
+    void evaluateTorus( float a, float b, float c, const TrigTable& tu, const TrigTable& tv, SurfaceGrid& g ) {
+
+        const auto count = size_t(g.m1) * size_t(g.m2);
+        const std::vector<float> ones( size_t(g.m1), 1.0f );
+        std::vector<float> au, bv;
+
+        for( auto i = 0; i <= g.d1; ++i ) {
+            for( auto j = 0; j <= g.d2; ++j ) {
+
+                // b cos(v) + a, the wheel radius drops out of the v derivatives
+                tv.cosD( j, b, bv );
+                if( j == 0 )
+                    for( auto& t : bv ) t += a;
+
+                tu.cosD( i, 1.0f, au );
+                scaleRows( au.data(), bv.data(), g.plane(i,j,0), g.m1, g.m2 );
+                tu.sinD( i, 1.0f, au );
+                scaleRows( au.data(), bv.data(), g.plane(i,j,1), g.m1, g.m2 );
+
+                if( i == 0 ) {
+                    tv.sinD( j, c, bv );
+                    scaleRows( ones.data(), bv.data(), g.plane(i,j,2), g.m1, g.m2 );
+                }
+                else
+                    fill( g.plane(i,j,2), count, 0.0f );
+            }
+        }
+    }
+
+    // x = r cos(u) cos(v),  y = r sin(u) cos(v),  z = r sin(v)
+    void evaluateSphere( float r, const TrigTable& tu, const TrigTable& tv, SurfaceGrid& g ) {
+
+        const auto count = size_t(g.m1) * size_t(g.m2);
+        const std::vector<float> ones( size_t(g.m1), 1.0f );
+        std::vector<float> au, bv;
+
+        for( auto i = 0; i <= g.d1; ++i ) {
+            for( auto j = 0; j <= g.d2; ++j ) {
+
+                tv.cosD( j, r, bv );
+                tu.cosD( i, 1.0f, au );
+                scaleRows( au.data(), bv.data(), g.plane(i,j,0), g.m1, g.m2 );
+                tu.sinD( i, 1.0f, au );
+                scaleRows( au.data(), bv.data(), g.plane(i,j,1), g.m1, g.m2 );
+
+                if( i == 0 ) {
+                    tv.sinD( j, r, bv );
+                    scaleRows( ones.data(), bv.data(), g.plane(i,j,2), g.m1, g.m2 );
+                }
+                else
+                    fill( g.plane(i,j,2), count, 0.0f );
+            }
+        }
+    }
+
+    // x = rx cos(u),  y = ry sin(u),  z = h v
+    void evaluateCylinder( float rx, float ry, float h, const TrigTable& tu, const std::vector<float>& v, SurfaceGrid& g ) {
+
+        const auto count = size_t(g.m1) * size_t(g.m2);
+        const std::vector<float> ones( size_t(g.m1), 1.0f );
+        std::vector<float> au, bv;
+
+        for( auto i = 0; i <= g.d1; ++i ) {
+            for( auto j = 0; j <= g.d2; ++j ) {
+
+                if( j == 0 ) {
+                    bv.assign( size_t(g.m2), rx );
+                    tu.cosD( i, 1.0f, au );
+                    scaleRows( au.data(), bv.data(), g.plane(i,j,0), g.m1, g.m2 );
+                    bv.assign( size_t(g.m2), ry );
+                    tu.sinD( i, 1.0f, au );
+                    scaleRows( au.data(), bv.data(), g.plane(i,j,1), g.m1, g.m2 );
+                }
+                else {
+                    fill( g.plane(i,j,0), count, 0.0f );
+                    fill( g.plane(i,j,1), count, 0.0f );
+                }
+
+                if( i == 0 && j == 0 ) {
+                    bv.resize( v.size() );
+                    for( size_t k = 0; k < v.size(); ++k )
+                        bv[k] = h * v[k];
+                    scaleRows( ones.data(), bv.data(), g.plane(i,j,2), g.m1, g.m2 );
+                }
+                else
+                    fill( g.plane(i,j,2), count, i == 0 && j == 1 ? h : 0.0f );
+            }
+        }
+    }
+
+    // p + (u - u0) U + (v - v0) V
+    void evaluatePlane( const GMlib::Vector<float,3>& p, const GMlib::Vector<float,3>& du, const GMlib::Vector<float,3>& dv,
+                        const std::vector<float>& u, const std::vector<float>& v, float u0, float v0, SurfaceGrid& g ) {
+
+        const auto count = size_t(g.m1) * size_t(g.m2);
+        std::vector<float> au( u.size() ), bv( v.size() );
+
+        for( auto k = 0; k < 3; ++k ) {
+
+            for( size_t i = 0; i < u.size(); ++i ) au[i] = p[k] + ( u[i] - u0 ) * du[k];
+            for( size_t j = 0; j < v.size(); ++j ) bv[j] = ( v[j] - v0 ) * dv[k];
+            addRows( au.data(), bv.data(), g.plane(0,0,k), g.m1, g.m2 );
+
+            for( auto i = 0; i <= g.d1; ++i )
+                for( auto j = 0; j <= g.d2; ++j )
+                    if( i + j > 0 )
+                        fill( g.plane(i,j,k), count, i == 1 && j == 0 ? du[k] : i == 0 && j == 1 ? dv[k] : 0.0f );
+        }
+    }
+}
+
+
+
+void SurfaceGrid::resize( int m1_, int m2_, int d1_, int d2_ ) {
+
+    m1 = m1_;
+    m2 = m2_;
+    d1 = d1_;
+    d2 = d2_;
+
+    const auto count = size_t(m1) * size_t(m2);
+    values.resize( size_t(d1 + 1) * size_t(d2 + 1) * 3 * count );
+    normals.resize( 3 * count );
+}
+
+float* SurfaceGrid::plane( int i, int j, int k ) {
+
+    return values.data() + size_t( (i * (d2 + 1) + j) * 3 + k ) * size_t(m1) * size_t(m2);
+}
+
+const float* SurfaceGrid::plane( int i, int j, int k ) const {
+
+    return values.data() + size_t( (i * (d2 + 1) + j) * 3 + k ) * size_t(m1) * size_t(m2);
+}
+
+float* SurfaceGrid::normal( int k ) { return normals.data() + size_t(k) * size_t(m1) * size_t(m2); }
+
+const float* SurfaceGrid::normal( int k ) const { return normals.data() + size_t(k) * size_t(m1) * size_t(m2); }
+
+
+
+SurfaceKernels::Isa SurfaceKernels::isa() { return Isa( selected.load() ); }
+
+bool SurfaceKernels::isSupported( Isa isa ) { return isa == Isa::Scalar || has_avx2; }
+
+void SurfaceKernels::setIsa( Isa isa ) { selected = int( isSupported(isa) ? isa : Isa::Scalar ); }
+
+bool SurfaceKernels::evaluate( const GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2, SurfaceGrid& grid ) {
+
+    return evaluate( surface,
+                     parameters( surface->getParStartU(), surface->getParDeltaU() / float(m1 - 1), m1 ),
+                     parameters( surface->getParStartV(), surface->getParDeltaV() / float(m2 - 1), m2 ),
+                     d1, d2, grid );
+}
+
+bool SurfaceKernels::evaluate( const GMlib::PSurf<float,3>* surface, const std::vector<float>& u, const std::vector<float>& v,
+                               int d1, int d2, SurfaceGrid& grid ) {
+
+    auto torus    = dynamic_cast<const GMlib::PTorus<float>*>(surface);
+    auto sphere   = dynamic_cast<const GMlib::PSphere<float>*>(surface);
+    auto cylinder = dynamic_cast<const GMlib::PCylinder<float>*>(surface);
+    auto plane    = dynamic_cast<const GMlib::PPlane<float>*>(surface);
+    if( !torus && !sphere && !cylinder && !plane )
+        return false;
+
+    grid.resize( int(u.size()), int(v.size()), d1, d2 );
+    if( u.empty() || v.empty() )
+        return true;
+
+    if( torus )
+        evaluateTorus( torus->getWheelRadius(), torus->getTubeRadius1(), torus->getTubeRadius2(),
+                       TrigTable(u), TrigTable(v), grid );
+    else if( sphere )
+        evaluateSphere( sphere->getRadius(), TrigTable(u), TrigTable(v), grid );
+    else if( cylinder )
+        evaluateCylinder( cylinder->getRadiusX(), cylinder->getRadiusY(), cylinder->getHeight(),
+                          TrigTable(u), v, grid );
+    else {
+
+        // Corner and spanning vectors
+        const auto su = surface->getParStartU();
+        const auto sv = surface->getParStartV();
+        auto p = const_cast<GMlib::PPlane<float>*>(plane)->evaluate( su, sv, 1, 1 );
+        evaluatePlane( p[0][0], p[1][0], p[0][1], u, v, su, sv, grid );
+    }
+
+    return true;
+}
+
+void SurfaceKernels::computeNormals( SurfaceGrid& grid ) {
+
+    if( grid.d1 < 1 || grid.d2 < 1 ) {
+        std::fill( grid.normals.begin(), grid.normals.end(), 0.0f );
+        return;
+    }
+
+    const float* su[3] = { grid.plane(1,0,0), grid.plane(1,0,1), grid.plane(1,0,2) };
+    const float* sv[3] = { grid.plane(0,1,0), grid.plane(0,1,1), grid.plane(0,1,2) };
+    float*       n[3]  = { grid.normal(0), grid.normal(1), grid.normal(2) };
+    const auto count   = size_t(grid.m1) * size_t(grid.m2);
+
+#ifdef SURFACEKERNELS_AVX2
+    if( selected == int( Isa::Avx2 ) )
+        return normalsAvx2( su, sv, n, count );
+#endif
+    normalsScalar( su, sv, n, 0, count );
+}
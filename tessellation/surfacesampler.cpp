@@ -0,0 +1,233 @@
+#include "surfacesampler.h"
+#include "surfacekernels.h"
+#include "packedsurfacevisualizer.h"
+#include "../gmlibaccess.h"
+
+// gmlib
+#include <gmSceneModule>
+
+// stl
+#include <algorithm>
+#include <chrono>
+
+
+SurfaceSampler::SurfaceSampler( GMlib::PSurf<float,3>* shape ) : _shape(shape) {}
+
+std::unique_ptr<SurfaceSampler> SurfaceSampler::create( const GMlib::PSurf<float,3>* surface ) {
+
+    auto shape = copyShape(surface);
+    if( !shape )
+        return nullptr;
+
+    return std::unique_ptr<SurfaceSampler>( new SurfaceSampler(shape) );
+}
+
+void SurfaceSampler::neededDerivatives( const GMlib::PSurf<float,3>* surface, int& d1, int& d2 ) {
+
+    // Shading (default or packed), normals, parameter lines and points need the first derivatives at most.
+    // Derivative and curvature visualizers, and any other, keep what was asked for.
+    const auto& visualizers = surface->getVisualizers();
+    for( auto i = 0; i < visualizers.getSize(); ++i ) {
+
+        auto visualizer = visualizers(i);
+        if( !dynamic_cast<const GMlib::PSurfDefaultVisualizer<float,3>*>(visualizer)    &&
+            !dynamic_cast<const PackedSurfaceVisualizer*>(visualizer)                    &&
+            !dynamic_cast<const GMlib::PSurfNormalsVisualizer<float,3>*>(visualizer)    &&
+            !dynamic_cast<const GMlib::PSurfParamLinesVisualizer<float,3>*>(visualizer) &&
+            !dynamic_cast<const GMlib::PSurfPointsVisualizer<float,3>*>(visualizer) )
+            return;
+    }
+
+    d1 = std::min( d1, 1 );
+    d2 = std::min( d2, 1 );
+}
+
+GMlib::PSurf<float,3>* SurfaceSampler::copyShape( const GMlib::PSurf<float,3>* surface ) {
+
+    if( auto torus = dynamic_cast<const GMlib::PTorus<float>*>(surface) )
+        return new GMlib::PTorus<float>( torus->getWheelRadius(), torus->getTubeRadius1(), torus->getTubeRadius2() );
+    else if( auto sphere = dynamic_cast<const GMlib::PSphere<float>*>(surface) )
+        return new GMlib::PSphere<float>( sphere->getRadius() );
+    else if( auto cylinder = dynamic_cast<const GMlib::PCylinder<float>*>(surface) )
+        return new GMlib::PCylinder<float>( cylinder->getRadiusX(), cylinder->getRadiusY(), cylinder->getHeight() );
+    else if( auto plane = dynamic_cast<const GMlib::PPlane<float>*>(surface) ) {
+
+        // Corner and spanning vectors
+        auto p = const_cast<GMlib::PPlane<float>*>(plane)->evaluate( plane->getParStartU(), plane->getParStartV(), 1, 1 );
+        return new GMlib::PPlane<float>( p[0][0], p[1][0], p[0][1] );
+    }
+
+    return nullptr;
+}
+
+std::shared_ptr<SurfaceSamples> SurfaceSampler::sample( int m1, int m2, int d1, int d2 ) {
+
+    auto started = std::chrono::steady_clock::now();
+    auto samples = std::make_shared<SurfaceSamples>();
+
+    // The normals need the first derivatives
+    m1 = std::max( m1, 2 );
+    m2 = std::max( m2, 2 );
+    d1 = std::max( d1, 1 );
+    d2 = std::max( d2, 1 );
+
+    setup( *samples, m1, m2, d1, d2 );
+    evaluate( *samples, indices( 0, m1, 1 ), indices( 0, m2, 1 ) );
+    bound( *samples );
+
+    samples->time = milliseconds( started );
+    return samples;
+}
+
+std::shared_ptr<SurfaceSamples> SurfaceSampler::refine( const SurfaceSamples& coarse ) {
+
+    auto started = std::chrono::steady_clock::now();
+    auto samples = std::make_shared<SurfaceSamples>();
+
+    const auto m1 = 2 * coarse.m1 - 1;
+    const auto m2 = 2 * coarse.m2 - 1;
+    setup( *samples, m1, m2, coarse.d1, coarse.d2 );
+
+    // The coarse samples are every other sample of the finer grid
+    for( auto i = 0; i < coarse.m1; ++i ) {
+        for( auto j = 0; j < coarse.m2; ++j ) {
+            samples->p[2*i][2*j]       = coarse.p[i][j];
+            samples->normals[2*i][2*j] = coarse.normals[i][j];
+        }
+    }
+
+    // New are the odd rows, and the odd columns of the even rows
+    evaluate( *samples, indices( 1, m1, 2 ), indices( 0, m2, 1 ) );
+    evaluate( *samples, indices( 0, m1, 2 ), indices( 1, m2, 2 ) );
+    bound( *samples );
+
+    samples->pass = coarse.pass + 1;
+    samples->time = coarse.time + milliseconds( started );
+    return samples;
+}
+
+void SurfaceSampler::setup( SurfaceSamples& samples, int m1, int m2, int d1, int d2 ) const {
+
+    samples.m1 = m1;
+    samples.m2 = m2;
+    samples.d1 = d1;
+    samples.d2 = d2;
+    samples.closed_u = _shape->isClosedU();
+    samples.closed_v = _shape->isClosedV();
+
+    samples.p.setDim( m1, m2 );
+    samples.normals.setDim( m1, m2 );
+}
+
+double SurfaceSampler::milliseconds( std::chrono::steady_clock::time_point since ) {
+
+    return std::chrono::duration<double,std::milli>( std::chrono::steady_clock::now() - since ).count();
+}
+
+std::vector<int> SurfaceSampler::indices( int begin, int end, int step ) {
+
+    std::vector<int> i;
+    for( ; begin < end; begin += step )
+        i.push_back(begin);
+    return i;
+}
+
+void SurfaceSampler::evaluate( SurfaceSamples& samples, const std::vector<int>& rows, const std::vector<int>& columns ) {
+
+    const auto su = _shape->getParStartU();
+    const auto sv = _shape->getParStartV();
+    const auto du = _shape->getParDeltaU() / float(samples.m1 - 1);
+    const auto dv = _shape->getParDeltaV() / float(samples.m2 - 1);
+    const auto d1 = samples.d1;
+    const auto d2 = samples.d2;
+
+    std::vector<float> u, v;
+    for( auto i : rows )    u.push_back( su + float(i) * du );
+    for( auto j : columns ) v.push_back( sv + float(j) * dv );
+
+    // The built-in shapes are evaluated a grid at a time, anything else sample by sample
+    SurfaceGrid grid;
+    if( SurfaceKernels::evaluate( _shape.get(), u, v, d1, d2, grid ) ) {
+
+        SurfaceKernels::computeNormals(grid);
+
+        for( size_t i = 0; i < rows.size(); ++i ) {
+            for( size_t j = 0; j < columns.size(); ++j ) {
+
+                const auto s = i * columns.size() + j;
+
+                auto& p = samples.p[rows[i]][columns[j]];
+                p.setDim( d1 + 1, d2 + 1 );
+                for( auto a = 0; a <= d1; ++a )
+                    for( auto b = 0; b <= d2; ++b )
+                        for( auto k = 0; k < 3; ++k )
+                            p[a][b][k] = grid.plane(a,b,k)[s];
+
+                for( auto k = 0; k < 3; ++k )
+                    samples.normals[rows[i]][columns[j]][k] = grid.normal(k)[s];
+            }
+        }
+    }
+    else {
+
+        for( size_t i = 0; i < rows.size(); ++i ) {
+            for( size_t j = 0; j < columns.size(); ++j ) {
+
+                auto& p = samples.p[rows[i]][columns[j]];
+                p = _shape->evaluate( u[i], v[j], d1, d2 );
+
+                // Degenerated points (poles) keep a zero normal
+                auto n = GMlib::Vector<float,3>( p[1][0] ) ^ p[0][1];
+                auto length = n.getLength();
+                samples.normals[rows[i]][columns[j]] = length > 0.0f ? n / length : n;
+            }
+        }
+    }
+}
+
+void SurfaceSampler::bound( SurfaceSamples& samples ) {
+
+    const auto m1 = samples.m1;
+    const auto m2 = samples.m2;
+
+    GMlib::Vector<float,3> lo( samples.p[0][0][0][0] );
+    GMlib::Vector<float,3> hi( lo );
+    for( auto i = 0; i < m1; ++i ) {
+        for( auto j = 0; j < m2; ++j ) {
+            for( auto k = 0; k < 3; ++k ) {
+                lo[k] = std::min( lo[k], samples.p[i][j][0][0][k] );
+                hi[k] = std::max( hi[k], samples.p[i][j][0][0][k] );
+            }
+        }
+    }
+
+    // Centered on the bounding box, large enough for every sample
+    GMlib::Point<float,3> center( (lo + hi) * 0.5f );
+    auto radius = 0.0f;
+    for( auto i = 0; i < m1; ++i )
+        for( auto j = 0; j < m2; ++j )
+            radius = std::max( radius, ( samples.p[i][j][0][0] - center ).getLength() );
+    samples.sphere = GMlib::Sphere<float,3>( center, radius );
+}
+
+void SurfaceSampler::apply( GMlib::PSurf<float,3>* surface, const SurfaceSamples& samples ) {
+
+    const auto& visualizers = surface->getVisualizers();
+    for( auto i = 0; i < visualizers.getSize(); ++i ) {
+
+        auto visualizer = dynamic_cast<GMlib::PSurfVisualizer<float,3>*>( visualizers(i) );
+        if( visualizer )
+            visualizer->replot( samples.p, samples.normals, samples.m1, samples.m2, samples.d1, samples.d2,
+                                samples.closed_u, samples.closed_v );
+    }
+
+    // What a synchronous replot would have left behind
+    adopt( surface, samples.m1, samples.m2, samples.d1, samples.d2, samples.sphere );
+}
+
+void SurfaceSampler::adopt( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2,
+                            const GMlib::Sphere<float,3>& sphere ) {
+
+    PSurfAccess::setSampling( surface, m1, m2, d1, d2 );
+    PSurfAccess::setSphere( surface, sphere );
+}
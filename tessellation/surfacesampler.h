@@ -0,0 +1,72 @@
+#ifndef SURFACESAMPLER_H
+#define SURFACESAMPLER_H
+
+
+// gmlib
+#include <gmCoreModule>
+#include <gmParametricsModule>
+
+// stl
+#include <chrono>
+#include <memory>
+#include <vector>
+
+
+// CPU side of a replot: the sample grid and normals the visualizers of a surface are fed with
+struct SurfaceSamples {
+    GMlib::DMatrix<GMlib::DMatrix<GMlib::Vector<float,3>>>    p;
+    GMlib::DMatrix<GMlib::Vector<float,3>>                    normals;
+    GMlib::Sphere<float,3>                                    sphere;     // local
+
+    int                                                       m1 {0};
+    int                                                       m2 {0};
+    int                                                       d1 {0};
+    int                                                       d2 {0};
+    bool                                                      closed_u {false};
+    bool                                                      closed_v {false};
+
+    // Of a progressive replot, 0 for the first; the time includes the passes before
+    int                                                       pass {0};
+    double                                                    time {0.0};     // milliseconds spent sampling
+};
+
+
+// Evaluates a surface away from the render thread.
+// The sampler works on a private copy of the shape, so the surface in the scene is never
+// touched by the worker; only the GMlib types with a known shape can be copied this way.
+class SurfaceSampler {
+public:
+    static std::unique_ptr<SurfaceSampler>                    create( const GMlib::PSurf<float,3>* surface );
+
+    // Lowers the derivative orders to what the visualizers of surface draw from
+    static void                                               neededDerivatives( const GMlib::PSurf<float,3>* surface, int& d1, int& d2 );
+
+    // New surface of the same shape, not sampled; nullptr for unknown types
+    static GMlib::PSurf<float,3>*                             copyShape( const GMlib::PSurf<float,3>* surface );
+
+    std::shared_ptr<SurfaceSamples>                           sample( int m1, int m2, int d1, int d2 );
+
+    // Twice the intervals of coarse in both directions; only the new samples are evaluated
+    std::shared_ptr<SurfaceSamples>                           refine( const SurfaceSamples& coarse );
+
+    // Render thread: uploads the samples into the visualizers of surface
+    static void                                               apply( GMlib::PSurf<float,3>* surface, const SurfaceSamples& samples );
+
+    // Sample counts and bounding sphere as a replot would leave them, without touching the visualizers
+    static void                                               adopt( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2,
+                                                                     const GMlib::Sphere<float,3>& sphere );
+
+private:
+    explicit SurfaceSampler( GMlib::PSurf<float,3>* shape );
+
+    std::unique_ptr<GMlib::PSurf<float,3>>                    _shape;
+
+    void                                                      setup( SurfaceSamples& samples, int m1, int m2, int d1, int d2 ) const;
+    void                                                      evaluate( SurfaceSamples& samples, const std::vector<int>& rows,
+                                                                        const std::vector<int>& columns );
+    static void                                               bound( SurfaceSamples& samples );
+    static std::vector<int>                                   indices( int begin, int end, int step );
+    static double                                             milliseconds( std::chrono::steady_clock::time_point since );
+};
+
+#endif // SURFACESAMPLER_H
@@ -0,0 +1,147 @@
+#include "tessellationqueue.h"
+
+#include "../threadpool.h"
+
+// stl
+#include <algorithm>
+
+
+bool TessellationQueue::submit( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 ) {
+
+    // The same sampling is already on its way
+    auto latest = _requests.find(surface);
+    if( latest != _requests.end() && latest->second.m1 == m1 && latest->second.m2 == m2 &&
+                                     latest->second.d1 == d1 && latest->second.d2 == d2 )
+        return true;
+
+    std::shared_ptr<SurfaceSampler> sampler = SurfaceSampler::create(surface);
+    if( !sampler )
+        return false;
+
+    auto generation = ++_generation;
+    _requests[surface] = Request{ generation, m1, m2, d1, d2 };
+
+    auto refinements = _progressive ? countPasses( m1, m2 ) - 1 : 0;
+    auto c1 = passes( m1, refinements + 1 ).front();
+    auto c2 = passes( m2, refinements + 1 ).front();
+    auto started = std::chrono::steady_clock::now();
+
+    // A surface with nothing finer to show gets the coarse grid right away
+    if( refinements > 0 && surface->getSamplesU() * surface->getSamplesV() < c1 * c2 ) {
+
+        auto coarse = sampler->sample( c1, c2, d1, d2 );
+        apply( surface, *coarse, false );
+
+        refinements -= 1;
+        auto samples = ThreadPool::instance().submit( [sampler,coarse]() { return sampler->refine(*coarse); } );
+        _jobs.push_back( Job{ surface, generation, std::move(samples), sampler, refinements, started } );
+        return true;
+    }
+
+    auto samples = ThreadPool::instance().submit( [sampler,c1,c2,d1,d2]() {
+        return sampler->sample( c1, c2, d1, d2 );
+    });
+    _jobs.push_back( Job{ surface, generation, std::move(samples), sampler, refinements, started } );
+
+    return true;
+}
+
+int TessellationQueue::upload( int max_uploads ) {
+
+    auto uploads = 0;
+    for( auto job = _jobs.begin(); job != _jobs.end() && uploads < max_uploads; ) {
+
+        if( job->samples.wait_for( std::chrono::seconds(0) ) != std::future_status::ready ) {
+            ++job;
+            continue;
+        }
+
+        // Only the latest request of a surface still standing makes it to the screen
+        auto request = _requests.find(job->surface);
+        if( request != _requests.end() && request->second.generation == job->generation ) {
+
+            auto samples = job->samples.get();
+            auto last    = job->refinements <= 0 || std::chrono::steady_clock::now() - job->started >= _budget;
+            auto surface = job->surface;
+
+            // Passes coarser than the mesh on screen only serve as the base of the next one
+            if( last || samples->m1 * samples->m2 > surface->getSamplesU() * surface->getSamplesV() ) {
+
+                apply( surface, *samples, last );
+                ++uploads;
+            }
+
+            if( last )
+                _requests.erase(request);
+            else {
+                auto sampler = job->sampler;
+                auto refined = ThreadPool::instance().submit( [sampler,samples]() { return sampler->refine(*samples); } );
+                _jobs.push_back( Job{ surface, job->generation, std::move(refined), sampler, job->refinements - 1, job->started } );
+            }
+        }
+
+        job = _jobs.erase(job);
+    }
+
+    return uploads;
+}
+
+void TessellationQueue::forget( const GMlib::PSurf<float,3>* surface ) {
+
+    // Jobs still running finish on their own; their results are dropped by upload()
+    _requests.erase(surface);
+}
+
+void TessellationQueue::clear() {
+
+    _requests.clear();
+    _jobs.clear();
+}
+
+size_t TessellationQueue::getPending() const { return _requests.size(); }
+
+void TessellationQueue::setUploadCallback( UploadFunction uploaded ) { _uploaded = uploaded; }
+
+void TessellationQueue::setMeasureCallback( MeasureFunction measured ) { _measured = measured; }
+
+void TessellationQueue::setProgressive( bool progressive ) { _progressive = progressive; }
+
+bool TessellationQueue::isProgressive() const { return _progressive; }
+
+void TessellationQueue::setRefinementBudget( std::chrono::milliseconds budget ) { _budget = budget; }
+
+std::vector<int> TessellationQueue::passes( int m, int passes ) {
+
+    // Halving the intervals back from m
+    std::vector<int> counts( 1, m );
+    for( auto i = 1; i < passes; ++i )
+        counts.insert( counts.begin(), ( counts.front() - 1 ) / 2 + 1 );
+    return counts;
+}
+
+int TessellationQueue::countPasses( int m1, int m2 ) const {
+
+    // Both directions are refined together, as long as their intervals halve evenly
+    auto n1 = m1 - 1;
+    auto n2 = m2 - 1;
+    auto count = 1;
+    while( count < _max_passes && n1 % 2 == 0 && n2 % 2 == 0 &&
+           std::min( n1, n2 ) / 2 >= _min_intervals ) {
+        n1 /= 2;
+        n2 /= 2;
+        ++count;
+    }
+    return count;
+}
+
+void TessellationQueue::apply( GMlib::PSurf<float,3>* surface, const SurfaceSamples& samples, bool last ) {
+
+    auto started = std::chrono::steady_clock::now();
+    SurfaceSampler::apply( surface, samples );
+    std::chrono::duration<double,std::milli> elapsed = std::chrono::steady_clock::now() - started;
+
+    if( _uploaded )
+        _uploaded( surface, samples, last );
+    if( _measured )
+        _measured( surface, samples, elapsed.count() );
+}
@@ -0,0 +1,92 @@
+#ifndef TESSELLATIONQUEUE_H
+#define TESSELLATIONQUEUE_H
+
+
+#include "surfacesampler.h"
+
+// stl
+#include <chrono>
+#include <functional>
+#include <future>
+#include <list>
+#include <map>
+#include <memory>
+#include <vector>
+
+
+// Replots surfaces in the background.
+// Surfaces are sampled on the worker threads of the ThreadPool; the finished grids are
+// handed to the visualizers by upload(), on the render thread at the start of a frame.
+// Until then a surface keeps showing its previous mesh. A newer request for the same
+// surface supersedes older ones that are still in flight.
+//
+// In progressive mode a surface is first sampled coarsely, then refined by doubling the
+// intervals in both directions, each pass reusing the samples of the one before. A pass is
+// shown if it is finer than what the surface shows already. Refinement stops at the requested
+// sampling, or when the time budget since the request has run out. Only sample counts with
+// (m - 1) divisible by two can be refined towards, anything else is sampled in one pass.
+//
+// All member functions are to be called from the render thread.
+class TessellationQueue {
+public:
+    // false if the surface can not be sampled off the render thread
+    bool                                              submit( GMlib::PSurf<float,3>* surface, int m1, int m2, int d1, int d2 );
+
+    // Uploads at most max_uploads finished meshes, returns how many were uploaded
+    int                                               upload( int max_uploads = 8 );
+
+    // Drops the jobs of a surface about to be deleted, or replotted in place
+    void                                              forget( const GMlib::PSurf<float,3>* surface );
+    void                                              clear();
+
+    size_t                                            getPending() const;
+
+    void                                              setProgressive( bool progressive );
+    bool                                              isProgressive() const;
+    void                                              setRefinementBudget( std::chrono::milliseconds budget );
+
+    // Sample counts of the passes towards m samples, coarsest first
+    static std::vector<int>                           passes( int m, int passes );
+    int                                               countPasses( int m1, int m2 ) const;
+
+    // Called after a finished mesh was handed to the visualizers of its surface;
+    // last is false for passes that are still to be refined
+    using UploadFunction = std::function<void(GMlib::PSurf<float,3>*,const SurfaceSamples&,bool last)>;
+    void                                              setUploadCallback( UploadFunction uploaded );
+
+    // Called after every upload, with the milliseconds it took on the render thread
+    using MeasureFunction = std::function<void(const GMlib::PSurf<float,3>*,const SurfaceSamples&,double upload_time)>;
+    void                                              setMeasureCallback( MeasureFunction measured );
+
+private:
+    struct Request {
+        unsigned int                                  generation;
+        int                                           m1, m2, d1, d2;
+    };
+
+    struct Job {
+        GMlib::PSurf<float,3>*                        surface;
+        unsigned int                                  generation;
+        std::future<std::shared_ptr<SurfaceSamples>>  samples;
+
+        // Progressive passes
+        std::shared_ptr<SurfaceSampler>               sampler;
+        int                                           refinements;    // still to come after this pass
+        std::chrono::steady_clock::time_point         started;
+    };
+
+    std::list<Job>                                    _jobs;
+    std::map<const GMlib::PSurf<float,3>*,Request>    _requests;    // latest per surface
+    unsigned int                                      _generation {0};
+    UploadFunction                                    _uploaded;
+    MeasureFunction                                   _measured;
+
+    bool                                              _progressive {false};
+    std::chrono::milliseconds                         _budget {250};
+    int                                               _min_intervals {8};    // of the first pass
+    int                                               _max_passes {4};
+
+    void                                              apply( GMlib::PSurf<float,3>* surface, const SurfaceSamples& samples, bool last );
+};
+
+#endif // TESSELLATIONQUEUE_H
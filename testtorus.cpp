@@ -1,5 +1,7 @@
 #include "testtorus.h"
 
+#include "scenario.h"
+
 TestTorus::~TestTorus() {
 
     if(_torus) remove(_torus.get());
@@ -17,7 +19,7 @@ TestTorus::test01() {
     _torus->translate(d + d.getNormalized()*2.0f);
     _torus->rotate( GMlib::Angle(90), GMlib::Vector<float,3>( 0.0f, 1.0f, 0.0f) );
     _torus->toggleDefaultVisualizer();
-    _torus->replot(200,200,1,1);
+    Scenario::instance().replot(_torus.get(),200,200,1,1);
     _torus->setMaterial(GMlib::GMmaterial::Emerald);
     insert(_torus.get());
 }
@@ -0,0 +1,56 @@
+#include "threadpool.h"
+
+// stl
+#include <algorithm>
+
+
+ThreadPool::ThreadPool( unsigned int no_threads ) {
+
+    if( !no_threads )
+        no_threads = std::max( 1u, std::thread::hardware_concurrency() );
+
+    _workers.reserve(no_threads);
+    for( unsigned int i = 0; i < no_threads; ++i )
+        _workers.emplace_back( &ThreadPool::work, this );
+}
+
+ThreadPool::~ThreadPool() {
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _stopping = true;
+    }
+    _cond.notify_all();
+
+    for( auto& worker : _workers )
+        worker.join();
+}
+
+ThreadPool& ThreadPool::instance() {
+
+    static ThreadPool pool;
+    return pool;
+}
+
+unsigned int ThreadPool::size() const { return static_cast<unsigned int>(_workers.size()); }
+
+void ThreadPool::work() {
+
+    while(true) {
+
+        std::function<void()> job;
+        {
+            std::unique_lock<std::mutex> lock(_mutex);
+            _cond.wait( lock, [this]() { return _stopping || !_jobs.empty(); } );
+
+            // Drain the queue before leaving so no future is left hanging
+            if( _stopping && _jobs.empty() )
+                return;
+
+            job = std::move(_jobs.front());
+            _jobs.pop();
+        }
+
+        job();
+    }
+}
@@ -0,0 +1,64 @@
+#ifndef THREADPOOL_H
+#define THREADPOOL_H
+
+
+// stl
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+
+// Fixed size pool of worker threads.
+// Jobs are picked up in submission order; submit() hands back a future for the result.
+class ThreadPool {
+public:
+    explicit ThreadPool( unsigned int no_threads = 0 );   // 0 = one per hardware thread
+    ~ThreadPool();
+
+    ThreadPool( const ThreadPool& )                   = delete;
+    ThreadPool& operator = ( const ThreadPool& )      = delete;
+
+    static ThreadPool&                                instance();
+
+    template <typename F>
+    auto                                              submit( F&& job ) -> std::future<decltype(job())>;
+
+    unsigned int                                      size() const;
+
+private:
+    std::vector<std::thread>                          _workers;
+    std::queue<std::function<void()>>                 _jobs;
+    std::mutex                                        _mutex;
+    std::condition_variable                           _cond;
+    bool                                              _stopping {false};
+
+    void                                              work();
+};
+
+
+
+template <typename F>
+inline
+auto ThreadPool::submit( F&& job ) -> std::future<decltype(job())> {
+
+    using R = decltype(job());
+
+    // std::function needs a copyable target, so the task lives on the heap
+    auto task   = std::make_shared<std::packaged_task<R()>>( std::forward<F>(job) );
+    auto result = task->get_future();
+
+    {
+        std::lock_guard<std::mutex> lock(_mutex);
+        _jobs.emplace( [task]() { (*task)(); } );
+    }
+    _cond.notify_one();
+
+    return result;
+}
+
+#endif // THREADPOOL_H
@@ -32,7 +32,7 @@ Window::Window(QWindow *parent) : QQuickView(parent) {
   format.setGreenBufferSize(8);
   format.setBlueBufferSize(8);
   format.setAlphaBufferSize(8);
-  format.setSamples(4);
+  format.setSamples(0);                                       // the scene multisamples in its FBO, by the performance preset
   format.setStencilBufferSize(8);
 
   QSurfaceFormat::setDefaultFormat(format);